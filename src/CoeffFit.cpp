@@ -0,0 +1,390 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Fitting J evaluator coefficients
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "CoeffFit.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////
+// Pattern extraction
+//////////////////////////////////////////////////
+
+//! Base 3 config of the squares start, start+step, ..., in the evaluator's format
+static u4 LineConfig(u64 empty, u64 mover, int start, int count, int step) {
+    u4 e=0, m=0;
+    for (int i=0; i<count; i++) {
+        e|=u4((empty>>(start+i*step))&1)<<i;
+        m|=u4((mover>>(start+i*step))&1)<<i;
+    }
+    return base2ToBase3Table[e]+2*base2ToBase3Table[m];
+}
+
+//! Add the index of the coefficient for config in map
+static inline void AddFeature(u4*& pFeature, int map, u4 config) {
+    *pFeature++=coeffStartsJ[map]+mapsJ[map].ConfigToID(u2(config));
+}
+
+//! Add a straight line pattern and its potential mobilities
+static void AddLine(u4*& pFeature, int map, u4 config, int size, u4& nPMP, u4& nPMO) {
+    AddFeature(pFeature, map, config);
+    nPMO+=configToPotMob[0][size][config];
+    nPMP+=configToPotMob[1][size][config];
+}
+
+//! Add the 2x5 and edge+2X patterns along an edge
+static void AddEdge(u4*& pFeature, u4 config1, u4 config2) {
+    const u4 configs2x5=row1To2x5[config1]+row2To2x5[config2];
+    AddFeature(pFeature, C2x5J, configs2x5&0xFFFF);
+    AddFeature(pFeature, C2x5J, configs2x5>>16);
+    AddFeature(pFeature, CR1XXJ, config1*3+row2ToXX[config2]);
+}
+
+//! Add the two corner triangles of a side and their potential mobilities
+static void AddTriangles(u4*& pFeature, u4 config1, u4 config2, u4 config3, u4 config4, u4& nPMP, u4& nPMO) {
+    const u4 configsTriangle=row1ToTriangle[config1]+row2ToTriangle[config2]+row3ToTriangle[config3]+row4ToTriangle[config4];
+    const u4 configs[2]={ configsTriangle&0xFFFF, configsTriangle>>16 };
+    for (u4 config : configs) {
+        AddFeature(pFeature, C4J, config);
+        nPMO+=configToPotMobTriangle[0][config];
+        nPMP+=configToPotMobTriangle[1][config];
+    }
+}
+
+//! Get the indices of the coefficients that the J evaluator sums to value bb.
+//!
+//! An index is coeffStartsJ[map]+id, where id is the pattern ID of the config in that map.
+//! Some indices may appear more than once. 2x4 corner patterns are not included; the
+//! evaluator folds them into the 2x5 patterns.
+void FeaturesJ(const CBitBoard& bb, u4 features[nFeaturesJ]) {
+    const u64 empty=bb.empty;
+    const u64 mover=bb.mover;
+    u4* pFeature=features;
+    u4 nPMP=0, nPMO=0;
+
+    // rows and columns
+    u4 rows[8], columns[8];
+    for (int i=0; i<8; i++) {
+        rows[i]=LineConfig(empty, mover, 8*i, 8, 1);
+        columns[i]=LineConfig(empty, mover, i, 8, 8);
+    }
+    static const int rowMaps[8]={ R1J, R2J, R3J, R4J, R4J, R3J, R2J, R1J };
+    for (int i=0; i<8; i++) {
+        AddLine(pFeature, rowMaps[i], rows[i], 8, nPMP, nPMO);
+        AddLine(pFeature, rowMaps[i], columns[i], 8, nPMP, nPMO);
+    }
+
+    // diagonals: start, length, step
+    static const int diagonals[14][3]={
+        {0,8,9}, {7,8,7},
+        {1,7,9}, {8,7,9}, {6,7,7}, {15,7,7},
+        {2,6,9}, {16,6,9}, {5,6,7}, {23,6,7},
+        {3,5,9}, {24,5,9}, {4,5,7}, {31,5,7}
+    };
+    for (const int* diagonal : diagonals) {
+        const int length=diagonal[1];
+        const u4 config=LineConfig(empty, mover, diagonal[0], length, diagonal[2]);
+        AddLine(pFeature, D8J+8-length, config, length, nPMP, nPMO);
+    }
+
+    // corner patterns
+    AddEdge(pFeature, rows[0], rows[1]);
+    AddEdge(pFeature, rows[7], rows[6]);
+    AddEdge(pFeature, columns[0], columns[1]);
+    AddEdge(pFeature, columns[7], columns[6]);
+    AddTriangles(pFeature, rows[0], rows[1], rows[2], rows[3], nPMP, nPMO);
+    AddTriangles(pFeature, rows[7], rows[6], rows[5], rows[4], nPMP, nPMO);
+
+    // mobility, potential mobility and parity
+    u4 nMovesPlayer, nMovesOpponent;
+    bb.CalcMobility(nMovesPlayer, nMovesOpponent);
+    AddFeature(pFeature, M1J, nMovesPlayer);
+    AddFeature(pFeature, M2J, nMovesOpponent);
+    AddFeature(pFeature, PM1J, (nPMP+potMobAdd)>>potMobShift);
+    AddFeature(pFeature, PM2J, (nPMO+potMobAdd)>>potMobShift);
+    AddFeature(pFeature, PARJ, bb.NEmpty()&1);
+
+    assert(pFeature==features+nFeaturesJ);
+}
+
+//////////////////////////////////////////////////
+// Fitting
+//////////////////////////////////////////////////
+
+//! Fit coefficients for coefficient sets with the same number of files as coeffSet
+CCoeffFitJ::CCoeffFitJ(char coeffSet) : nFiles(NCoeffFilesJ(coeffSet)), phases(2*nFiles) {
+    for (CPhase& phase : phases) {
+        phase.coeffs.resize(nCoeffsJ);
+        phase.dRmsStart=phase.dRmsEnd=0;
+    }
+}
+
+//! Phase used by the evaluator for positions with nEmpty empties, or -1 if none
+int CCoeffFitJ::Phase(int nEmpty) const {
+    if (nEmpty<0 || nEmpty>59)
+        return -1;
+
+    // the files overlap; each file is used for the empties not covered by the next file
+    const int nSetWidth=60/nFiles;
+    const int iFile=min(nFiles-1, (59-nEmpty)/nSetWidth);
+    const int iSubset=(nEmpty&1)^1;
+    return 2*iFile+iSubset;
+}
+
+static string FileName(const string& fnBase, int iFile) {
+    ostringstream os;
+    os << fnBase << char('a'+iFile) << ".cof";
+    return os.str();
+}
+
+//! Read starting coefficients from the coefficient files fnBase?.cof
+//!
+//! As in CEvaluator, the last character of fnBase is the coefficient set.
+//!
+//! \throw string if error
+void CCoeffFitJ::Read(const string& fnBase) {
+    const char cCoeffSet=fnBase.end()[-1];
+    if (NCoeffFilesJ(cCoeffSet)!=nFiles)
+        throw string("Wrong number of coefficient files in ")+fnBase;
+
+    for (int iFile=0; iFile<nFiles; iFile++) {
+        const string fn=FileName(fnBase, iFile);
+        FILE* fp=fopen(fn.c_str(), "rb");
+        if (!fp)
+            throw string("Can't open coefficient file ")+fn;
+
+        int iVersion;
+        u4 fParams;
+        if (!fread(&iVersion, sizeof(iVersion), 1, fp) || !fread(&fParams, sizeof(fParams), 1, fp)
+            || iVersion!=1 || fParams!=100) {
+            fclose(fp);
+            throw string("error reading from coefficients file ")+fn;
+        }
+
+        for (int iSubset=0; iSubset<2; iSubset++) {
+            vector<double>& coeffs=phases[2*iFile+iSubset].coeffs;
+            for (int map=0; map<nMapsJ; map++) {
+                const int nIDs=mapsJ[map].NIDs();
+                vector<i2> i2Coeffs(nIDs);
+                if (fread(&i2Coeffs[0], sizeof(i2), nIDs, fp)<size_t(nIDs)) {
+                    fclose(fp);
+                    throw string("error reading from coefficients file ")+fn;
+                }
+                copy(i2Coeffs.begin(), i2Coeffs.end(), coeffs.begin()+coeffStartsJ[map]);
+            }
+            coeffs[coeffStartsJ[PARJ]+0]+=ParityCorrectionJ(cCoeffSet, iFile);
+            coeffs[coeffStartsJ[PARJ]+1]+=ParityCorrectionJ(cCoeffSet, iFile);
+
+            // fold 2x4 corners into 2x5 corners, as the evaluator does
+            const CMap& map2x4=mapsJ[C2x4J];
+            const CMap& map2x5=mapsJ[C2x5J];
+            for (int config=0; config<map2x5.NConfigs(); config++) {
+                if (map2x5.ConfigToID(u2(config))==config) {
+                    const u2 id2x4=map2x4.ConfigToID(u2(configs2x5To2x4[config]));
+                    coeffs[coeffStartsJ[C2x5J]+config]+=coeffs[coeffStartsJ[C2x4J]+id2x4];
+                }
+            }
+            fill(coeffs.begin()+coeffStartsJ[C2x4J], coeffs.begin()+coeffStartsJ[C2x4J]+map2x4.NIDs(), 0);
+        }
+        fclose(fp);
+    }
+}
+
+//! Write the coefficients to the coefficient files fnBase?.cof, in the format read by CEvaluator.
+//!
+//! Coefficients are rounded to centi-discs; the parity correction that the evaluator adds when
+//! it loads the file is subtracted. As in CEvaluator, the last character of fnBase is the
+//! coefficient set.
+//!
+//! \throw string if error
+void CCoeffFitJ::Write(const string& fnBase) const {
+    const char cCoeffSet=fnBase.end()[-1];
+    for (int iFile=0; iFile<nFiles; iFile++) {
+        const string fn=FileName(fnBase, iFile);
+        FILE* fp=fopen(fn.c_str(), "wb");
+        if (!fp)
+            throw string("Can't open coefficient file ")+fn;
+
+        const int iVersion=1;
+        const u4 fParams=100;
+        bool fOk=fwrite(&iVersion, sizeof(iVersion), 1, fp) && fwrite(&fParams, sizeof(fParams), 1, fp);
+        for (int iSubset=0; iSubset<2 && fOk; iSubset++) {
+            const vector<double>& coeffs=phases[2*iFile+iSubset].coeffs;
+            for (int map=0; map<nMapsJ && fOk; map++) {
+                const int nIDs=mapsJ[map].NIDs();
+                vector<i2> i2Coeffs(nIDs);
+                for (int id=0; id<nIDs; id++) {
+                    double coeff=coeffs[coeffStartsJ[map]+id];
+                    if (map==PARJ)
+                        coeff-=ParityCorrectionJ(cCoeffSet, iFile);
+                    coeff=min(max(floor(coeff+0.5), -double(0x3FFF)), double(0x3FFF));
+                    i2Coeffs[id]=i2(coeff);
+                }
+                fOk=fwrite(&i2Coeffs[0], sizeof(i2), nIDs, fp)==size_t(nIDs);
+            }
+        }
+        if (fclose(fp) || !fOk)
+            throw string("error writing to coefficients file ")+fn;
+    }
+}
+
+//! Add a position whose value to the mover is value.
+//!
+//! Positions where the mover has no legal move are not evaluated by the search and are skipped.
+void CCoeffFitJ::Add(const CBitBoard& bb, CValue value) {
+    const int iPhase=Phase(bb.NEmpty());
+    u4 nMovesPlayer, nMovesOpponent;
+    if (iPhase<0 || bb.CalcMobility(nMovesPlayer, nMovesOpponent))
+        return;
+
+    CPhase& phase=phases[iPhase];
+    const size_t n=phase.features.size();
+    phase.features.resize(n+nFeaturesJ);
+    FeaturesJ(bb, &phase.features[n]);
+    phase.values.push_back(float(value));
+}
+
+u64 CCoeffFitJ::NPositions() const {
+    u64 n=0;
+    for (const CPhase& phase : phases)
+        n+=phase.NPositions();
+    return n;
+}
+
+//! Value of bb with the current coefficients, in centi-discs
+double CCoeffFitJ::Value(const CBitBoard& bb) const {
+    const int iPhase=Phase(bb.NEmpty());
+    assert(iPhase>=0);
+    u4 features[nFeaturesJ];
+    FeaturesJ(bb, features);
+    return phases[iPhase].Value(features);
+}
+
+double CCoeffFitJ::CPhase::Value(const u4* pFeatures) const {
+    double value=0;
+    for (int i=0; i<nFeaturesJ; i++)
+        value+=coeffs[pFeatures[i]];
+    return value;
+}
+
+//! Root mean square error of the positions in the phase
+double CCoeffFitJ::CPhase::Rms() const {
+    double sumSq=0;
+    for (size_t i=0; i<NPositions(); i++) {
+        const double error=Value(&features[i*nFeaturesJ])-values[i];
+        sumSq+=error*error;
+    }
+    return NPositions() ? sqrt(sumSq/NPositions()) : 0;
+}
+
+//! Fit the coefficients of all phases.
+//!
+//! Each phase minimizes sum((value-target)^2) + dRidge*sum((coeff-start)^2), so coefficients
+//! that appear in no position keep their starting values.
+void CCoeffFitJ::Fit(int nThreads, int nIterations, double dRidge) {
+    atomic<int> iNext(0);
+    auto work=[&]() {
+        for (int iPhase; (iPhase=iNext++)<int(phases.size()); )
+            phases[iPhase].Fit(nIterations, dRidge);
+    };
+
+    vector<thread> threads;
+    for (int i=1; i<nThreads; i++)
+        threads.push_back(thread(work));
+    work();
+    for (thread& t : threads)
+        t.join();
+}
+
+//! Conjugate gradient least squares (CGLS) on the change in coefficients
+void CCoeffFitJ::CPhase::Fit(int nIterations, double dRidge) {
+    dRmsStart=dRmsEnd=Rms();
+    const size_t n=NPositions();
+    if (!n)
+        return;
+
+    const size_t m=coeffs.size();
+    vector<double> delta(m), s(m), p(m), r(n), q(n);
+
+    // residuals r=target-value, and s=A^T r-dRidge*delta
+    for (size_t i=0; i<n; i++)
+        r[i]=values[i]-Value(&features[i*nFeaturesJ]);
+    auto gradient=[&]() {
+        for (size_t j=0; j<m; j++)
+            s[j]=-dRidge*delta[j];
+        for (size_t i=0; i<n; i++) {
+            const u4* pFeatures=&features[i*nFeaturesJ];
+            for (int k=0; k<nFeaturesJ; k++)
+                s[pFeatures[k]]+=r[i];
+        }
+    };
+    auto dot=[](const vector<double>& a, const vector<double>& b) {
+        double sum=0;
+        for (size_t j=0; j<a.size(); j++)
+            sum+=a[j]*b[j];
+        return sum;
+    };
+
+    gradient();
+    p=s;
+    double gamma=dot(s, s);
+    for (int iteration=0; iteration<nIterations && gamma>0; iteration++) {
+        // q=A p
+        for (size_t i=0; i<n; i++) {
+            const u4* pFeatures=&features[i*nFeaturesJ];
+            double sum=0;
+            for (int k=0; k<nFeaturesJ; k++)
+                sum+=p[pFeatures[k]];
+            q[i]=sum;
+        }
+        const double curvature=dot(q, q)+dRidge*dot(p, p);
+        if (curvature<=0)
+            break;
+        const double alpha=gamma/curvature;
+        for (size_t j=0; j<m; j++)
+            delta[j]+=alpha*p[j];
+        for (size_t i=0; i<n; i++)
+            r[i]-=alpha*q[i];
+
+        gradient();
+        const double gammaNew=dot(s, s);
+        const double beta=gammaNew/gamma;
+        gamma=gammaNew;
+        for (size_t j=0; j<m; j++)
+            p[j]=s[j]+beta*p[j];
+    }
+
+    for (size_t j=0; j<m; j++)
+        coeffs[j]+=delta[j];
+    dRmsEnd=Rms();
+}
+
+//! Print the number of positions and the rms error before and after fitting for each phase
+void CCoeffFitJ::Print(ostream& os) const {
+    os << "file  empties  positions  rms start  rms end\n";
+    const int nSetWidth=60/nFiles;
+    for (int iFile=0; iFile<nFiles; iFile++) {
+        for (int iSubset=0; iSubset<2; iSubset++) {
+            const CPhase& phase=phases[2*iFile+iSubset];
+            if (!phase.NPositions())
+                continue;
+            const int maxEmpty=59-nSetWidth*iFile;
+            const int minEmpty=iFile==nFiles-1 ? 0 : maxEmpty-nSetWidth+1;
+            os << setw(4) << char('a'+iFile) << setw(4) << minEmpty << "-" << setw(2) << maxEmpty
+               << (iSubset ? " even" : " odd ") << setw(10) << phase.NPositions()
+               << fixed << setprecision(1) << setw(11) << phase.dRmsStart/kStoneValue
+               << setw(9) << phase.dRmsEnd/kStoneValue << "\n";
+        }
+    }
+}
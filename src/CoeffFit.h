@@ -0,0 +1,65 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Fitting J evaluator coefficients
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "core/BitBoard.h"
+#include "Evaluator.h"
+
+//! Number of coefficients summed by the J evaluator for one position
+const int nFeaturesJ=51;
+
+void FeaturesJ(const CBitBoard& bb, u4 features[nFeaturesJ]);
+
+//! Fits J evaluator coefficients to positions with known values.
+//!
+//! The J evaluator is linear: its value is the sum of one coefficient for each pattern instance,
+//! mobility, potential mobility and parity (see FeaturesJ()). Each coefficient file and parity
+//! subset covers its own range of empties and is fitted separately, by conjugate gradient least
+//! squares with a ridge penalty pulling the coefficients towards their starting values.
+//! Phases are fitted on several threads at once.
+//!
+//! The coefficients are stored the way the evaluator uses them: with the parity correction added
+//! and the 2x4 corner coefficients folded into the 2x5 coefficients, so Value() matches
+//! CEvaluator::EvalMobs() for coefficients that have been read in.
+class CCoeffFitJ {
+public:
+    explicit CCoeffFitJ(char coeffSet);
+
+    void Read(const std::string& fnBase);
+    void Write(const std::string& fnBase) const;
+
+    void Add(const CBitBoard& bb, CValue value);
+    void Fit(int nThreads, int nIterations, double dRidge);
+    void Print(std::ostream& os) const;
+
+    double Value(const CBitBoard& bb) const;
+    u64 NPositions() const;
+
+private:
+    //! Positions and coefficients for one coefficient file and parity subset
+    struct CPhase {
+        std::vector<u4> features;   //!< nFeaturesJ coefficient indices per position
+        std::vector<float> values;  //!< target value of each position
+        std::vector<double> coeffs; //!< indexed by coeffStartsJ[map]+id
+        double dRmsStart, dRmsEnd;
+
+        size_t NPositions() const { return values.size(); }
+        double Value(const u4* pFeatures) const;
+        double Rms() const;
+        void Fit(int nIterations, double dRidge);
+    };
+
+    int Phase(int nEmpty) const;
+
+    int nFiles;
+    std::vector<CPhase> phases;
+};
@@ -0,0 +1,77 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// many external viewer sessions in one process
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#include "core/NodeStats.h"
+#include "GameX.h"
+#include "EngineServer.h"
+
+using namespace std;
+
+CEngineServer::CEngineServer(const CComputerDefaults& acd) : cd(acd), nSessions(0) {
+    cd.fReadOnlyBook=true;
+}
+
+//! Accept connections on nPort forever, running a session for each on its own thread.
+//!
+//! \throw string if the port can't be listened to
+void CEngineServer::Run(int nPort) {
+#ifndef _WIN32
+    // a client that disconnects mid-search must not kill the server when its reply is sent
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    socklistener listener;
+    if (listener.listen(nPort)) {
+        throw string("Can't listen on port ")+to_string(nPort);
+    }
+    cerr << "Listening on port " << nPort << "\n";
+
+    for (;;) {
+        SOCKET s=listener.accept();
+#ifdef _WIN32
+        if (s==INVALID_SOCKET)
+#else
+        if (s<0)
+#endif
+            continue;
+        thread(&CEngineServer::Session, this, s).detach();
+    }
+}
+
+//! Session thread's job: run a game for the viewer on socket s until it quits or disconnects.
+void CEngineServer::Session(SOCKET s) {
+    sockbuf sb(false);
+    if (sb.attach(s))
+        return;
+    istream is(&sb);
+    ostream os(&sb);
+
+    cerr << "Session started, " << ++nSessions << " running\n";
+
+    // input must abort only this session's searches, so the reader is set before any input arrives
+    CInputQueue input;
+    input.SetReader(&abortRound);
+    thread reader(&CInputQueue::AddLines, &input, ref(is));
+
+    CGameX game(cd, input, os);
+
+    // the viewer may not have closed the connection; stop the reader so it can be joined.
+    os.flush();
+    sb.shutdown();
+    reader.join();
+
+    cerr << "Session ended, " << --nSessions << " running\n";
+}
@@ -0,0 +1,31 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// many external viewer sessions in one process
+
+#pragma once
+
+#include <atomic>
+
+#include "odk/sockbuf.h"
+#include "PlayerComputer.h"
+
+//! Serves external viewer (NBoard protocol) sessions on a local port, one engine per connection.
+//!
+//! Each session has its own game, computer and cache. Evaluators, MPC stats and books are loaded
+//! once and shared by all sessions. Searches don't write to the book; commands that do, such as
+//! learn, wait for other sessions' searches to finish (see CGameX).
+class CEngineServer {
+public:
+    explicit CEngineServer(const CComputerDefaults& cd);
+
+    void Run(int nPort);
+
+private:
+    void Session(SOCKET s);
+
+    CComputerDefaults cd;
+    std::atomic<int> nSessions;
+};
@@ -8,7 +8,10 @@
 // test, against the JA set of coefficients.
 
 #include <inttypes.h>
+#include <cmath>
+#include <vector>
 #include "core/BitBoard.h"
+#include "CoeffFit.h"
 #include "Evaluator.h"
 #include "n64/flips.h"
 #include "n64/test.h"
@@ -75,3 +78,36 @@ void GoldenValueEvalTest() {
         TEST(e.expectedEval == eval->EvalMobs(pp, static_cast<u4>(bitCount(moveBits)), static_cast<u4>(bitCount(enemyMoveBits))));
     }
 }
+
+// The coefficient fitter must value positions exactly as the evaluator does, and fitting
+// must move the values towards the targets.
+void CoeffFitEvalTest() {
+    CEvaluator *eval = CEvaluator::FindEvaluator('J', 'A');
+    CCoeffFitJ fit('A');
+    fit.Read("coefficients/JA");
+    const size_t n = sizeof(evalInstances) / sizeof(struct evaltest);
+    std::vector<CValue> targets;
+    for (size_t i = 0; i < n; ++i) {
+        const struct evaltest &e = evalInstances[i];
+        CBitBoard b;
+        b.mover = e.mover;
+        b.empty = e.empty;
+        u4 nMovesPlayer, nMovesOpponent;
+        b.CalcMobility(nMovesPlayer, nMovesOpponent);
+        Pos2 pp;
+        pp.Initialize(b, e.blackMove);
+        const CValue value = eval->EvalMobs(pp, nMovesPlayer, nMovesOpponent);
+        TEST(fit.Value(b) == value);
+        targets.push_back(value + kStoneValue);
+        fit.Add(b, targets.back());
+    }
+    TEST(fit.NPositions() == n);
+
+    fit.Fit(2, 20, 1.0);
+    for (size_t i = 0; i < n; ++i) {
+        CBitBoard b;
+        b.mover = evalInstances[i].mover;
+        b.empty = evalInstances[i].empty;
+        TEST(fabs(fit.Value(b) - targets[i]) < kStoneValue / 4);
+    }
+}
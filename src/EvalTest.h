@@ -2,4 +2,5 @@
 #define __EVALTEST_H
 
 void GoldenValueEvalTest();
+void CoeffFitEvalTest();
 #endif
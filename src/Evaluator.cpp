@@ -58,8 +58,7 @@ CEvaluator* CEvaluator::FindEvaluator(char evaluatorType, char coeffSet) {
     if (ptr==evaluatorList.end()) {
         switch(evaluatorType) {
         case 'J': {
-            int nFiles= (coeffSet>='9')?10:6;
-            result=new CEvaluator(FNBase(evaluatorType, coeffSet), nFiles);
+            result=new CEvaluator(FNBase(evaluatorType, coeffSet), NCoeffFilesJ(coeffSet));
             break;
                   }
         default:
@@ -85,6 +84,22 @@ std::string CEvaluator::FNBase(char evaluatorType, char coeffSet) {
 //    Use 2x4, 2x5, edge+X patterns
 //////////////////////////////////////////////////////
 
+//! Number of coefficient files in a J coefficient set
+int NCoeffFilesJ(char coeffSet) {
+    return (coeffSet>='9')?10:6;
+}
+
+//! Odd-even correction added to the parity coefficient of file iFile when it is loaded
+TCoeff ParityCorrectionJ(char coeffSet, int iFile) {
+    if (coeffSet>='A') {
+        if (iFile>=7)
+            return TCoeff(kStoneValue*.65);
+        else if (iFile==6)
+            return TCoeff(kStoneValue*.33);
+    }
+    return 0;
+}
+
 //! Conver the file to i2 format
 //!
 //! read in the file (float format) and write it out in i2 format.
@@ -201,12 +216,7 @@ CEvaluator::CEvaluator(const std::string& fnBase, int nFiles) {
 
                     if (map==PARJ) {
                         // odd-even correction, only in Parity coefficient.
-                        if (cCoeffSet>='A') {
-                            if (iFile>=7)
-                                coeff+=TCoeff(kStoneValue*.65);
-                            else if (iFile==6)
-                                coeff+=TCoeff(kStoneValue*.33);
-                        }
+                        coeff+=ParityCorrectionJ(cCoeffSet, iFile);
                     }
                     
                     // coeff value has first 2 bytes=coeff, 3rd byte=potmob1, 4th byte=potmob2
@@ -67,4 +67,6 @@ private:
 
 extern int coeffStartsJ[nMapsJ];
 extern int nCoeffsJ;
+int NCoeffFilesJ(char coeffSet);
+TCoeff ParityCorrectionJ(char coeffSet, int iFile);
 //extern TCoeff *mobsJ;
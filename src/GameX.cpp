@@ -3,101 +3,148 @@
 
 #include <condition_variable>
 #include <deque>
+#include <fstream>
 #include <functional>
 #include <mutex>
+#include <shared_mutex>
 #include <sstream>
 #include <thread>
 
+#include "core/NodeStats.h"
 #include "SmartBook.h"
+#include "SearchThread.h"
 #include "GameX.h"
 
 ///////////////////////////////////
-// CGame2
+// CInputQueue
 ///////////////////////////////////
 
-//! Stored commands from NBoard.
-std::mutex cs;
-static std::deque<std::string> lines;
-
-
-//! A waitable event
-static std::mutex cvcs;
-static std::condition_variable cv;
-static bool val = false;
-static bool IsValSet() {
-    return val;
+CInputQueue::CInputQueue() : pAbortFlag(NULL) {
 }
 
-static void EventSet() {
+//! Add an input line to the queue and wake the engine if it is waiting for input.
+//!
+//! Also tells the abort timer, which stops the engine's search if abortOnInput is set.
+void CInputQueue::Add(const std::string& sLine) {
+    std::atomic<bool>* pFlag;
     {
-    	std::unique_lock<std::mutex> guard(cvcs);
-        val = true;
+        std::unique_lock<std::mutex> guard(mutex);
+        lines.push_back(sLine);
+        pFlag=pAbortFlag;
     }
     cv.notify_one();
+    if (pFlag)
+        SignalInput(pFlag);
+    else
+        SignalInput();
+}
+
+//! Input thread's job: add lines from is to the queue until it ends.
+void CInputQueue::AddLines(std::istream& is) {
+    std::string sLine;
+    while (getline(is, sLine)) {
+        // sockets send "\r\n" line ends
+        if (!sLine.empty() && sLine[sLine.size()-1]=='\r')
+            sLine.erase(sLine.size()-1);
+    	Add(sLine);
+    }
 
+    // last, post a quit message. Normally we get one from the viewer
+    // but sometimes it doesn't get a chance to before termination.
+    Add("quit");
 }
 
-//! Set an event to false
-static void EventReset() {
-    std::unique_lock<std::mutex> guard(cvcs);
-    val = false;
+//! Wait for a line of input and remove it from the queue.
+void CInputQueue::Get(std::string& sLine) {
+    std::unique_lock<std::mutex> guard(mutex);
+    while (lines.empty())
+        cv.wait(guard);
+    sLine=lines.front();
+    lines.pop_front();
 }
 
-void EventWait() {
-    std::unique_lock<std::mutex> guard(cvcs);
-    while (!val) {
-    	cv.wait(guard, IsValSet);
-    }
+bool CInputQueue::Empty() const {
+    std::unique_lock<std::mutex> guard(mutex);
+    return lines.empty();
 }
 
-//! This function returns true if there is input waiting for the engine.
-//! It is meant to be used in the search function.
+//! Only abort the search whose abort flag is pAbortFlag when input arrives.
 //!
-//! It is currently used only when using an external viewer with GameX.
-//! \todo test to see if this slows down the search. If so need a faster mechanism.
-bool HasInput() {
-    std::unique_lock<std::mutex> guard(cs);
-    bool fHasInput=!lines.empty();
-    return fHasInput;
+//! With several engines in one process, each engine's input must only stop its own search.
+void CInputQueue::SetReader(std::atomic<bool>* pAbortFlag) {
+    std::unique_lock<std::mutex> guard(mutex);
+    this->pAbortFlag=pAbortFlag;
 }
 
-//! Add an input line to the deque, and set the event if the deque was empty before
-static void AddStringToDeque(const std::string& s) {
-    std::unique_lock<std::mutex> guard(cs);
-    if (lines.empty()) {
-    	EventSet();
-    }
-    lines.push_back(s);
+///////////////////////////////////
+// Engine thread state
+///////////////////////////////////
+
+//! Input for the engine running on this thread
+static thread_local CInputQueue* pInput=NULL;
+
+//! This function returns true if there is input waiting for the engine running on this thread.
+//!
+//! SetAbortTime() calls it so that a search started with input already waiting is aborted;
+//! input arriving during the search is reported to the abort timer by CInputQueue::Add().
+//! On a search thread, a stop request counts as input.
+bool HasInput() {
+    return (pInput && !pInput->Empty()) || SearchStopRequested();
 }
 
-//! Thread's job: add things to the deque
-static void MoveCinToDeque() {
-    std::string sLine;
-    while (getline(std::cin, sLine))
-    	AddStringToDeque(sLine);
+//! Engines in one process share books, so book writes are serialized.
+//!
+//! Searches, which only read the book, hold it shared. Commands that change the book, or
+//! create computers and so may load a book, hold it exclusively.
+static std::shared_timed_mutex bookMutex;
 
-    // last, post a quit message. Normally we get one from the viewer
-    // but sometimes it doesn't get a chance to before termination.
-    AddStringToDeque("quit");
+///////////////////////////////////
+// CGameX
+///////////////////////////////////
+
+//! Create and run a game for an external viewer talking on stdin and stdout.
+//!
+//! Exits the program when the viewer quits.
+CGameX::CGameX(CComputerDefaults cd) {
+    CInputQueue input;
+    input.SetReader(&abortRound);
+
+    // start up the thread that will give us messages.
+    // We can't really kill a thread which blocks on stdio, so it is never joined.
+    std::thread(&CInputQueue::AddLines, &input, std::ref(std::cin)).detach();
+
+    Run(cd, input, std::cout);
+#ifdef _WIN32
+    _exit(0);
+#else
+    exit(0);
+#endif
 }
 
-//! Get a line of input from the thread that's parsing lines for us.
-static bool GetLineFromThread(std::string& sLine) {
-    EventWait();
-    std::unique_lock<std::mutex> guard(cs);
-    sLine=lines.front();
-    lines.pop_front();
-    if (lines.empty())
-    	EventReset();
-    return true;
+//! Create and run a game for one of several external viewers served by this process.
+//!
+//! Returns when the viewer quits.
+//! \param input lines from the viewer. Its reader should be set to this thread's abortRound
+//!     before lines arrive, so that they don't abort other games' searches.
+//! \param os replies to the viewer. All engine output on this thread goes here.
+CGameX::CGameX(CComputerDefaults cd, CInputQueue& input, std::ostream& os) {
+    Run(cd, input, os);
 }
 
-//! Create and run a game using the alternate game class for external viewers
+//! Run a game using the alternate game class for external viewers, until the viewer quits
+//!
+//! go and hint searches run on a CSearchThread, on a copy of the game, so commands are read
+//! while the engine thinks. stop, ping and commands that change the position or the computer
+//! stop the search at once. Commands that reply wait for the search to finish first.
 //!
 //! User commands:
 //!    - mode <n>: 0=computer inactive, 1=computer plays white, 2=computer plays black, 3=computer plays both
-CGameX::CGameX(CComputerDefaults cd) {
+//!    - stop: stop searching. The search reports its best move so far.
+void CGameX::Run(CComputerDefaults cd, CInputQueue& input, std::ostream& os) {
     CPlayerComputer* pcomp=NULL;
+    pInput=&input;
+    pEngineOut=&os;
+    CSearchThread searchThread(os);
 
     int nboardVersion=0;
     cd.fsPrint=-1&~CSearchInfo::kPrintMove&~CSearchInfo::kPrintGameAnalysis;
@@ -107,17 +154,16 @@ CGameX::CGameX(CComputerDefaults cd) {
     // Initialize with a basic board. That way we're guaranteed to always have a legal game.
     Initialize("8");
 
-    // start up the thread that will give us messages
-    std::thread cinthread(MoveCinToDeque);
-
     std::string sLine;
-    while (GetLineFromThread(sLine)) {
+    for (;;) {
+    	input.Get(sLine);
     	std::istringstream is(sLine);
     	std::string sCommand;
     	is >> sCommand;
 
     	if (sCommand=="analyze") {
-    		std::cout << "status NTest does not support retrograde analysis" << std::endl;
+    		searchThread.Wait();
+    		os << "status NTest does not support retrograde analysis" << std::endl;
     	}
     	else if (sCommand=="go") {
     		// engine tells viewer what move it would make.
@@ -125,12 +171,18 @@ CGameX::CGameX(CComputerDefaults cd) {
     		// (e.g. in nboard, the user could switch to "user plays both colors" mode while the engine is thinking).
     		// any board updates are given by a standard move message.
     		if (pcomp) {
-    			COsMoveListItem mli;
-    			pcomp->GetMoveAndTime(*this, CPlayer::kMyMove | fLearn, mli);
-    			std::cout << "=== " << mli << std::endl;
+    			COsGame game(*this);
+    			searchThread.Add([=, &os]() mutable {
+    				COsMoveListItem mli;
+    				{
+    					std::shared_lock<std::shared_timed_mutex> lock(bookMutex);
+    					pcomp->GetMoveAndTime(game, CPlayer::kMyMove | fLearn, mli);
+    				}
+    				os << "=== " << mli << std::endl;
+    			});
     		}
     		else {
-    			std::cout << "warning Must pick a depth with \"set depth <n>\" first" << std::endl;
+    			os << "warning Must pick a depth with \"set depth <n>\" first" << std::endl;
     		}
     	}
     	else if (sCommand=="hint") {
@@ -139,13 +191,29 @@ CGameX::CGameX(CComputerDefaults cd) {
     		// if it's not the computer's move, he can give hints.
     		//COsMoveListItem mli;
     		//pcomp->GetMoveAndTime(*this, CPlayer::kAnalyze | fLearn, mli);
-    		std::cout << "status Analyzing" << std::endl;
-    		pcomp->Hint(CQPosition(GetPos().board), nBest);
-    		std::cout << "status" << std::endl;
+    		if (pcomp) {
+    			const CQPosition pos(GetPos().board);
+    			searchThread.Add([=, &os]() {
+    				os << "status Analyzing" << std::endl;
+    				{
+    					std::shared_lock<std::shared_timed_mutex> lock(bookMutex);
+    					pcomp->Hint(pos, nBest);
+    				}
+    				os << "status" << std::endl;
+    			});
+    		}
+    		else {
+    			os << "warning Must pick a depth with \"set depth <n>\" first" << std::endl;
+    		}
     	}
     	else if (sCommand=="learn") {
-    		pcomp->EndGame(*this);
-    		std::cout << "learn" << std::endl;
+    		searchThread.Abort();
+    		searchThread.Wait();
+    		if (pcomp) {
+    			std::unique_lock<std::shared_timed_mutex> lock(bookMutex);
+    			pcomp->EndGame(*this);
+    		}
+    		os << "learn" << std::endl;
     	}
     	else if (sCommand=="nboard") {
     		is >> nboardVersion;
@@ -154,33 +222,38 @@ CGameX::CGameX(CComputerDefaults cd) {
     		// this command is not part of the interface standard, but is useful for testing.
     		std::string sBoardType("8");
     		is >> sBoardType;
+    		searchThread.Abort();
     		Initialize(sBoardType.c_str());
     	}
     	else if (sCommand=="ping") {
     		int n;
     		is >> n;
-    		std::cout << "pong " << n << std::endl;
+    		searchThread.Abort();
+    		searchThread.Wait();
+    		os << "pong " << n << std::endl;
     	}
     	else if (sCommand=="quit") {
-    		// We can't really kill a thread which blocks on stdio.
-#ifdef _WIN32
-    		_exit(0);
-#else
-    		exit(0);
-#endif
+    		searchThread.Abort();
+    		searchThread.Wait();
     		break;
     	}
+    	else if (sCommand=="stop") {
+    		searchThread.Abort();
+    	}
     	else if (sCommand=="remove_tree") {
     		if (pcomp && pcomp->book) {
+    			std::unique_lock<std::shared_timed_mutex> lock(bookMutex);
     			pcomp->book->RemoveTree(CQPosition(GetPos().board).BitBoard());
     		}
     	}
     	else if (sCommand=="draw_tree") {
+    		searchThread.Wait();
     		if (pcomp && pcomp->book) {
-    			std::cout<<"--- Draw Tree ---\nAfter ";
+    			std::shared_lock<std::shared_timed_mutex> lock(bookMutex);
+    			os<<"--- Draw Tree ---\nAfter ";
     			for (size_t i=0; i<ml.size(); i++)
-    				std::cout << ml[i].mv << " ";
-    			std::cout << "\n";
+    				os << ml[i].mv << " ";
+    			os << "\n";
 
     			pcomp->book->PrintDrawTree(CQPosition(GetPos().board));
     		}
@@ -189,9 +262,12 @@ CGameX::CGameX(CComputerDefaults cd) {
     		std::string param;
     		is >> param;
     		if (param=="game") {
+    			searchThread.Abort();
     			// board is changing, need to negamax old game to make sure values remain consistent
-    			if (pcomp && pcomp->book)
+    			if (pcomp && pcomp->book) {
+    				std::unique_lock<std::shared_timed_mutex> lock(bookMutex);
     				pcomp->book->NegamaxGame(*this);
+    			}
     			In(is);
     		}
     		else if (param=="depth") {
@@ -202,15 +278,26 @@ CGameX::CGameX(CComputerDefaults cd) {
 
     			is >> depth;
 
-    			std::ostringstream os;
-    			os << c << depth;
-    			cd.sCalcParams=os.str();
+    			std::ostringstream oscp;
+    			oscp << c << depth;
+    			cd.sCalcParams=oscp.str();
 
-    			if (pcomp)
-    				delete pcomp;
-    			pcomp=new CPlayerComputer(cd);
-    			std::cout << "\n";
-    			std::cout << "set myname Ntest" << depth << std::endl;
+    			searchThread.Abort();
+    			searchThread.Wait();
+    			{
+    				std::unique_lock<std::shared_timed_mutex> lock(bookMutex);
+    				if (pcomp)
+    					delete pcomp;
+    				pcomp=new CPlayerComputer(cd);
+    			}
+    			if (cd.booklevel!=CComputerDefaults::kNoBook) {
+    				// a missing book starts empty; tell this viewer, as other sessions' viewers don't need to know
+    				const std::string fnBook=CSmartBook::Filename(cd.cEval, cd.cCoeffSet, *pcomp->pcp);
+    				if (!std::ifstream(fnBook.c_str()))
+    					os << "warning Book " << fnBook << " doesn't exist and starts out empty" << std::endl;
+    			}
+    			os << "\n";
+    			os << "set myname Ntest" << depth << std::endl;
     		}
     		else if (param=="contempt") {
     			float contempt=0;
@@ -219,6 +306,7 @@ CGameX::CGameX(CComputerDefaults cd) {
     			// update both the computer defaults (used for new computers) and the current computer.
     			cd.vContempts[1]=CComputerDefaults::FloatToContempt(contempt);
     			cd.vContempts[0]=-cd.vContempts[1];
+    			searchThread.Wait();
     			if (pcomp) {
     				pcomp->cd.vContempts[0]=cd.vContempts[0];
     				pcomp->cd.vContempts[1]=cd.vContempts[1];
@@ -231,13 +319,21 @@ CGameX::CGameX(CComputerDefaults cd) {
     	else if (sCommand=="move") {
     		COsMoveListItem mli;
     		is >> mli;
+    		searchThread.Abort();
     		Update(mli);
     	}
     	else if (sCommand.size()==2) {
     		COsMoveListItem mli;
     		mli.mv=COsMove(sCommand);
+    		searchThread.Abort();
     		Update(mli);
     	}
     }
-}
 
+    if (pcomp) {
+    	std::unique_lock<std::shared_timed_mutex> lock(bookMutex);
+    	delete pcomp;
+    }
+    pInput=NULL;
+    pEngineOut=&std::cout;
+}
@@ -1,14 +1,45 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+
 #include "odk/OsObjects.h"
 #include "PlayerComputer.h"
 
+//! Lines of input for one engine.
+//!
+//! An input thread adds lines as they arrive; the engine's thread takes them off in order.
+class CInputQueue {
+public:
+	CInputQueue();
+
+	void Add(const std::string& sLine);
+	void AddLines(std::istream& is);
+	void Get(std::string& sLine);
+	bool Empty() const;
+	void SetReader(std::atomic<bool>* pAbortFlag);
+
+private:
+	mutable std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::string> lines;
+	std::atomic<bool>* pAbortFlag;	//!< abortRound of the reading engine's thread, or NULL to signal all searches
+};
+
 //! Alternate game class for use when playing with an external viewer.
 //!
 //! Only one computer is allowed but the user has much more control over what happens
 class CGameX: public COsGame {
 public:
 	CGameX(CComputerDefaults cd);
+	CGameX(CComputerDefaults cd, CInputQueue& input, std::ostream& os);
+
+private:
+	void Run(CComputerDefaults cd, CInputQueue& input, std::ostream& os);
 };
 
-bool HasInput();
\ No newline at end of file
+bool HasInput();
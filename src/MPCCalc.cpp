@@ -1,10 +1,21 @@
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include "core/QPosition.h"
 #include "core/SearchInfo.h"
 #include "core/MPCStats.h"
 #include "core/MVK.h"
 #include "core/CalcParams.h"
+#include "core/PosValue.h"
 
 #include "PlayerComputer.h"
 #include "MPCCalc.h"
@@ -13,172 +24,472 @@
 // Routines
 //////////////////////////////////////////////////////////////////////
 
-void AnalyzePosition(CPlayerComputer* computer, CQPosition& pos) {
-	CMVK mvk;
+//! Calibrates MPC by searching positions from captured.pos to each height up to hMax.
+//!
+//! Positions are shared out to several threads, each with its own computer. Each finished position
+//! is appended to a checkpoint file, so a run that is stopped can be restarted where it left off.
+class CMPCCalibration {
+public:
+	CMPCCalibration(const std::string& fnOut, int hMax);
+
+	bool ReadPositions();
+	void ReadCheckpoint();
+	void Work(CPlayerComputer* computer);
+	bool Write();
+	void Fit() const;
+
+	size_t NPositions() const { return positions.size(); }
+	size_t NDone() const { return rows.size(); }
+
+private:
+	bool NextPosition(int& iPos, CBitBoard& bb);
+	void AddRow(int iPos, const CMPCRow& row);
+
+	std::string fnOut, fnCheckpoint;
+	int hMax;
+	std::vector<std::pair<int, CBitBoard> > positions;	//!< (index in captured.pos, position)
+	size_t iNext;
+	std::map<int, CMPCRow> rows;	//!< finished positions by index in captured.pos
+	std::ofstream osCheckpoint;
+	std::mutex mx;
+};
+
+CMPCCalibration::CMPCCalibration(const std::string& afnOut, int ahMax) : fnOut(afnOut), fnCheckpoint(afnOut+".ckpt"), hMax(ahMax), iNext(0) {
+}
+
+//! Read the first kMaxPositions positions with each number of empties. \return false if captured.pos can't be read
+bool CMPCCalibration::ReadPositions() {
+	std::string fn(fnBaseDir);
+	fn+="captured.pos";
+	FILE* cpFile=fopen(fn.c_str(),"rb");
+	if (!cpFile)
+		return false;
+
+	int nbbs[NN+1]={0};
+	CBitBoard bb;
+	for (int iPos=0; bb.Read(cpFile); iPos++) {
+		if (bb.NEmpty()<=NN && nbbs[bb.NEmpty()]++ < kMaxPositions)
+			positions.push_back(std::make_pair(iPos, bb));
+	}
+	fclose(cpFile);
+	return true;
+}
+
+//! Load the positions finished by an earlier run and open the checkpoint file for appending.
+//!
+//! Each checkpoint line is the index of the position in captured.pos, the number of empties,
+//! and its values. A partial line at the end, from a run that was killed while writing, is ignored.
+void CMPCCalibration::ReadCheckpoint() {
+	std::ifstream is(fnCheckpoint.c_str());
+	std::string line;
+	while (std::getline(is, line)) {
+		if (is.eof())
+			break;
+		std::istringstream isLine(line);
+		int iPos;
+		CMPCRow row;
+		double value;
+		if (!(isLine >> iPos >> row.nEmpty))
+			continue;
+		while (isLine >> value)
+			row.values.push_back(value);
+		rows[iPos]=row;
+	}
+	if (!rows.empty())
+		std::cerr << "Resuming MPC calibration with " << rows.size() << " positions already searched\n";
+
+	osCheckpoint.open(fnCheckpoint.c_str(), std::ios::app);
+}
 
-	std::cout << pos.NEmpty();
-	computer->Clear();
+//! Get the next position that has not been searched. \return false if there are none left
+bool CMPCCalibration::NextPosition(int& iPos, CBitBoard& bb) {
+	std::lock_guard<std::mutex> lock(mx);
+	for (; iNext<positions.size(); iNext++) {
+		if (!rows.count(positions[iNext].first)) {
+			iPos=positions[iNext].first;
+			bb=positions[iNext].second;
+			iNext++;
+			return true;
+		}
+	}
+	return false;
+}
 
-	u4 fNeed=CSearchInfo::kNeedMove+CSearchInfo::kNeedValue+CSearchInfo::kNeedMPCStats;
-	CSearchInfo si=computer->DefaultSearchInfo(pos.BlackMove(), fNeed,1e6, 0);
-	computer->GetChosen(si, pos, mvk, true);
-	printf("\n");
+void CMPCCalibration::AddRow(int iPos, const CMPCRow& row) {
+	std::lock_guard<std::mutex> lock(mx);
+	rows[iPos]=row;
+
+	osCheckpoint << iPos << ' ' << row.nEmpty;
+	for (double value : row.values)
+		osCheckpoint << ' ' << value;
+	osCheckpoint << std::endl;
 	std::cerr << ".";
 }
 
-// preconditions: computer has no book
-void CalcMPCStats(CPlayerComputer* computer, int height) {
-	FILE* 	cpFile;
+//! Thread job: search positions until there are none left
+void CMPCCalibration::Work(CPlayerComputer* computer) {
+	int iPos;
 	CBitBoard bb;
-	int		nbbs[60], i, iPos;
-	const int iPosMin=159;	// start at this line, useful if stopping and restarting
 	CQPosition pos;
-	CCalcParams *cpOld=computer->pcp;
-	CHeightInfo hi(height, 0, false);
-	CCalcParamsFixedHeight cp(hi);
-	computer->pcp=&cp;
-	computer->cd.fsPrint=0;
+	while (NextPosition(iPos, bb)) {
+		pos.Initialize(bb, true);
+		CMVK mvk;
+		CMoves moves;
+		if (pos.CalcMoves(moves)) {
+			// clear the cache so the values don't depend on which positions this thread searched before
+			computer->Clear();
+			u4 fNeed=CSearchInfo::kNeedMove+CSearchInfo::kNeedValue+CSearchInfo::kNeedMPCStats;
+			CSearchInfo si=computer->DefaultSearchInfo(pos.BlackMove(), fNeed,1e6, 0);
+			computer->ValuePosition(si, pos, mvk);
+		}
+
+		// positions with no moves are stored with no values so they aren't searched again after a restart
+		CMPCRow row;
+		row.nEmpty=pos.NEmpty();
+		row.values.assign(mvk.mpcValues.begin(), mvk.mpcValues.end());
+		AddRow(iPos, row);
+	}
+}
 
-	// header info
-	std::cout << 3 << " " << height << " " << kStoneValue << "\n";
+//! Write the stats file in the format read by CMPCStats, in captured.pos order, and remove the checkpoint.
+//!
+//! \return false if it can't be written
+bool CMPCCalibration::Write() {
+	FILE* fp=fopen(fnOut.c_str(), "w");
+	if (!fp)
+		return false;
+	fprintf(fp, "%d %d %d\n", 3, hMax, kStoneValue);
+	for (const auto& it : rows) {
+		fprintf(fp, "%d", it.second.nEmpty);
+		for (double value : it.second.values)
+			fprintf(fp, "\t%d", int(value));
+		fprintf(fp, "\n");
+	}
+	if (fclose(fp)!=0)
+		return false;
 
-	// clear computer's and params
-	//computer->cd.iPruneMidgame=computer->cd.iPruneEndgame=0;
+	osCheckpoint.close();
+	remove(fnCheckpoint.c_str());
+	return true;
+}
 
-	// clear position counts and init
-	for (i=0; i<60; i++)
-		nbbs[i]=0;
-	iPos=0;
+//! Fit the MPC parameters to the data and print them
+void CMPCCalibration::Fit() const {
+	std::vector<CMPCRow> data;
+	for (const auto& it : rows)
+		data.push_back(it.second);
+	CMPCStats(data, hMax, 0).Print(fnOut.c_str());
+}
 
-	// read positions from file; analyze if we should
-	std::string fn(fnBaseDir);
-	fn+="captured.pos";
-	if ((cpFile=fopen(fn.c_str(),"rb"))) {
-		while (bb.Read(cpFile)) {
-			pos.Initialize(bb, true);
-			if (nbbs[bb.NEmpty()]++ < kMaxPositions)
-				if (iPos++>=iPosMin)
-					AnalyzePosition(computer, pos);
-		}
-		fclose(cpFile);
+//! Calculate MPC stats for the computer's evaluator, searching to at most height, using nThreads threads.
+//!
+//! Writes mpc<eval><coefficient set>_<height>.txt to the base directory, to be copied to the
+//! coefficients directory if it's good. If nThreads is 0, use one thread per core.
+void CalcMPCStats(const CComputerDefaults& acd, int height, int nThreads) {
+	if (nThreads<=0)
+		nThreads=std::max(1, int(std::thread::hardware_concurrency()));
+
+	std::ostringstream os;
+	os << fnBaseDir << "mpc" << acd.cEval << acd.cCoeffSet << "_" << height << ".txt";
+	CMPCCalibration calibration(os.str(), height);
+	if (!calibration.ReadPositions()) {
+		std::cerr << "Can't open " << fnBaseDir << "captured.pos\n";
+		return;
 	}
+	calibration.ReadCheckpoint();
+
+	// construct the computers on this thread; finding evaluators is not thread safe
+	CComputerDefaults cd(acd);
+	cd.fsPrint=cd.fsPrintOpponent=0;
+	std::vector<std::unique_ptr<CPlayerComputer> > computers;
+	std::vector<std::thread> threads;
+	for (int i=0; i<nThreads; i++) {
+		computers.emplace_back(new CPlayerComputer(cd));
+		delete computers.back()->pcp;
+		computers.back()->pcp=new CCalcParamsFixedHeight(CHeightInfo(height, 0, false));
+	}
+
+	std::cout << "Calibrating MPC with " << calibration.NPositions() << " positions on " << nThreads << " thread" << (nThreads==1?"":"s") << "\n";
+	for (auto& computer : computers)
+		threads.emplace_back(&CMPCCalibration::Work, &calibration, computer.get());
+	for (std::thread& t : threads)
+		t.join();
+	std::cerr << "\n";
 
-	// restore computer's book and params
-	computer->pcp=cpOld;
+	if (!calibration.Write()) {
+		std::cerr << "Can't write " << os.str() << "\n";
+		return;
+	}
+	std::cout << "Wrote " << calibration.NDone() << " positions to " << os.str() << "\n";
+	calibration.Fit();
 }
 
 const char* fnCapture="captured.pos";
-const char* sPVFile="captured.pv";
-
-// save values of positions in a file
-//	 format:
-//	bitboard (white just moved),  value (to black), pass flag (0,1,2), best move (for mover)
-// precondition: no book (unless you want to add these positions to a book)
-void CalcPosValues(CPlayerComputer* computer, bool fAppend) {
-	FILE* fpCapture, *fpPV;
+const char* sPVFile="captured.pvb";
+
+//! A set of positions, compact enough to hold tens of millions of them.
+//!
+//! Open addressing with linear probing. A board with every square empty can't occur, so it marks unused slots.
+class CPositionSet {
+public:
+	CPositionSet() : slots(1<<16, Unused()), n(0) {}
+
+	//! Add bb to the set. \return false if it was already there
+	bool Insert(const CBitBoard& bb) {
+		if (2*(n+1)>slots.size())
+			Grow();
+		CBitBoard& slot=Find(slots, bb);
+		if (slot==bb)
+			return false;
+		slot=bb;
+		n++;
+		return true;
+	}
+
+private:
+	static CBitBoard Unused() {
+		CBitBoard bb;
+		bb.empty=~u64(0);
+		bb.mover=0;
+		return bb;
+	}
+
+	//! The slot holding bb, or the unused slot where it would go
+	static CBitBoard& Find(std::vector<CBitBoard>& slots, const CBitBoard& bb) {
+		const size_t mask=slots.size()-1;
+		for (size_t i=size_t(bb.Hash())&mask; ; i=(i+1)&mask) {
+			if (slots[i]==bb || slots[i]==Unused())
+				return slots[i];
+		}
+	}
+
+	void Grow() {
+		std::vector<CBitBoard> newSlots(slots.size()*2, Unused());
+		for (const CBitBoard& bb : slots) {
+			if (!(bb==Unused()))
+				Find(newSlots, bb)=bb;
+		}
+		slots.swap(newSlots);
+	}
+
+	std::vector<CBitBoard> slots;
+	size_t n;
+};
+
+//! Searches positions on several threads and writes their values to a file in the order they were added.
+//!
+//! Each thread has its own computer and so its own cache.
+class CPosValuesJob {
+public:
+	CPosValuesJob(FILE* fpOut, u64 nWritten);
+
+	void Add(const CBitBoard& bb);
+	void Run(std::vector<std::unique_ptr<CPlayerComputer> >& computers);
+	void Finish();
+
+private:
+	void Work(CPlayerComputer* computer);
+	void Write(u64 iPos, const CPosValue& pv);
+
+	FILE* fpOut;
+	std::vector<std::thread> threads;
+
+	std::mutex mx;
+	std::condition_variable cvWork, cvSpace;
+	std::deque<std::pair<u64, CBitBoard> > queue;
+	std::map<u64, CPosValue> finished;
+	u64 nAdded, nWritten;
+	size_t nMaxInFlight;
+	bool fDone;
+};
+
+CPosValuesJob::CPosValuesJob(FILE* afpOut, u64 anWritten) : fpOut(afpOut), nAdded(anWritten), nWritten(anWritten), nMaxInFlight(0), fDone(false) {
+}
+
+//! Start a thread for each computer
+void CPosValuesJob::Run(std::vector<std::unique_ptr<CPlayerComputer> >& computers) {
+	nMaxInFlight=computers.size()*64;
+	for (auto& computer : computers)
+		threads.emplace_back(&CPosValuesJob::Work, this, computer.get());
+}
+
+//! Queue a position, waiting if too many are already queued or waiting to be written
+void CPosValuesJob::Add(const CBitBoard& bb) {
+	std::unique_lock<std::mutex> lock(mx);
+	cvSpace.wait(lock, [this]() { return nAdded-nWritten<nMaxInFlight; });
+	queue.push_back(std::make_pair(nAdded++, bb));
+	cvWork.notify_one();
+}
+
+//! Wait until all positions have been searched and written
+void CPosValuesJob::Finish() {
+	{
+		std::lock_guard<std::mutex> lock(mx);
+		fDone=true;
+	}
+	cvWork.notify_all();
+	for (std::thread& t : threads)
+		t.join();
+	threads.clear();
+	fflush(fpOut);
+}
+
+//! Thread job: search queued positions until Finish() is called and the queue is empty
+void CPosValuesJob::Work(CPlayerComputer* computer) {
 	CQPosition pos;
-	CMVK mvk;
 	CMoves moves;
-	int i, quantities[60], pass, nCalced, iAppend;
-	CBitBoard bb;
+	CMVK mvk;
+	for (;;) {
+		std::pair<u64, CBitBoard> item;
+		{
+			std::unique_lock<std::mutex> lock(mx);
+			cvWork.wait(lock, [this]() { return fDone || !queue.empty(); });
+			if (queue.empty())
+				return;
+			item=queue.front();
+			queue.pop_front();
+		}
+
+		CPosValue pv;
+		pv.bb=item.second;
+		pos.Initialize(pv.bb, true);
+		const int pass=pos.CalcMovesAndPass(moves);
 
-	if (fAppend) {
-		// figure out what number to start on
-		std::string fn(fnBaseDir);
-		fn+=sPVFile;
-		fpPV=fopen(fn.c_str(), "rb");
-		fseek(fpPV, 0, SEEK_END);
-		int nFileSize=ftell(fpPV);
-		int nRecordSize=sizeof(bb.mover)+sizeof(bb.empty)+
-			sizeof(mvk.value)+sizeof(pass)+sizeof(mvk.move);
-		if (nFileSize%nRecordSize) {
-			iAppend=0;
-			std::cerr << "Previous .pv file is corrupt, starting again: file size = "
-				<< nFileSize << ", record size = " << nRecordSize
-				<< ", file size % record size = " << nFileSize%nRecordSize << "\n";
+		// if terminal position, calc value
+		if (pass==2) {
+			mvk.value=-pos.TerminalValue();
+			mvk.move.Set(-1);
 		}
+
+		// nonterminal position, get value from computer
 		else {
-			iAppend=nFileSize/nRecordSize;
-			std::cerr << "Appending to previous file with " << iAppend << " elements\n";
+			CSearchInfo si=computer->DefaultSearchInfo(pos.BlackMove(), CSearchInfo::kNeedMove+CSearchInfo::kNeedValue,1e6, 0);
+			computer->GetChosen(si, pos, mvk, true);
+			if (pass==1)
+				mvk.value=-mvk.value;
 		}
-		fclose(fpPV);
-		fpPV=NULL;
+		pv.value=CValueCompact(mvk.value);
+		pv.pass=u1(pass);
+		pv.square=i1(mvk.move.Valid() ? mvk.move.Square() : -1);
+		Write(item.first, pv);
 	}
-	else
-		iAppend=0;
+}
+
+//! Write the position's value if all earlier positions have been written, otherwise hold it until they are
+void CPosValuesJob::Write(u64 iPos, const CPosValue& pv) {
+	std::lock_guard<std::mutex> lock(mx);
+	finished.insert(std::make_pair(iPos, pv));
+	for (auto it=finished.begin(); it!=finished.end() && it->first==nWritten; it=finished.erase(it)) {
+		if (!it->second.Write(fpOut)) {
+			std::string fn(fnBaseDir);
+			fn+=sPVFile;
+			std::cerr << "can't write to file " << fn << "\n";
+			assert(0);
+			_exit(1);
+		}
+		nWritten++;
+
+		// print progress; the file is flushed so an interrupted run loses little
+		if (nWritten%200 == 0) {
+			fflush(fpOut);
+			if (nWritten%10000 == 0)
+				fprintf(stderr, "\nPosition %dk ",int(nWritten/1000));
+			else
+				fprintf(stderr, ".");
+		}
+	}
+	cvSpace.notify_all();
+}
+
+//! Open the position value file.
+//!
+//! If fAppend is set and the file holds values from an earlier run, nDone is set to the number of
+//! complete records and the file is positioned after them; otherwise the file is started again.
+static FILE* OpenPosValues(bool fAppend, u64& nDone) {
+	std::string fn(fnBaseDir);
+	fn+=sPVFile;
+	nDone=0;
+
+	FILE* fp=fAppend ? fopen(fn.c_str(), "r+b") : NULL;
+	if (fp) {
+		if (CPosValue::ReadHeader(fp)) {
+			fseek(fp, 0, SEEK_END);
+			const u64 nFileSize=u64(ftell(fp));
+			nDone=(nFileSize-CPosValue::kHeaderSize)/CPosValue::kRecordSize;
+
+			// a partial record at the end is overwritten
+			fseek(fp, long(CPosValue::kHeaderSize+nDone*CPosValue::kRecordSize), SEEK_SET);
+			std::cerr << "Appending to previous file with " << nDone << " elements\n";
+			return fp;
+		}
+		std::cerr << "Previous " << sPVFile << " file is not a position value file, starting again\n";
+		fclose(fp);
+	}
+
+	fp=fopen(fn.c_str(), "wb");
+	if (fp && !CPosValue::WriteHeader(fp)) {
+		fclose(fp);
+		fp=NULL;
+	}
+	return fp;
+}
+
+//! Save values of the positions in captured.pos to captured.pvb, searching on nThreads threads.
+//!
+//! Positions that are a reflection of an earlier position are skipped. See CPosValue for the format.
+//! If fAppend is set, continue from where an earlier run stopped. If nThreads is 0, use one thread per core.
+//! precondition: no book (unless you want to add these positions to a book)
+void CalcPosValues(const CComputerDefaults& acd, bool fAppend, int nThreads) {
+	int i, quantities[61];
+	u64 nDone, nUnique=0, nDuplicates=0;
+	CBitBoard bb;
+
+	if (nThreads<=0)
+		nThreads=std::max(1, int(std::thread::hardware_concurrency()));
 
 	// clear count
-	for (i=0;i<60; i++)
+	for (i=0;i<=60; i++)
 		quantities[i]=0;
 
 	std::string fn(fnBaseDir);
 	fn+=fnCapture;
-	fpCapture=fopen(fn.c_str(), "rb");
+	FILE* fpCapture=fopen(fn.c_str(), "rb");
 	if (fpCapture) {
-		std::string fn(fnBaseDir);
-		fn+=sPVFile;
-		fpPV=fopen(fn.c_str(), iAppend?"a+bc":"wbc");
+		FILE* fpPV=OpenPosValues(fAppend, nDone);
 		if (fpPV) {
-			for (nCalced=0; bb.Read(fpCapture); ) {
+			// construct the computers on this thread; finding evaluators is not thread safe
+			CComputerDefaults cd(acd);
+			if (nThreads>1)
+				cd.fsPrint=cd.fsPrintOpponent=0;
+			std::vector<std::unique_ptr<CPlayerComputer> > computers;
+			for (i=0; i<nThreads; i++)
+				computers.emplace_back(new CPlayerComputer(cd));
+
+			CPosValuesJob job(fpPV, nDone);
+			job.Run(computers);
+			CPositionSet seen;
+			while (bb.Read(fpCapture)) {
 				if (bb.NEmpty()>60)
 					continue;
+				if (!seen.Insert(CMinimalReflection(bb))) {
+					nDuplicates++;
+					continue;
+				}
 
 				quantities[bb.NEmpty()]++;
-
-				// print progress
-				if (nCalced%200 == 0) {
-					fflush(fpPV);
-					if (nCalced%10000 == 0)
-						fprintf(stderr, "\nPosition %dk ",nCalced/1000);
-					else
-						fprintf(stderr, ".");
-				}
-				//printf("%d", bb.NEmpty());
-
-				if (nCalced>=iAppend) {
-					pos.Initialize(bb,true);
-					pass=pos.CalcMovesAndPass(moves);
-
-					// if terminal position, calc value
-					if (pass==2) {
-						mvk.value=-pos.TerminalValue();
-						mvk.move.Set(-1);
-					}
-
-					// nonterminal position, get value from computer
-					else {
-						CSearchInfo si=computer->DefaultSearchInfo(pos.BlackMove(), CSearchInfo::kNeedMove+CSearchInfo::kNeedValue,1e6, 0);
-						computer->GetChosen(si, pos, mvk, true);
-						if (pass==1)
-							mvk.value=-mvk.value;
-						//printf("NEmpty = %2d; value = %4d; move = ",pos.NEmpty(),mvk.value);
-						//mvk.move.Print();
-						//printf("; pass = %d; time = %2d\n",pass, time(0)-tStart);
-					}
-
-					// write to file
-					if (!bb.Write(fpPV)
-						|| !fwrite(&mvk.value, sizeof(mvk.value), 1, fpPV)
-						|| !fwrite(&pass, sizeof(pass), 1, fpPV)
-						|| !fwrite(&mvk.move, sizeof(mvk.move), 1, fpPV)) {
-						std::string fn(fnBaseDir);
-						fn+=sPVFile;
-						std::cerr << "can't write to file " << fn << "\n";
-						assert(0);
-						_exit(1);
-					}
-				}
-				nCalced++;
+				if (nUnique++>=nDone)
+					job.Add(bb);
 			}
+			job.Finish();
 			fclose(fpPV);
 		}
 		fclose(fpCapture);
 	}
 	// print count
 	int sum=0;
-	for (i=0;i<60; i++) {
+	for (i=0;i<=60; i++) {
 		sum+=quantities[i];
 		printf("%d:%d\n",i,quantities[i]);
 	}
-	printf("%d total positions\n",sum);
+	printf("%d total positions, %d duplicates skipped\n",sum,int(nDuplicates));
 }
@@ -1,5 +1,6 @@
+class CComputerDefaults;
 class CPlayerComputer;
 
-void CalcMPCStats(CPlayerComputer* computer1, int nDepth);
+void CalcMPCStats(const CComputerDefaults& cd, int height, int nThreads);
 void CalcMPCPredictions();
-void CalcPosValues(CPlayerComputer* computer1, bool fAppend);
+void CalcPosValues(const CComputerDefaults& cd, bool fAppend, int nThreads);
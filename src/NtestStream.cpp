@@ -18,33 +18,35 @@ void CNtestStream::HandleGGS(const CMsg* msg) {
 }
 
 void CNtestStream::HandleGGSLogin() {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
     ggsstream::HandleGGSLogin();
     (*this) << "mso\n";
     flush();
 }
 
-void CNtestStream::HandleGGSTell(const CMsgGGSTell& msg) {
-    cout << msg.sFrom << " " << msg.sText << "\n";
+void CNtestStream::HandleGGSTell(const CMsgGGSTell* pmsg) {
+    cout << pmsg->sFrom << " " << pmsg->sText << "\n";
 
     // determine whether the message is from a superuser
-    bool fFromSuperuser=msg.sFrom==sSuperuser;
+    bool fFromSuperuser=pmsg->sFrom==sSuperuser;
     if (sSuperuser.empty())
-    	fFromSuperuser= msg.sFrom=="n2" || msg.sFrom=="adsfadsf" || msg.sFrom=="dan";
+    	fFromSuperuser= pmsg->sFrom=="n2" || pmsg->sFrom=="adsfadsf" || pmsg->sFrom=="dan";
 
     // execute commands from superuser
     if (fFromSuperuser) {
-    	if (msg.sText=="quit")
+    	std::lock_guard<std::mutex> lock(m_sendMutex);
+    	if (pmsg->sText=="quit")
     		Logout();
     	else {
-    		(*this) << msg.sText << "\n";
+    		(*this) << pmsg->sText << "\n";
     		flush();
     	}
     }
 }
 
-void CNtestStream::HandleGGSUnknown(const CMsgGGSUnknown& msg) {
+void CNtestStream::HandleGGSUnknown(const CMsgGGSUnknown* pmsg) {
     cout << "Unknown GGS message: \n";
-    HandleGGS(&msg);
+    HandleGGS(pmsg);
 }
 
 ////////////////////////////
@@ -56,6 +58,9 @@ CNtestStream::CNtestStream() {
 
 void CNtestStream::SetComputer(CPlayerComputer& computer) {
     m_pComputer=&computer;
+    for (int i=0; i<2; i++)
+    	m_searchThreads[i].reset(new CSearchThread(cout));
+
     int open;
     int strength = m_pComputer->pcp->Strength();
 
@@ -70,88 +75,142 @@ void CNtestStream::SetComputer(CPlayerComputer& computer) {
     else
     	open=16;
 
+    std::lock_guard<std::mutex> lock(m_sendMutex);
     (*this) << "ts trust +\n"
     		<< "tell /os open " << open << "\n";
     flush();
 
 }
 
-void CNtestStream::HandleOsGameOver(const CMsgOsMatchDelta& msg,const string& idg) {
-    if (msg.match.IsPlaying(GetLogin()))
-    	PComputer()->EndGame(idToGame[idg]);
-    BaseOsGameOver(&msg, idg);
+void CNtestStream::HandleOsGameOver(const CMsgOsMatchDelta* pmsg,const string& idg) {
+    if (pmsg->match.IsPlaying(GetLogin())) {
+    	// learn on the game's search thread, after its last search
+    	const int iSlot=Slot(idg);
+    	const COsGame game(idToGame[idg]);
+    	m_searchThreads[iSlot]->Add([this, iSlot, game]() {
+    		CPlayerComputer* pComputer=SlotComputer(iSlot);
+    		std::unique_lock<std::shared_timed_mutex> lock(m_bookMutex);
+    		pComputer->EndGame(game);
+    	});
+    }
+    BaseOsGameOver(pmsg, idg);
 }
 
-void CNtestStream::HandleOsJoin(const CMsgOsJoin& msg) {
-    BaseOsJoin(&msg);
-    MakeMoveIfNeeded(msg.idg);
+void CNtestStream::HandleOsJoin(const CMsgOsJoin* pmsg) {
+    BaseOsJoin(pmsg);
+    MakeMoveIfNeeded(pmsg->idg);
 }
 
-void CNtestStream::HandleOsMatchDelta(const CMsgOsMatchDelta& msg) {
-    if (msg.match.IsPlaying(GetLogin()) && msg.fPlus)
-    	PComputer()->StartMatch(msg.match);
-    BaseOsMatchDelta(&msg);
+void CNtestStream::HandleOsMatchDelta(const CMsgOsMatchDelta* pmsg) {
+    if (pmsg->match.IsPlaying(GetLogin()) && pmsg->fPlus)
+    	PComputer()->StartMatch(pmsg->match);
+    BaseOsMatchDelta(pmsg);
 }
 
-void CNtestStream::HandleOsRequestDelta(const CMsgOsRequestDelta& msg) {
-    BaseOsRequestDelta(&msg);
-    bool fGeneric = msg.request.pis[1].sName.empty();
-
-    if (msg.fPlus && (fGeneric || msg.IAmChallenged())) {
-    	if (msg.request.cRated=='S' ||
-    		(msg.RequireBoardSize(8) &&
-    		msg.RequireColor("s?") &&
-    		msg.RequireAnti(false) &&
-    		msg.RequireMaxOpponentClock(COsClock(60*60,0,2*60)) &&
-    		msg.RequireMinMyClock(COsClock(60,0,0)) &&
-    		msg.RequireRandDiscs(4,24)))
-    		(*this) << "t /os accept " << msg.idr << "\n";
+void CNtestStream::HandleOsRequestDelta(const CMsgOsRequestDelta* pmsg) {
+    BaseOsRequestDelta(pmsg);
+    bool fGeneric = pmsg->request.pis[1].sName.empty();
+
+    if (pmsg->fPlus && (fGeneric || pmsg->IAmChallenged())) {
+    	std::lock_guard<std::mutex> lock(m_sendMutex);
+    	if (pmsg->request.cRated=='S' ||
+    		(pmsg->RequireBoardSize(8) &&
+    		pmsg->RequireColor("s?") &&
+    		pmsg->RequireAnti(false) &&
+    		pmsg->RequireMaxOpponentClock(COsClock(60*60,0,2*60)) &&
+    		pmsg->RequireMinMyClock(COsClock(60,0,0)) &&
+    		pmsg->RequireRandDiscs(4,24)))
+    		(*this) << "t /os accept " << pmsg->idr << "\n";
     	else
-    		(*this) << "t /os decline " << msg.idr << "\n";
+    		(*this) << "t /os decline " << pmsg->idr << "\n";
 
     	flush();
     }
 }
 
-void CNtestStream::HandleOsUnknown(const CMsgOsUnknown& msg) {
+void CNtestStream::HandleOsUnknown(const CMsgOsUnknown* pmsg) {
     cout << "Unknown /os message: ";
-    HandleGGS(&msg);
+    HandleGGS(pmsg);
+}
+
+void CNtestStream::HandleOsUpdate(const CMsgOsUpdate* pmsg) {
+    BaseOsUpdate(pmsg);
+    MakeMoveIfNeeded(pmsg->idg);
+}
+
+//! Search thread and computer for a game: 1 for game 1 of a synchro match, otherwise 0
+int CNtestStream::Slot(const string& idg) {
+    size_t loc = idg.find('.',1);
+    if (loc!=idg.npos && loc+1 < idg.size())
+    	return idg[loc+1]=='1';
+    return 0;
 }
 
-void CNtestStream::HandleOsUpdate(const CMsgOsUpdate& msg) {
-    BaseOsUpdate(&msg);
-    MakeMoveIfNeeded(msg.idg);
+//! Computer playing the games in a slot. Only call this on the slot's search thread.
+CPlayerComputer* CNtestStream::SlotComputer(int iSlot) {
+    if (iSlot==0)
+    	return m_pComputer;
+
+    if (!m_pComputer2) {
+    	// the first computer has already negamaxed the shared book
+    	CComputerDefaults cd(m_pComputer->cd);
+    	if (cd.booklevel==CComputerDefaults::kNegamaxBook)
+    		cd.booklevel=CComputerDefaults::kBook;
+    	std::unique_lock<std::shared_timed_mutex> lock(m_bookMutex);
+    	m_pComputer2.reset(new CPlayerComputer(cd));
+    }
+    return m_pComputer2.get();
 }
 
 // helper function for join and update messages
+//
+// The move is searched on the game's search thread, on a copy of the game, and sent from there.
 void CNtestStream::MakeMoveIfNeeded(const string& idg) {
     COsGame* pgame=dynamic_cast<COsGame*>(PGame(idg));
-    
-    // the computer player needs to know if this is game 1 of a synch match
-    //	so it can use the appropriate hashtable
-    bool fSynchGame1=false;
-    size_t loc = idg.find('.',1);
-    if (loc!=idg.npos && loc+1 < idg.size())
-    	fSynchGame1= idg[loc+1]=='1';
 
     assert(pgame);
     if (pgame!=NULL) {
     	bool fMyMove=pgame->ToMove(GetLogin());
-    	COsMoveListItem mli;
 
     	int flags=0;
     	if (fMyMove)
     		flags|=CPlayer::kMyMove;
-    	if (fSynchGame1)
-    		flags|=CPlayer::kGame2;
-    	PComputer()->Update(*pgame, flags, mli);
-
-
-    	if (fMyMove) {
-    		assert(mli.mv.Row()<8);
-    		(*this) << "tell /os play " << idg << " " << mli << "\n";
-    		flush();
-    	}
+    	// the other game of the match is being searched at the same time
+    	if (pgame->mt.fSynch)
+    		flags|=CPlayer::kReadOnlyBook;
+    	// on the opponent's move, think until the thread has something else to do. Pondering
+    	// doesn't change the book, so it mustn't keep the other game's searches waiting for it.
+    	const bool fPonder=!fMyMove && m_pComputer->cd.fPonder;
+    	if (fPonder)
+    		flags|=CPlayer::kReadOnlyBook;
+
+    	const int iSlot=Slot(idg);
+    	COsGame game(*pgame);
+    	auto search=[this, iSlot, game, flags, idg, fPonder]() mutable {
+    		CPlayerComputer* pComputer=SlotComputer(iSlot);
+    		COsMoveListItem mli;
+    		if (flags&CPlayer::kReadOnlyBook) {
+    			std::shared_lock<std::shared_timed_mutex> lock(m_bookMutex);
+    			pComputer->Update(game, flags, mli);
+    			if (fPonder)
+    				pComputer->Ponder(game, flags);
+    		}
+    		else {
+    			std::unique_lock<std::shared_timed_mutex> lock(m_bookMutex);
+    			pComputer->Update(game, flags, mli);
+    		}
+
+    		if (flags&CPlayer::kMyMove) {
+    			assert(mli.mv.Row()<8);
+    			std::lock_guard<std::mutex> lock(m_sendMutex);
+    			(*this) << "tell /os play " << idg << " " << mli << "\n";
+    			flush();
+    		}
+    	};
+    	if (fPonder)
+    		m_searchThreads[iSlot]->AddPonder(search);
+    	else
+    		m_searchThreads[iSlot]->Add(search);
     }
     else
     	assert(0);
@@ -5,27 +5,37 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
 #include "odk/ggsstream.h"
 #include "odk/OsObjects.h"
 #include "odk/OsMessage.h"
+#include "SearchThread.h"
 
 class CPlayerComputer;
 
+//! Plays on GGS.
+//!
+//! Moves are searched on search threads so the stream keeps reading messages while the computer
+//! thinks. Game 1 of a synchro match is played by a second computer on its own thread, so
+//! both games of the match are searched at once.
 class CNtestStream: public ggsstream {
 public:
     CNtestStream();
 
     virtual void HandleGGS				(const CMsg* msg);
     virtual void HandleGGSLogin			();
-    virtual void HandleGGSTell			(const CMsgGGSTell& msg);
-    virtual void HandleGGSUnknown		(const CMsgGGSUnknown& msg);
+    virtual void HandleGGSTell			(const CMsgGGSTell* pmsg);
+    virtual void HandleGGSUnknown		(const CMsgGGSUnknown* pmsg);
 
-    virtual void HandleOsGameOver		(const CMsgOsMatchDelta& msg, const std::string& idg);
-    virtual void HandleOsJoin			(const CMsgOsJoin& msg);
-    virtual void HandleOsMatchDelta		(const CMsgOsMatchDelta& msg);
-    virtual void HandleOsRequestDelta	(const CMsgOsRequestDelta& msg);
-    virtual void HandleOsUnknown		(const CMsgOsUnknown& msg);
-    virtual void HandleOsUpdate			(const CMsgOsUpdate& msg);
+    virtual void HandleOsGameOver		(const CMsgOsMatchDelta* pmsg, const std::string& idg);
+    virtual void HandleOsJoin			(const CMsgOsJoin* pmsg);
+    virtual void HandleOsMatchDelta		(const CMsgOsMatchDelta* pmsg);
+    virtual void HandleOsRequestDelta	(const CMsgOsRequestDelta* pmsg);
+    virtual void HandleOsUnknown		(const CMsgOsUnknown* pmsg);
+    virtual void HandleOsUpdate			(const CMsgOsUpdate* pmsg);
 
     virtual void MakeMoveIfNeeded(const std::string& idg);
 
@@ -35,5 +45,17 @@ public:
     std::string sSuperuser;
 
 private:
+    static int Slot(const std::string& idg);
+    CPlayerComputer* SlotComputer(int iSlot);
+
     CPlayerComputer* m_pComputer;
+    std::unique_ptr<CPlayerComputer> m_pComputer2;          //!< plays game 1 of synchro matches; created when first needed
+    std::unique_ptr<CSearchThread> m_searchThreads[2];      //!< one for each computer
+
+    //! Synchro games search with a read-only book, holding this shared. Searches in other games
+    //! may store to the book, and learning changes it, so they hold it exclusively.
+    std::shared_timed_mutex m_bookMutex;
+
+    //! Held while writing to the stream, since search threads send moves
+    std::mutex m_sendMutex;
 };
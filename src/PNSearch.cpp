@@ -0,0 +1,246 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CPNSearch class
+//////////////////////////////////////////////////////
+
+#include <algorithm>
+#include "n64/flips.h"
+#include "n64/solve.h"
+#include "core/NodeStats.h"
+#include "PNSearch.h"
+
+// proof and disproof numbers of a settled claim; sums are clamped here
+static const u4 kPNInfinity=0x3FFFFFFF;
+
+// at least the number of legal moves in any position
+static const int kMaxChildren=64;
+
+//! \param nBytes size of the transposition table
+//! \param nEmptyLeaf positions with this many empties or fewer are solved by the n64 solver
+CPNSearch::CPNSearch(size_t nBytes, int nEmptyLeaf) : nBytes(nBytes), nEmptyLeaf(nEmptyLeaf), nStartNodes(0), nMaxNodes(0), fStopped(false) {
+    nBuckets=1;
+    while (nBuckets*2*kBucketSize*sizeof(CEntry)<=nBytes)
+        nBuckets*=2;
+    CEntry empty;
+    empty.bb.SetImpossible();
+    empty.pn=empty.dn=empty.work=0;
+    empty.target=0;
+    entries.assign(nBuckets*kBucketSize, empty);
+}
+
+//! Win/loss/draw value of a position.
+//!
+//! \param moves moves to consider from the position; there must be at least one
+//! \param nMaxNodes give up after searching this many nodes (nBBFlips+nSNodes)
+//! \param value [out] kStoneValue if the mover wins, 0 for a draw, -kStoneValue if the mover loses
+//! \param move [out] a move that achieves the value; the first of moves if the mover loses
+//! \return false if the value wasn't found within nMaxNodes, or the search was aborted
+bool CPNSearch::ValueWLD(const CBitBoard& bb, const std::vector<CMove>& moves, u64 nMaxNodes, CValue& value, CMove& move) {
+    assert(!moves.empty());
+    nStartNodes=Nodes();
+    this->nMaxNodes=nMaxNodes;
+    fStopped=false;
+
+    // win? if not, draw?
+    int result=Prove(bb, 1, moves, move);
+    if (result>0) {
+        value=kStoneValue;
+        return true;
+    }
+    if (result==0) {
+        result=Prove(bb, 0, moves, move);
+        if (result>0) {
+            value=0;
+            return true;
+        }
+        if (result==0) {
+            value=-kStoneValue;
+            move=moves[0];
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Prove or disprove that the mover's value is at least target
+//!
+//! \param move [out] if proven, a move that proves it
+//! \return 1 if proven, 0 if disproven, -1 if the search stopped first
+int CPNSearch::Prove(const CBitBoard& bb, int target, const std::vector<CMove>& moves, CMove& move) {
+    u4 pn, dn;
+    int sqBest;
+    MID(bb, target, kPNInfinity, kPNInfinity, &moves, pn, dn, sqBest);
+    if (pn==0) {
+        move.Set(u1(sqBest));
+        return 1;
+    }
+    if (dn==0)
+        return 0;
+    return -1;
+}
+
+//! Multiple iterative deepening: search bb until its proof number reaches thpn or its disproof number reaches thdn.
+//!
+//! Proof numbers are negamaxed: a child's proof number is its parent's disproof number and
+//! vice versa, and the child's claim is that its mover's value is at least 1-target.
+//!
+//! \param pMoves the moves to search, or NULL for all legal moves
+//! \param pn, dn [out] proof and disproof numbers when the search of the node stops
+//! \param sqBest [out] the child with the smallest disproof number, which proves the node if pn==0
+void CPNSearch::MID(const CBitBoard& bb, int target, u4 thpn, u4 thdn, const std::vector<CMove>* pMoves,
+                    u4& pn, u4& dn, int& sqBest) {
+    const u64 nNodesStart=Nodes();
+    sqBest=-1;
+
+    // small positions and game ends are settled by the solver. The root is always expanded, to find the move.
+    const u64 mover=bb.mover;
+    const u64 enemy=bb.getEnemy();
+    u64 moves=mobility(mover, enemy);
+    if (!pMoves && (bb.NEmpty()<=nEmptyLeaf || (!moves && !mobility(enemy, mover)))) {
+        const bool fProven=Solve(bb, target);
+        pn=fProven?0:kPNInfinity;
+        dn=fProven?kPNInfinity:0;
+        Store(bb, target, pn, dn, Nodes()-nNodesStart);
+        return;
+    }
+    Count(Counters().nINodes);
+
+    // generate children
+    CChild children[kMaxChildren];
+    int nChildren=0;
+    if (pMoves) {
+        for (const CMove& move : *pMoves) {
+            CChild& child=children[nChildren++];
+            child.sq=move.Square();
+        }
+    }
+    else if (moves) {
+        while (moves) {
+            CChild& child=children[nChildren++];
+            child.sq=lowBitIndex(moves);
+            moves&=moves-1;
+        }
+    }
+    else {
+        children[nChildren++].sq=-1;
+    }
+    for (int i=0; i<nChildren; i++) {
+        CChild& child=children[i];
+        if (child.sq<0) {
+            child.bb.mover=enemy;
+            child.bb.empty=bb.empty;
+        }
+        else {
+            const u64 flip=flips(child.sq, mover, enemy);
+            child.bb.mover=enemy&~flip;
+            child.bb.empty=bb.empty&~mask(child.sq);
+            Count(Counters().nBBFlips);
+        }
+        InitChild(child, target);
+    }
+
+    // search the most proving child until the node's thresholds are reached
+    while (true) {
+        u4 dnMin=kPNInfinity, dnSecond=kPNInfinity;
+        u64 pnSum=0;
+        int iBest=0;
+        for (int i=0; i<nChildren; i++) {
+            const CChild& child=children[i];
+            pnSum+=child.pn;
+            if (child.dn<dnMin) {
+                dnSecond=dnMin;
+                dnMin=child.dn;
+                iBest=i;
+            }
+            else if (child.dn<dnSecond) {
+                dnSecond=child.dn;
+            }
+        }
+        pn=dnMin;
+        dn=u4(std::min(pnSum, u64(kPNInfinity)));
+        sqBest=children[iBest].sq;
+        if (pn>=thpn || dn>=thdn || fStopped)
+            break;
+        if (Aborted() || Nodes()-nStartNodes>=nMaxNodes) {
+            fStopped=true;
+            break;
+        }
+
+        CChild& child=children[iBest];
+        const u4 thpnChild=u4(std::min(u64(thdn)-dn+child.pn, u64(kPNInfinity)));
+        const u4 thdnChild=std::min(thpn, dnSecond<kPNInfinity ? dnSecond+1 : kPNInfinity);
+        int sqChild;
+        MID(child.bb, 1-target, thpnChild, thdnChild, NULL, child.pn, child.dn, sqChild);
+    }
+
+    // A search over some of the moves proves the claim for the position but can't disprove it, and the table
+    // is kept between searches, where the position may turn up as a child searched over all its moves.
+    if (!pMoves || pn==0 || pMoves->size()==size_t(bitCountInt(mobility(mover, enemy))))
+        Store(bb, target, pn, dn, Nodes()-nNodesStart);
+}
+
+//! Proof and disproof numbers of a child, from the table or, if it's new, from its mobility:
+//!    its mover needs one good move to prove its claim but must have every move refuted to disprove it.
+void CPNSearch::InitChild(CChild& child, int target) const {
+    if (Lookup(child.bb, 1-target, child.pn, child.dn))
+        return;
+    const u64 enemy=child.bb.getEnemy();
+    child.pn=1;
+    child.dn=std::max(1, bitCountInt(mobility(child.bb.mover, enemy)));
+}
+
+//! Null-window solve: is the mover's value at least target?
+bool CPNSearch::Solve(const CBitBoard& bb, int target) {
+    const u4 nSNodesStart=nSNodesQuick;
+    const int value=solveNValue(target-1, target, bb.mover, bb.getEnemy());
+
+    // the solver counts nodes in nSNodesQuick; move them to this thread's counters
+    Count(Counters().nSNodes, u4(nSNodesQuick-nSNodesStart));
+    return value>=target;
+}
+
+size_t CPNSearch::Bucket(const CBitBoard& bb, int target) const {
+    return size_t((bb.Hash()^u64(target))&(nBuckets-1))*kBucketSize;
+}
+
+bool CPNSearch::Lookup(const CBitBoard& bb, int target, u4& pn, u4& dn) const {
+    const CEntry* bucket=&entries[Bucket(bb, target)];
+    for (int i=0; i<kBucketSize; i++) {
+        if (bucket[i].bb==bb && bucket[i].target==target) {
+            pn=bucket[i].pn;
+            dn=bucket[i].dn;
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Save proof and disproof numbers, replacing the entry in the bucket that took the least work if the position isn't there
+void CPNSearch::Store(const CBitBoard& bb, int target, u4 pn, u4 dn, u64 work) {
+    CEntry* bucket=&entries[Bucket(bb, target)];
+    CEntry* pEntry=bucket;
+    for (int i=0; i<kBucketSize; i++) {
+        if (bucket[i].bb==bb && bucket[i].target==target) {
+            pEntry=bucket+i;
+            work+=pEntry->work;
+            break;
+        }
+        if (bucket[i].work<pEntry->work)
+            pEntry=bucket+i;
+    }
+    pEntry->bb=bb;
+    pEntry->target=target;
+    pEntry->pn=pn;
+    pEntry->dn=dn;
+    pEntry->work=u4(std::min(work, u64(0xFFFFFFFF)));
+}
+
+//! Nodes searched by this thread
+u64 CPNSearch::Nodes() const {
+    const CThreadCounters& counters=Counters();
+    return counters.nBBFlips.load(std::memory_order_relaxed)+counters.nSNodes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CPNSearch class
+//////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include "core/BitBoard.h"
+#include "core/Moves.h"
+#include "n64/types.h"
+
+//! Positions with this many empties or fewer are leaves of the proof-number search
+const int kPNLeafEmpties=15;
+
+//! Depth-first proof-number (df-pn) search for the win/loss/draw value of a position.
+//!
+//! A proof-number search grows the tree towards the line that looks cheapest to prove or
+//! disprove, so a clearly won or lost position is usually settled with far fewer nodes than
+//! alpha-beta needs. Close positions are the reverse, so the search gives up when it has
+//! searched nMaxNodes nodes.
+//!
+//! Positions with few empties are settled by the n64 solver with a null window.
+//! Proof and disproof numbers are kept in a transposition table of fixed size, shared by all
+//! nodes of the search; when it is full, the entries that took the least work are replaced.
+class CPNSearch {
+public:
+    CPNSearch(size_t nBytes, int nEmptyLeaf);
+
+    bool ValueWLD(const CBitBoard& bb, const std::vector<CMove>& moves, u64 nMaxNodes, CValue& value, CMove& move);
+    size_t Bytes() const { return nBytes; }
+
+private:
+    //! Transposition table entry: proof and disproof numbers for the claim "the mover's value is at least target"
+    struct CEntry {
+        CBitBoard bb;
+        u4 pn, dn;
+        u4 work;        //!< nodes searched below this position, to choose which entry to replace
+        int target;
+    };
+
+    //! A child of the node being searched
+    struct CChild {
+        CBitBoard bb;
+        int sq;         //!< move to the child, or -1 for a pass
+        u4 pn, dn;
+    };
+
+    enum { kBucketSize=4 };
+
+    int Prove(const CBitBoard& bb, int target, const std::vector<CMove>& moves, CMove& move);
+    void MID(const CBitBoard& bb, int target, u4 thpn, u4 thdn, const std::vector<CMove>* pMoves, u4& pn, u4& dn, int& sqBest);
+    bool Solve(const CBitBoard& bb, int target);
+    void InitChild(CChild& child, int target) const;
+
+    bool Lookup(const CBitBoard& bb, int target, u4& pn, u4& dn) const;
+    void Store(const CBitBoard& bb, int target, u4 pn, u4 dn, u64 work);
+    size_t Bucket(const CBitBoard& bb, int target) const;
+
+    u64 Nodes() const;
+
+    std::vector<CEntry> entries;
+    const size_t nBytes;    //!< size requested from the constructor
+    size_t nBuckets;
+    const int nEmptyLeaf;
+    u64 nStartNodes, nMaxNodes;
+    bool fStopped;
+};
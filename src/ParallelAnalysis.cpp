@@ -0,0 +1,167 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// multithreaded game analysis
+
+#include <algorithm>
+
+#include "core/CalcParams.h"
+#include "core/MVK.h"
+#include "core/SearchInfo.h"
+
+#include "PlayerComputer.h"
+#include "ParallelAnalysis.h"
+
+using namespace std;
+
+// the result cache stops growing at this many positions (about 1GB)
+static const size_t kMaxResults=1<<24;
+
+//! Start nThreads analysis threads, each with a computer built from cd.
+//!
+//! If nThreads is 0, use one thread per core.
+CParallelAnalysis::CParallelAnalysis(const CComputerDefaults& acd, int nThreads, ostream& aos)
+    : os(aos), nAdded(0), nWritten(0), fDone(false), nSearches(0), nResultHits(0) {
+    if (nThreads<=0)
+        nThreads=max(1, int(thread::hardware_concurrency()));
+    nMaxInFlight=nThreads*16;
+
+    // The threads share the book and only read from it; negamaxing it is the job of 'n' mode.
+    // Construct the computers here since finding evaluators and books is not thread safe.
+    CComputerDefaults cd(acd);
+    cd.fsPrint=cd.fsPrintOpponent=0;
+    if (cd.booklevel==CComputerDefaults::kNegamaxBook)
+        cd.booklevel=CComputerDefaults::kBook;
+    for (int i=0; i<nThreads; i++)
+        computers.emplace_back(new CPlayerComputer(cd));
+
+    cout << "Analyzing on " << nThreads << " thread" << (nThreads==1?"":"s") << "\n";
+    for (auto& computer : computers)
+        threads.emplace_back(&CParallelAnalysis::Work, this, computer.get());
+}
+
+CParallelAnalysis::~CParallelAnalysis() {
+    Finish();
+}
+
+//! Queue a game for analysis, waiting if too many games are already queued or waiting to be written
+void CParallelAnalysis::Add(const COsGame& game) {
+    unique_lock<mutex> lock(mx);
+    cvSpace.wait(lock, [this]() { return nAdded-nWritten<nMaxInFlight; });
+    queue.push_back(make_pair(nAdded++, game));
+    cvWork.notify_one();
+}
+
+//! Wait until all games have been analyzed and written
+void CParallelAnalysis::Finish() {
+    {
+        lock_guard<mutex> lock(mx);
+        if (fDone)
+            return;
+        fDone=true;
+    }
+    cvWork.notify_all();
+    for (thread& t : threads)
+        t.join();
+    threads.clear();
+    os.flush();
+
+    cout << nWritten << " games analyzed; " << nSearches << " positions searched, "
+         << nResultHits << " found in the result cache\n";
+}
+
+//! Thread job: analyze queued games until Finish() is called and the queue is empty
+void CParallelAnalysis::Work(CPlayerComputer* computer) {
+    for (;;) {
+        pair<u64, COsGame> item;
+        {
+            unique_lock<mutex> lock(mx);
+            cvWork.wait(lock, [this]() { return fDone || !queue.empty(); });
+            if (queue.empty())
+                return;
+            item=queue.front();
+            queue.pop_front();
+        }
+        Annotate(*computer, item.second);
+        Write(item.first, item.second);
+    }
+}
+
+//! Set the eval of each move in the game to the value of the move to the player who made it
+void CParallelAnalysis::Annotate(CPlayerComputer& computer, COsGame& game) {
+    CQPosition pos(game, 0);
+    for (size_t i=0; i<game.ml.size(); i++) {
+        pos.MakeMove(CMove(game.ml[i].mv));
+        const CValue value=-Value(computer, pos);
+        game.ml[i].dEval=value/double(kStoneValue);
+    }
+    cerr << "a";
+}
+
+//! Value of the position to the mover, from the result cache if possible
+CValue CParallelAnalysis::Value(CPlayerComputer& computer, CQPosition pos) {
+    CMoves moves;
+    switch (pos.CalcMovesAndPass(moves)) {
+    case 2:
+        return -pos.TerminalValue();
+    case 1:
+        return -Value(computer, pos);
+    }
+
+    const CMinimalReflection mr(pos.BitBoard());
+    const CHeightInfo hiNeeded=computer.pcp->MinHeight(pos.NEmpty());
+    CValue value;
+    if (FindResult(mr, hiNeeded, value)) {
+        nResultHits++;
+        return value;
+    }
+
+    CSearchInfo si=computer.DefaultSearchInfo(pos.BlackMove(),
+        CSearchInfo::kNeedValue|CSearchInfo::kNeedMove|CSearchInfo::kNeedReadOnlyBook, 1e6, 0);
+    CMVK mvk;
+    computer.ValuePosition(si, pos, mvk);
+    nSearches++;
+
+    CResult result;
+    result.hi=mvk.hiBest;
+    result.value=mvk.value;
+    StoreResult(mr, result);
+    return mvk.value;
+}
+
+//! Find a value of mr searched to at least hiNeeded
+bool CParallelAnalysis::FindResult(const CBitBoard& mr, const CHeightInfo& hiNeeded, CValue& value) {
+    CResultShard& shard=shards[mr.Hash()%kNShards];
+    lock_guard<mutex> lock(shard.mx);
+    auto it=shard.results.find(mr);
+    if (it==shard.results.end() || it->second.hi<hiNeeded)
+        return false;
+    value=it->second.value;
+    return true;
+}
+
+void CParallelAnalysis::StoreResult(const CBitBoard& mr, const CResult& result) {
+    CResultShard& shard=shards[mr.Hash()%kNShards];
+    lock_guard<mutex> lock(shard.mx);
+    auto it=shard.results.find(mr);
+    if (it!=shard.results.end()) {
+        if (it->second.hi<result.hi)
+            it->second=result;
+    }
+    else if (shard.results.size()<kMaxResults/kNShards) {
+        shard.results.insert(make_pair(mr, result));
+    }
+}
+
+//! Write the game if all earlier games have been written, otherwise hold it until they are
+void CParallelAnalysis::Write(u64 iGame, const COsGame& game) {
+    lock_guard<mutex> lock(mx);
+    finished.insert(make_pair(iGame, game));
+    for (auto it=finished.begin(); it!=finished.end() && it->first==nWritten; it=finished.erase(it)) {
+        os << it->second << "\n";
+        nWritten++;
+    }
+    cvSpace.notify_all();
+}
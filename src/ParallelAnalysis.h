@@ -0,0 +1,84 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// multithreaded game analysis
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core/BitBoard.h"
+#include "core/HeightInfo.h"
+#include "core/QPosition.h"
+#include "odk/OsObjects.h"
+
+class CComputerDefaults;
+class CPlayerComputer;
+
+//! Annotates games with search values on several threads.
+//!
+//! Games are added in order and written to the output stream in the same order, each move's eval
+//! set to the value of the move to the player who made it. Each thread has its own computer; the
+//! computers share the book, which is only read, and a cache of position values keyed by minimal
+//! reflection so positions common to many games are only searched once.
+class CParallelAnalysis {
+public:
+    CParallelAnalysis(const CComputerDefaults& cd, int nThreads, std::ostream& os);
+    ~CParallelAnalysis();
+
+    void Add(const COsGame& game);
+    void Finish();
+    int NThreads() const { return int(computers.size()); }
+
+private:
+    //! A value stored in the shared result cache
+    struct CResult {
+        CHeightInfo hi;
+        CValue value;
+    };
+
+    struct CBitBoardHash {
+        size_t operator()(const CBitBoard& bb) const { return size_t(bb.Hash()); }
+    };
+
+    //! A part of the result cache with its own lock, so threads rarely wait for each other
+    struct CResultShard {
+        std::mutex mx;
+        std::unordered_map<CBitBoard, CResult, CBitBoardHash> results;
+    };
+
+    void Work(CPlayerComputer* computer);
+    void Annotate(CPlayerComputer& computer, COsGame& game);
+    CValue Value(CPlayerComputer& computer, CQPosition pos);
+    bool FindResult(const CBitBoard& mr, const CHeightInfo& hiNeeded, CValue& value);
+    void StoreResult(const CBitBoard& mr, const CResult& result);
+    void Write(u64 iGame, const COsGame& game);
+
+    std::ostream& os;
+    std::vector<std::unique_ptr<CPlayerComputer> > computers;
+    std::vector<std::thread> threads;
+
+    // games waiting to be analyzed, and analyzed games waiting for earlier ones to be written
+    std::mutex mx;
+    std::condition_variable cvWork, cvSpace;
+    std::deque<std::pair<u64, COsGame> > queue;
+    std::map<u64, COsGame> finished;
+    u64 nAdded, nWritten;
+    size_t nMaxInFlight;
+    bool fDone;
+
+    enum { kNShards=64 };
+    CResultShard shards[kNShards];
+    std::atomic<u64> nSearches, nResultHits;
+};
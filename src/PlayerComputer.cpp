@@ -5,10 +5,14 @@
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <mutex>
 #include "core/MPCStats.h"
 #include "core/Cache.h"
+#include "core/Ticks.h"
 #include "core/options.h"
 #include "core/CalcParams.h"
+#include "core/NodeStats.h"
+#include "core/TimeModel.h"
 
 #include "Pos2.h"
 #include "SearchParams.h"
@@ -25,7 +29,7 @@ using namespace std;
 ////////////////////////////////////////
 
 CComputerDefaults::CComputerDefaults() : sCalcParams("s12"), cEval('J'), cCoeffSet('A')
-, iPruneEndgame(5), iPruneMidgame(4), iEdmund(1), booklevel(kNegamaxBook) {
+, iPruneEndgame(5), iPruneMidgame(4), iEdmund(1), booklevel(kNegamaxBook), fReadOnlyBook(false), nRootThreads(1), fPonder(false), fProfile(false), nCacheBytes(0) {
 	vContempts[0]=0;
 	vContempts[1]=0;
 	nRandShifts[0]=nRandShifts[1]=0;
@@ -90,7 +94,7 @@ CPlayerComputer::CPlayerComputer(const CComputerDefaults& acd) {
 
 	caches[0]=caches[1]=NULL;
 	fHasCachedPos[0]=fHasCachedPos[1]=false;
-	std::cout << "status Loading book" << std::endl;
+	EngineOut() << "status Loading book" << std::endl;
 	book=(cd.booklevel!=CComputerDefaults::kNoBook) ? CSmartBook::FindBook(cd.cEval, cd.cCoeffSet, pcp) : NULL;
 	eval=CEvaluator::FindEvaluator(cd.cEval, cd.cCoeffSet);
 	mpcs=CMPCStats::GetMPCStats(cd.cEval, cd.cCoeffSet, std::max(cd.iPruneMidgame, cd.iPruneEndgame));
@@ -111,9 +115,9 @@ CPlayerComputer::CPlayerComputer(const CComputerDefaults& acd) {
 	if (!mpcs) cd.iPruneMidgame=cd.iPruneEndgame=0;
 
 
-	std::cout << "status Negamaxing book" << std::endl;
+	EngineOut() << "status Negamaxing book" << std::endl;
 	SetupBook(cd.booklevel==CComputerDefaults::kNegamaxBook);
-	std::cout << "status" << std::endl;
+	EngineOut() << "status" << std::endl;
 }
 
 CPlayerComputer::~CPlayerComputer() {
@@ -122,7 +126,6 @@ CPlayerComputer::~CPlayerComputer() {
 		if (caches[i])
 			delete caches[i];
 
-	delete mpcs;
 	delete pcp;
 }
 
@@ -164,8 +167,13 @@ void CPlayerComputer::SetContempt(bool fDrawsToBlack) {
 }
 
 CCache* CPlayerComputer::GetCache(int iCache) {
-	if (caches[iCache]==NULL)
-		caches[iCache]=new CCache(1<<LogCacheSize(pcp, cd.iPruneMidgame && cd.iPruneEndgame));
+	if (caches[iCache]==NULL) {
+		u4 lgCacheSize=LogCacheSize(pcp, cd.iPruneMidgame && cd.iPruneEndgame);
+		// a computer sharing the machine with others may get less than the usual size
+		while (cd.nCacheBytes && lgCacheSize>2 && (u64(sizeof(CCacheData))<<lgCacheSize)>cd.nCacheBytes)
+			lgCacheSize--;
+		caches[iCache]=new CCache(1<<lgCacheSize);
+	}
 
 	if (caches[iCache]==NULL) {
 		std::cerr << "out of memory allocating cache " << iCache << " for computer " << Name() << "\n";
@@ -185,9 +193,9 @@ CCache* CPlayerComputer::GetCache(int iCache) {
 //! \param[out] mli - move eval and elapsed time are filled in.
 CPlayer::TCheatcode CPlayerComputer::GetMoveAndTime(COsGame& game, int flags, COsMoveListItem& mli) {
 	CPlayer::TCheatcode result;
-	clock_t t=clock();
+	const i8 tStart=GetTicks();
 	result=GetMove(game, flags, mli);
-	mli.tElapsed=double(clock()-t)/CLOCKS_PER_SEC;
+	mli.tElapsed=SecondsSince(tStart);
 	return result;
 }
 
@@ -195,7 +203,7 @@ CPlayer::TCheatcode CPlayerComputer::GetMoveAndTime(COsGame& game, int flags, CO
 //!
 //! \return see CPlayer::TCheatcode for a description of cheat codes.
 //!
-//! \param[in] flags - combination of CPlayer::kMyMove and CPlayer::Game2
+//! \param[in] flags - combination of CPlayer::kMyMove, CPlayer::Game2 and CPlayer::kReadOnlyBook
 //! \param[in] game - game up to the position to evaluate
 //! \param[out] mli - move and eval are filled in; elapsed time calculated by the calling routine.
 CPlayer::TCheatcode CPlayerComputer::GetMove(COsGame& game, int flags, COsMoveListItem& mli) {
@@ -211,6 +219,8 @@ CPlayer::TCheatcode CPlayerComputer::GetMove(COsGame& game, int flags, COsMoveLi
 	u4 fNeeds=CSearchInfo::kNeedMove;
 	if (flags&CPlayer::kNoAddSoloUnsolvedToBook)
 		fNeeds|=CSearchInfo::kNeedNoAddSoloUnsolvedToBook;
+	if (flags&CPlayer::kReadOnlyBook)
+		fNeeds|=CSearchInfo::kNeedReadOnlyBook;
 	if (game.mt.fRand)
 		fNeeds|=CSearchInfo::kNeedRandSearch;
 	if (fAnalyze)
@@ -248,6 +258,9 @@ CPlayer::TCheatcode CPlayerComputer::GetMove(COsGame& game, int flags, COsMoveLi
 
 //! Display evals for the top nBest moves from a position.
 void CPlayerComputer::Hint(const CQPosition& pos, int nBest) {
+	// the search globals are per thread, and this may be the first search on this thread
+	SetParameters(pos, true, 0);
+
 	CMoves moves;
 	bool fHasMove = pos.CalcMoves(moves);
 
@@ -284,10 +297,77 @@ void CPlayerComputer::Hint(const CQPosition& pos, int nBest) {
 	}
 }
 
+//! Think on the opponent's time: search the position after the opponent's expected reply, as if it were our move.
+//!
+//! The expected reply is the cache's best move for the opponent, left by the search for our last move; if the cache
+//! has none there is nothing to ponder. The search only fills the cache, so if the opponent plays the expected
+//! reply the search for our move finds its early rounds already done, and if not it keeps whatever transposes.
+//! The search may use as long as the opponent has left, and never stores to the book; it is meant to be stopped
+//! when the opponent moves, as CSearchThread::AddPonder() does.
+//!
+//! \param[in] game - game up to the position with the opponent to move
+//! \param[in] flags - as for GetMove(); only CPlayer::kGame2 is used
+void CPlayerComputer::Ponder(const COsGame& game, int flags) {
+	const COsPosition& osPos=game.GetPos();
+	const int iCache=(flags&kGame2)?1:0;
+	CQPosition pos(osPos.board);
+	CMoves moves;
+	if (!pos.CalcMoves(moves))
+		return;
+	SetParameters(pos, !game.mt.fRand, iCache);
+
+	CMove reply;
+	{
+		const u64 hash=pos.BitBoard().Hash();
+		CCacheLock lock(*::cache, hash);
+		const CCacheData* cd=::cache->FindOld(pos.BitBoard(), hash);
+		if (!cd)
+			return;
+		reply=cd->BestMove();
+	}
+	if (!reply.Valid() || !moves.IsValid(reply))
+		return;
+	pos.MakeMove(reply);
+	if (!pos.CalcMoves(moves))
+		return;
+
+	u4 fNeeds=CSearchInfo::kNeedMove|CSearchInfo::kNeedReadOnlyBook;
+	if (game.mt.fRand)
+		fNeeds|=CSearchInfo::kNeedRandSearch;
+	const double tOpponent=osPos.cks[!osPos.board.IsBlackMove()].tCurrent;
+	CSearchInfo si=DefaultSearchInfo(pos.BlackMove(), fNeeds, tOpponent, iCache);
+	si.SetPrintLevel(si.GetPrintLevel()|CSearchInfo::kPrintPondering);
+
+	EngineOut() << "Pondering " << reply << "\n";
+	CMVK mvk;
+	GetChosen(si, pos, mvk, !game.mt.fRand);
+}
+
+//! Value a position by searching all its moves.
+//!
+//! Unlike GetChosen() this never plays a forced opening or a random book move, so the value is
+//! always the search value. The book is still read during the search if the computer has one.
+//! \pre the mover has a legal move
+void CPlayerComputer::ValuePosition(const CSearchInfo& si, const CQPosition& pos, CMVK& mvk) {
+	SetParameters(pos, true, si.iCache);
+
+	CMoves moves;
+	pos.CalcMoves(moves);
+	Pos2 pos2;
+	pos2.Initialize(pos.BitBoard(),pos.BlackMove());
+	IterativeValue(pos2, moves, *pcp, si, mvk, false, 1);
+}
+
 //! Return the computer's default search information
 CSearchInfo CPlayerComputer::DefaultSearchInfo(bool fBlackMove, u4 fNeeds, double tRemaining, int iCache) const {
 	int rs=DefaultRandomness() + cd.nRandShifts[!fBlackMove];
-	return CSearchInfo(cd.iPruneMidgame, cd.iPruneEndgame, rs, cd.vContempts[fBlackMove], fNeeds, tRemaining, iCache, cd.fsPrint);
+	if (cd.fReadOnlyBook)
+		fNeeds|=CSearchInfo::kNeedReadOnlyBook;
+	if (cd.fProfile)
+		fNeeds|=CSearchInfo::kNeedProfile;
+	CSearchInfo si(cd.iPruneMidgame, cd.iPruneEndgame, rs, cd.vContempts[fBlackMove], fNeeds, tRemaining, iCache, cd.fsPrint);
+	si.nRootThreads=cd.nRootThreads;
+	return si;
 }
 
 void CPlayerComputer::GetChosen(const CSearchInfo& si, const CQPosition& pos, CMVK& mvk, bool fUseBook) {
@@ -300,7 +380,7 @@ void CPlayerComputer::GetChosen(const CSearchInfo& si, const CQPosition& pos, CM
 
 	// Print the move
 	if (si.PrintMove()) {
-		cout << (si.PrintPondering()?"Predict: ":"=== ")
+		EngineOut() << (si.PrintPondering()?"Predict: ":"=== ")
 			<< mvk
 			<< setw(3) << pos.NEmpty() << "e: "
 			<< (si.PrintPondering()?"":" ===") << "\n";
@@ -322,8 +402,12 @@ void CPlayerComputer::StartMatch(const COsMatch& match) {
 void CPlayerComputer::EndGame(const COsGame& game) {
 	extern bool fInTournament;
 
-	// save the game to the saved game file
+	timeModel.Save();
+
+	// save the game to the saved game file. Computers playing on other threads may share the file.
 	if (!m_fnSaveGame.empty()) {
+		static std::mutex mxSaveGame;
+		std::lock_guard<std::mutex> lock(mxSaveGame);
 		ofstream os(m_fnSaveGame.c_str(),ios::app);
 		os << game << "\n";
 	}
@@ -378,7 +462,7 @@ void CPlayerComputer::NegamaxAndCorrectBook() {
 }
 
 static void prepareCache() {
-	tSetStale=::cache->NBuckets()*1E-7/dGHz;
+	tSetStale=::cache->NBuckets()*1E-7/timeModel.GHz();
 }
 
 //! Add game to book and print analysis
@@ -398,7 +482,7 @@ bool CPlayerComputer::AnalyzeGame(const COsGame& game) {
 		cerr << "a";
 		if (!book->IsInBook(game)) {
 			fAdded=true;
-			std::cout << "\nstatus Learning " << game.pis[1].sName << "/" << game.pis[0].sName << std::endl;
+			EngineOut() << "\nstatus Learning " << game.pis[1].sName << "/" << game.pis[0].sName << std::endl;
 			Backtrack(game);
 		}
 		if (cd.fsPrint&CSearchInfo::kPrintGameAnalysis)
@@ -416,7 +500,7 @@ void CPlayerComputer::Backtrack(const COsGame& game) {
 		book->SetComputer(this);
 		book->CorrectGame(game, game.sPlace!="Local", nSearches, cd.iEdmund);
 		if (fPrintCorrections)
-			cout << "Done correcting game. " << nSearches << " searches done.\n";
+			EngineOut() << "Done correcting game. " << nSearches << " searches done.\n";
 	}
 }
 
@@ -435,28 +519,28 @@ void CPlayerComputer::PrintAnalysis(const COsGame& game) {
 	start.Read();
 	nMoves = static_cast<int>(game.ml.size());
 
-	cout << "----------- Analyzing Game -----------\n";
+	EngineOut() << "----------- Analyzing Game -----------\n";
 	for (iMove=0; iMove<nMoves; iMove++) {
 		CMove mv(game.ml[iMove].mv);
 		if (pos.NEmpty()<=hSolverStart)
 			break;
 		Pos2 pos2;
 		pos2.Initialize(pos.BitBoard(),pos.BlackMove());
-		cout << "--------- move " << iMove+1 << "--------------\n";
+		EngineOut() << "--------- move " << iMove+1 << "--------------\n";
 		pos2.Print();
 		if (pos.NEmpty()<60 && pos.CalcMoves(moves)) {
 			const CBookData* bd=book->FindData(pos.BitBoard());
 			if (!bd) {
-				cout << "Position not in book\n";
+				EngineOut() << "Position not in book\n";
 				assert(0);
 			}
 			else  {
-				cout << *bd << "\n";
+				EngineOut() << *bd << "\n";
 				book->GetAndPrintSubnodes(pos, 0, -1);
-				cout << "\n";
+				EngineOut() << "\n";
 			}
 		}
-		cout << game.pis[pos.BlackMove()].sName << " played: " << mv << "\n";
+		EngineOut() << game.pis[pos.BlackMove()].sName << " played: " << mv << "\n";
 		pos.MakeMove(mv);
 	}
 
@@ -475,7 +559,7 @@ void CPlayerComputer::SetParameters(const CQPosition& pos, bool fUseBook, int iC
 	fHasCachedPos[iCache]=true;
 	if (caches[!iCache] && fHasCachedPos[!iCache] && posCached[!iCache].IsSuccessor(pos)) {
 		caches[iCache]->CopyData(*(caches[!iCache]));
-		cout << "Cache copy!\n";
+		EngineOut() << "Cache copy!\n";
 	}
 
 	prepareCache();
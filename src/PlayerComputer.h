@@ -1,3 +1,5 @@
+#pragma once
+
 #include "core/QPosition.h"
 #include "core/SearchInfo.h"
 #include "core/MVK.h"
@@ -24,6 +26,11 @@ public:
 	u4 iEdmund;
 	u4 fsPrint, fsPrintOpponent;
 	enum {kNoBook, kBook, kNegamaxBook} booklevel;
+	bool fReadOnlyBook;	//!< searches don't store results in the book; it only changes when games are learned
+	int nRootThreads;	//!< threads searching root moves at once when valuing several moves, e.g. for hints
+	bool fPonder;		//!< think on the opponent's time in games on GGS; see CPlayerComputer::Ponder()
+	bool fProfile;		//!< each search collects a CSearchProfile and prints it when done
+	u64 nCacheBytes;	//!< most memory for each of the computer's caches, or 0 for the usual size
 
 	int MinutesOrDepth() const;
 
@@ -68,6 +75,8 @@ public:
 	CSearchInfo DefaultSearchInfo(bool fBlackMove, u4 fNeeds, double tRemaining, int iCache) const;
 	void GetChosen(const CSearchInfo& si, const CQPosition& pos, CMVK& chosen, bool fUseBook);
 	void Hint(const CQPosition& pos, int nBest);
+	void Ponder(const COsGame& game, int flags);
+	void ValuePosition(const CSearchInfo& si, const CQPosition& pos, CMVK& mvk);
 
 	// Post-game analysis
 	bool AnalyzeGame(const COsGame& game);
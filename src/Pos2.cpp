@@ -80,7 +80,7 @@ void Pos2::MakeMoveBB(int square) {
     m_bb.InvertColors();
  
     m_fBlackMove=!m_fBlackMove;
-    nBBFlips++;
+    Count(Counters().nBBFlips);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
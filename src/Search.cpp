@@ -1,21 +1,30 @@
 #include <algorithm>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "n64/solve.h"
 #include "core/NodeStats.h"
+#include "core/Ticks.h"
 #include "core/CalcParams.h"
 #include "core/Book.h"
 #include "core/Cache.h"
 #include "core/options.h"
 #include "core/MPCStats.h"
+#include "core/SearchProfile.h"
+#include "core/TimeModel.h"
 
-#include "TreeDebug.h"
+#include "options.h"
+#include "PNSearch.h"
 #include "Search.h"
 #include "Evaluator.h"
 
 // book search depths
 const int kBookReadDepth=6;	// maximum depth to read from book
-extern int hBookRead, hBookWrite;
-const int nAbortCheck=1<<14; // check for aborts every few evals
+extern thread_local int hBookRead;
 
 // search params
 extern int hSort;
@@ -90,6 +99,251 @@ void InitFFBonus() {
     }
 }
 
+//////////////////////////////////////
+// profiling
+//////////////////////////////////////
+
+//! Profile a beta cutoff by the move at index iMove (0 = first move searched)
+inline void ProfileCutoff(CSearchProfile::CCell* pCell, int iMove) {
+    if (pCell && !Aborted())
+        pCell->nCutoffs[std::min(iMove, int(CSearchProfile::kCutBuckets)-1)]++;
+}
+
+//! Profile a negascout null-window search, and whether it had to be repeated with the full window
+inline void ProfileNegascout(int height, int nEmpty, bool fResearch) {
+    if (CSearchProfile* pProfile=pSearchProfile) {
+        CSearchProfile::CCell& cell=pProfile->Cell(height, nEmpty);
+        cell.nNullWindow++;
+        if (fResearch)
+            cell.nResearch++;
+    }
+}
+
+//////////////////////////////////////
+// move ordering from earlier cutoffs
+//////////////////////////////////////
+
+//! Moves that have cut off before, used to order moves the cache knows nothing about.
+//!
+//! Each thread keeps a history score for each square, by band of empties, which grows with the
+//! height of every cutoff the square produces; and the last two moves that cut off at each number
+//! of empties (killer moves). The number of empties stands in for the ply: every move except a
+//! pass fills a square. The tables are cleared at the start of each iterative-deepening search, so
+//! a search doesn't depend on what the thread searched before.
+class CMoveHistory {
+public:
+    CMoveHistory() { Clear(); }
+
+    void Clear();
+    void Cutoff(int nEmpty, int height, CMove move);
+
+    //! History score of move with nEmpty empties; always less than 2^30
+    u4 Score(int nEmpty, CMove move) const { return scores[nEmpty/kBandWidth][move.Square()]; }
+    //! i'th killer move with nEmpty empties; invalid if there is none yet
+    CMove Killer(int nEmpty, int i) const { return killers[nEmpty][i]; }
+
+    enum { kBandWidth=8, kNBands=NN/kBandWidth+1, kNKillers=2 };
+
+private:
+    u4 scores[kNBands][NN];
+    CMove killers[NN+1][kNKillers];
+};
+
+void CMoveHistory::Clear() {
+    memset(scores, 0, sizeof(scores));
+    for (int nEmpty=0; nEmpty<=NN; nEmpty++) {
+        for (int i=0; i<kNKillers; i++)
+            killers[nEmpty][i].Set(-2);
+    }
+}
+
+//! Record a beta cutoff by move in a search to the given height
+void CMoveHistory::Cutoff(int nEmpty, int height, CMove move) {
+    u4* bandScores=scores[nEmpty/kBandWidth];
+    bandScores[move.Square()]+=u4(height*height);
+    if (bandScores[move.Square()]>=(1U<<30)) {
+        for (int sq=0; sq<NN; sq++)
+            bandScores[sq]>>=1;
+    }
+
+    CMove* nodeKillers=killers[nEmpty];
+    if (nodeKillers[0]!=move) {
+        nodeKillers[1]=nodeKillers[0];
+        nodeKillers[0]=move;
+    }
+}
+
+static thread_local CMoveHistory moveHistory;
+
+//! Remember a beta cutoff by move, unless the search was aborted and the cutoff may not be real
+inline void RecordCutoff(int nEmpty, int height, CMove move) {
+    if (!Aborted())
+        moveHistory.Cutoff(nEmpty, height, move);
+}
+
+//////////////////////////////////////
+// principal variation
+//////////////////////////////////////
+
+//! Principal variation of each node on the current search path, indexed by the node's height.
+//!
+//! A node's line is its best move followed by the line of the child at height-1, copied when the move
+//! gets an exact value; a forced pass is prepended to the line of the node after the pass, which keeps
+//! the same height. Lines stop early where a value came from the cache, book, solver or an MPC cut.
+class CPVTable {
+public:
+    enum { kMaxHeight=NN+1, kMaxLength=2*NN };
+
+    //! Start a new line for the node at height
+    void Clear(int height) { lengths[height]=0; }
+    void Update(int height, CMove move);
+    void PrependPass(int height);
+    void Line(int height, std::vector<CMove>& line) const;
+    void SetLine(int height, const std::vector<CMove>& line);
+
+private:
+    CMove moves[kMaxHeight][kMaxLength];
+    int lengths[kMaxHeight];
+};
+
+//! The line at height is move followed by the line at height-1
+void CPVTable::Update(int height, CMove move) {
+    assert(height>0 && height<kMaxHeight);
+    const int nChild=std::min(lengths[height-1], kMaxLength-1);
+    moves[height][0]=move;
+    std::copy(moves[height-1], moves[height-1]+nChild, moves[height]+1);
+    lengths[height]=nChild+1;
+}
+
+void CPVTable::PrependPass(int height) {
+    const int n=std::min(lengths[height], kMaxLength-1);
+    std::copy_backward(moves[height], moves[height]+n, moves[height]+n+1);
+    moves[height][0].Set(-1);
+    lengths[height]=n+1;
+}
+
+void CPVTable::Line(int height, std::vector<CMove>& line) const {
+    line.assign(moves[height], moves[height]+lengths[height]);
+}
+
+void CPVTable::SetLine(int height, const std::vector<CMove>& line) {
+    lengths[height]=int(std::min(line.size(), size_t(kMaxLength)));
+    std::copy(line.begin(), line.begin()+lengths[height], moves[height]);
+}
+
+static thread_local CPVTable pvTable;
+
+//! A position on the principal variation of the last completed round, and the move played from it
+struct CPVNode {
+    CPVNode() { move.Set(-2); }
+
+    CBitBoard board;
+    CMove move;
+};
+
+//! Last round's principal variation, indexed by number of empties; moves are invalid where there is none.
+//! Positions on it that aren't in the cache search its move first.
+static thread_local CPVNode pvFollow[NN+1];
+
+static void ClearPVFollow() {
+    for (CPVNode& node : pvFollow)
+        node.move.Set(-2);
+}
+
+//! Follow line, played from pos2, in the next round
+static void SetPVFollow(const Pos2& pos2, const std::vector<CMove>& line) {
+    ClearPVFollow();
+    Pos2 pos=pos2;
+    for (CMove move : line) {
+        if (move.IsPass())
+            pos.PassBB();
+        else {
+            pvFollow[pos.NEmpty()].board=pos.GetBB();
+            pvFollow[pos.NEmpty()].move=move;
+            pos.MakeMoveBB(move.Square());
+        }
+    }
+}
+
+//! Set move to the principal-variation move from pos2 and return true, or return false if pos2 isn't on it
+inline bool PVFollowMove(const Pos2& pos2, CMove& move) {
+    const CPVNode& node=pvFollow[pos2.NEmpty()];
+    if (!node.move.Valid() || node.board!=pos2.GetBB())
+        return false;
+    move=node.move;
+    return true;
+}
+
+//////////////////////////////////////
+// MPC probe results
+//////////////////////////////////////
+
+//! Values of MPC shallow searches, so a node checked again needn't repeat its probe.
+//!
+//! The main cache keeps one entry per position, and the node's own search to the full height
+//! replaces the probe's entry; then the next check of the node, from a re-search or a later
+//! iterative-deepening round, would probe again. This table keeps bounds on the probe value by
+//! position and probe height instead. Bounds don't depend on the window or on iPrune, so one
+//! probe serves the alpha and beta tests at every pruning level.
+//!
+//! The table is direct-mapped and each thread has its own. Clear() empties it at the start of
+//! each iterative-deepening search.
+class CMPCProbes {
+public:
+    CMPCProbes() : generation(0) {}
+
+    void Clear();
+    void Find(const CBitBoard& board, u64 hash, int hCheck, CValue& lBound, CValue& uBound) const;
+    void Store(const CBitBoard& board, u64 hash, int hCheck, CValue lBound, CValue uBound);
+
+    enum { kLogSize=16 };
+
+private:
+    struct CEntry {
+        CBitBoard board;
+        u4 generation;
+        int hCheck;
+        CValue lBound, uBound;
+    };
+
+    size_t Index(u64 hash, int hCheck) const { return size_t((hash+hCheck*0x9E3779B97F4A7C15ULL)>>(64-kLogSize)); }
+
+    std::vector<CEntry> entries;
+    u4 generation;
+};
+
+void CMPCProbes::Clear() {
+    if (entries.empty())
+        entries.resize(size_t(1)<<kLogSize, CEntry());
+    generation++;
+}
+
+//! Set lBound and uBound to what is known of the value of board searched to hCheck; (-kInfinity, kInfinity) if nothing is
+void CMPCProbes::Find(const CBitBoard& board, u64 hash, int hCheck, CValue& lBound, CValue& uBound) const {
+    lBound=-kInfinity;
+    uBound=kInfinity;
+    if (entries.empty())
+        return;
+    const CEntry& entry=entries[Index(hash, hCheck)];
+    if (entry.generation==generation && entry.hCheck==hCheck && entry.board==board) {
+        lBound=entry.lBound;
+        uBound=entry.uBound;
+    }
+}
+
+void CMPCProbes::Store(const CBitBoard& board, u64 hash, int hCheck, CValue lBound, CValue uBound) {
+    if (entries.empty())
+        return;
+    CEntry& entry=entries[Index(hash, hCheck)];
+    entry.board=board;
+    entry.generation=generation;
+    entry.hCheck=hCheck;
+    entry.lBound=lBound;
+    entry.uBound=uBound;
+}
+
+static thread_local CMPCProbes mpcProbes;
+
 ///////////////////////////////////////////////////////////////////////
 // Tree Search Routines
 // Unless otherwise specified, all value routines have the following
@@ -113,14 +367,7 @@ CValue StaticValue(Pos2& pos2, int iff) {
     u4 nMovesPlayer, nMovesOpponent;
     CValue result = 0;
     assert(evaluator);
-    nEvalsQuick++;
-
-    // check for out-of-time condition
-    if (nEvalsQuick>=nAbortCheck) {
-        WipeNodeStats();
-        if (CheckAbort(fPrintAbort))
-            return 0;
-    }
+    Count(Counters().nEvals);
 
     // capture position if we're doing that
     if (fCapturePositions && cpFile && (--nCaptureWait<0)) {
@@ -183,6 +430,7 @@ CValue ValueBookCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, C
     if (height>=hBookRead) {
         CHeightInfo hi(height, iPrune, false);
         if (book->Load(pos2.GetBB(), hi, alpha, beta, best.value, pos2.NEmpty())) {
+            Count(Counters().nBookHits);
             if (fPrintBookReads)
                 printf("br%d!",height-hBookRead);
             return best.value;
@@ -190,7 +438,7 @@ CValue ValueBookCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, C
     }
 
     ValueCacheOrTree(pos2, height, alpha, beta, moves, iPrune, best);
-    assert(abortRound || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
+    assert(Aborted() || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
 
     return best.value;
 }
@@ -216,19 +464,33 @@ void ValueCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
 
     // Check if the position is in cache
     hash=pos2.GetBB().Hash();
-
-    if ((cd=cache->FindOld(pos2.GetBB(), hash))) {
-        // cutoff if we can; otherwise update searchAlpha, searchBeta and set the best move
-        if (cd->Load(height, iPrune, pos2.NEmpty(), alpha, beta, best.move, iffCache, searchAlpha, searchBeta, best.value)) {
-            TREEDEBUG_CACHE;
-            return;
+    CSearchProfile* pProfile=pSearchProfile;
+    if (pProfile) pProfile->Cell(height, pos2.NEmpty()).nCacheProbes++;
+
+    {
+        CCacheLock lock(*cache, hash);
+        if ((cd=cache->FindOld(pos2.GetBB(), hash))) {
+            Count(Counters().nCacheHits);
+            if (pProfile) pProfile->Cell(height, pos2.NEmpty()).nCacheHits++;
+            // cutoff if we can; otherwise update searchAlpha, searchBeta and set the best move
+            if (cd->Load(height, iPrune, pos2.NEmpty(), alpha, beta, best.move, iffCache, searchAlpha, searchBeta, best.value)) {
+                if (pProfile) pProfile->Cell(height, pos2.NEmpty()).nCacheCutoffs++;
+                return;
+            }
+            assert(searchAlpha<searchBeta);
+            moves.SetBest(best.move);
+            assert(pos2.GetBB()==cd->Board());    // consistency check
+        }
+        else {
+            Count(Counters().nCacheMisses);
+            iffCache=0;
+            // on last round's principal variation: search its move first, as if it came from a sorted search
+            CMove pvMove;
+            if (PVFollowMove(pos2, pvMove)) {
+                moves.SetBest(pvMove);
+                iffCache=9;
+            }
         }
-        assert(searchAlpha<searchBeta);
-        moves.SetBest(best.move);
-        assert(pos2.GetBB()==cd->Board());    // consistency check
-    }
-    else {
-        iffCache=0;
     }
 
 
@@ -237,7 +499,8 @@ void ValueCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
         ValueTree(pos2, height, searchAlpha, searchBeta, moves, iffCache, iPrune, best);
     
     // Add to cache if we can
-    if (!abortRound) {
+    if (!Aborted()) {
+        CCacheLock lock(*cache, hash);
         cd=cache->FindNew(pos2.GetBB(),hash,height,iPrune, pos2.NEmpty());
         if (cd) {
             cd->Store(height, iPrune, pos2.NEmpty(), best.move, iffCache, searchAlpha, searchBeta, best.value);
@@ -248,50 +511,104 @@ void ValueCacheOrTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
             #endif
         }
     }
-    assert(abortRound || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
+    assert(Aborted() || iPrune || (height+hSolverStart!=pos2.NEmpty()) || (best.value<=64*kStoneValue && best.value>=-64*kStoneValue));
+}
+
+///////////////////////////////////////////////////////////////////////
+// MPCProbe - null-window search of pos2 to hCheck with window
+//    (probeAlpha, probeAlpha+1), for an MPC test.
+// Inputs:
+//    lBound, uBound - what is known of the value to hCheck
+// Outputs:
+//    lBound, uBound - tightened by the result, which is also kept in mpcProbes
+// Returns:
+//    false if the search was aborted
+///////////////////////////////////////////////////////////////////////
+
+static bool MPCProbe(Pos2& pos2, u64 hash, int hCheck, CValue probeAlpha, const CMoves& moves, CMoveValue& best,
+                     CValue& lBound, CValue& uBound) {
+    CMoves movesCopy=moves;
+    ValueCacheOrTree(pos2, hCheck, probeAlpha, probeAlpha+1, movesCopy, 0, best);
+    if (Aborted())
+        return false;
+
+    CValue lProbe=-kInfinity, uProbe=kInfinity;
+    if (best.value<=probeAlpha)
+        uProbe=best.value;
+    else
+        lProbe=best.value;
+
+    // cache hits inside the searches can make two probes disagree; then keep the new bounds
+    if (std::max(lBound, lProbe)<=std::min(uBound, uProbe)) {
+        lBound=std::max(lBound, lProbe);
+        uBound=std::min(uBound, uProbe);
+    }
+    else {
+        lBound=lProbe;
+        uBound=uProbe;
+    }
+    mpcProbes.Store(pos2.GetBB(), hash, hCheck, lBound, uBound);
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////
 // MPCCheck - determine whether we should do forward pruning.
 // returns:
 //    true if we forward pruned. False otherwise
+// Comments:
+//    Each cut height in the MPC stats is tried in turn. Bounds on the
+//    shallow value are shared by the alpha and beta tests and kept in
+//    mpcProbes, so a test is only searched if the bounds from earlier
+//    probes of the node, including the other test's fail-soft value,
+//    don't decide it.
 ///////////////////////////////////////////////////////////////////////
 
 inline bool MPCCheck(Pos2& pos2, int height, CValue alpha, CValue beta, const CMoves& moves, int& iPrune, CMoveValue& best) {
-    CMoves movesCopy;
     float sd, cr;
-    CValue bound;
+    CValue bound, lBound, uBound;
     int nCut, hCheck;
 
     if (mpcs->BadCutHeight(height))
         return false;
+    CSearchProfile* pProfile=pSearchProfile;
+    const u64 hash=pos2.GetBB().Hash();
 
-    for (nCut=0; nCut<2; nCut++) {
+    for (nCut=0; nCut<kMaxMPCCuts; nCut++) {
         if (!mpcs->GetParams(height, pos2.NEmpty(), nCut, iPrune, hCheck, sd, cr))
             break;
+        mpcProbes.Find(pos2.GetBB(), hash, hCheck, lBound, uBound);
+        if (pProfile) pProfile->MPC(height, iPrune).nChecks++;
 
-        // check alpha cutoff
+        // check alpha cutoff: is the shallow value below bound?
         if (alpha>-kInfinity) {
             bound=CValue((alpha-sd)*cr);
-            movesCopy=moves;
-            ValueCacheOrTree(pos2, hCheck, bound-1, bound, movesCopy, 0, best);
-            if (abortRound)
-                return false;
-            if (best.value<bound) {
+            if (lBound<bound && uBound>=bound) {
+                if (!MPCProbe(pos2, hash, hCheck, bound-1, moves, best, lBound, uBound))
+                    return false;
+                if (pProfile) pProfile->MPC(height, iPrune).nProbes++;
+            }
+            else if (pProfile) pProfile->MPC(height, iPrune).nReused++;
+            if (uBound<bound) {
                 best.value=alpha;
+                Count(Counters().nMPCCuts);
+                if (pProfile) pProfile->MPC(height, iPrune).nCuts++;
                 return true;
             }
         }
-        
-        // check beta cutoff
+
+        // check beta cutoff: is the shallow value above bound?
         if (beta<kInfinity) {
             bound=CValue((beta+sd)*cr);
-            movesCopy=moves;
-            ValueCacheOrTree(pos2, hCheck, bound, bound+1, movesCopy, 0, best);
-            if (abortRound)
-                return false;
-            if (best.value>bound) {
+            if (lBound<=bound && uBound>bound) {
+                if (!MPCProbe(pos2, hash, hCheck, bound, moves, best, lBound, uBound))
+                    return false;
+                if (pProfile) pProfile->MPC(height, iPrune).nProbes++;
+            }
+            else if (pProfile) pProfile->MPC(height, iPrune).nReused++;
+            if (lBound>bound) {
                 best.value=beta;
+                Count(Counters().nMPCCuts);
+                if (pProfile) pProfile->MPC(height, iPrune).nCuts++;
                 return true;
             }
         }
@@ -331,26 +648,23 @@ inline bool ValueMove(Pos2& pos2, int height, int hChild, CValue alpha, CValue b
         //int score_lower_bound = kStoneValue * (2 * static_cast<CValue>(pos2.m_stable_mover) - NN);
         if (score_upper_bound <= best.value) {
             pos2 = save_pos;
+            if (CSearchProfile* pProfile=pSearchProfile) pProfile->Cell(height, save_pos.NEmpty()).nStabilityCuts++;
             return false;
         }
     }
     // get value,possibly using negascout
     if (fNegascout) {
-        TREEDEBUG_BEFORE_NEGASCOUT;
         vChild=ChildValue(pos2, hChild, vSearchAlpha, vSearchAlpha+1, iPrune);
-        TREEDEBUG_AFTER_NEGASCOUT;
-        if (vChild>vSearchAlpha && vChild<beta) {
-            TREEDEBUG_BEFORE;
+        const bool fResearch=vChild>vSearchAlpha && vChild<beta;
+        ProfileNegascout(height, save_pos.NEmpty(), fResearch);
+        if (fResearch) {
             vChild=ChildValue(pos2, hChild, vSearchAlpha, beta, iPrune);
             // it may seem illogical but this appears faster than the more usual code
             // vChild=ChildValue(hChild, vChild, beta, iPrune);
-            TREEDEBUG_AFTER;
         }
     }
     else {
-        TREEDEBUG_BEFORE;
         vChild=ChildValue(pos2, hChild, vSearchAlpha, beta, iPrune);
-        TREEDEBUG_AFTER;
     }
 
     // undo move
@@ -358,15 +672,16 @@ inline bool ValueMove(Pos2& pos2, int height, int hChild, CValue alpha, CValue b
     pos2 = save_pos; 
 
     // check for termination conditions
-    if (abortRound)
+    if (Aborted())
         return true;
     if (vChild>best.value) {
         best.move=move;
         best.value=vChild;
         if (best.value>=beta) {
-            TREEDEBUG_CUTOFF;
             return true;
         }
+        if (vChild>vSearchAlpha)
+            pvTable.Update(height, move);
     }
     return false;
 }
@@ -397,6 +712,10 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
     bool fSort, fSortQuick, fUseBest, fNegascout;
     int iff;
 
+    Count(Counters().nINodes);
+    CheckAbortNodes();
+    CSearchProfile::CCell* pCell=pSearchProfile ? &pSearchProfile->Cell(height, pos2.NEmpty()) : NULL;
+    if (pCell) pCell->nNodes++;
     GetSearchParameters(pos2, height, moves.HasBest(), iPrune, iff, iffCache, fSort, fSortQuick, fUseBest, fNegascout);
     best.value=-kInfinity;
 
@@ -408,11 +727,31 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
         moves.GetNext(move);
         bool fCutoff=ValueMove(pos2, height, hChild, alpha, beta, move, moves, iPrune, false, best);
         if (fCutoff) {
+            ProfileCutoff(pCell, nChecked);
+            RecordCutoff(pos2.NEmpty(), height, best.move);
             return;
         }
         nChecked++;
     }
 
+    // no move from the cache: moves that cut off in sibling positions often cut off here too,
+    // and if one does we save sorting the moves
+    else if (!moves.HasBest()) {
+        for (int iKiller=0; iKiller<CMoveHistory::kNKillers; iKiller++) {
+            move=moveHistory.Killer(pos2.NEmpty(), iKiller);
+            if (!move.Valid() || !moves.IsValid(move))
+                continue;
+            moves.Delete(move);
+            bool fCutoff=ValueMove(pos2, height, hChild, alpha, beta, move, moves, iPrune, fNegascout && nChecked && best.value>=alpha, best);
+            if (fCutoff) {
+                ProfileCutoff(pCell, nChecked);
+                RecordCutoff(pos2.NEmpty(), height, best.move);
+                return;
+            }
+            nChecked++;
+        }
+    }
+
     // best move didn't cut off. value remaining moves
     if (fSort) {
         CMoveValue moveValues[64];
@@ -434,9 +773,12 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
 
                 // Check for ETC (Enhanced Transposition Cutoff). If the move will cause an
                 // immediate hash-table cutoff, we want to do it first.
-                CCacheData* pcd = cache->FindOld(pos2.GetBB(),pos2.GetBB().Hash());
+                const u64 hash=pos2.GetBB().Hash();
+                CCacheLock lock(*cache, hash);
+                CCacheData* pcd = cache->FindOld(pos2.GetBB(),hash);
                 if (pcd && pcd->AlphaCutoff(height-1, iPrune, pos2.NEmpty(), -beta)) {
                     vSubnode-=50*kStoneValue;
+                    if (pCell) pCell->nEtcHits++;
                 }
             }
             moveValues[nMoves].value=-vSubnode;
@@ -445,7 +787,7 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
             pos2 = save_pos;
         }
 
-        if (abortRound) {
+        if (Aborted()) {
             return;
         }
 
@@ -456,15 +798,33 @@ inline void ValueTree(Pos2& pos2, int height, CValue alpha, CValue beta, CMoves&
             move=moveValues[i].move;
             bool fCutoff=ValueMove(pos2, height, hChild, alpha, beta, move, moves, iPrune, fNegascout && nChecked && best.value>=alpha, best);
             if (fCutoff) {
+                ProfileCutoff(pCell, nChecked);
+                RecordCutoff(pos2.NEmpty(), height, best.move);
                 return;
             }
             nChecked++;
         }
     }
-    else {    // not sorting
-        while (moves.GetNext(move)) {
+    else {    // not sorting: corners, then regular squares, then C and X squares as in CMoves::GetNext(), each by history score
+        CMove historyMoves[64];
+        u4 historyKeys[64];
+        for (nMoves=0; moves.GetNext(move); nMoves++) {
+            const u64 m=move.Mask();
+            const u4 moveClass=(m&0x8100000000000081ULL)?2:(m&0x3C3CFFFFFFFF3C3CULL)?1:0;
+            const u4 key=(moveClass<<30) | moveHistory.Score(pos2.NEmpty(), move);
+            for (i=nMoves; i>0 && historyKeys[i-1]<key; i--) {
+                historyMoves[i]=historyMoves[i-1];
+                historyKeys[i]=historyKeys[i-1];
+            }
+            historyMoves[i]=move;
+            historyKeys[i]=key;
+        }
+        for (i=0; i<nMoves; i++) {
+            move=historyMoves[i];
             bool fCutoff=ValueMove(pos2, height, hChild, alpha, beta, move, moves, iPrune, fNegascout && nChecked && best.value>=alpha, best);
             if (fCutoff) {
+                ProfileCutoff(pCell, nChecked);
+                RecordCutoff(pos2.NEmpty(), height, best.move);
                 return;
             }
             nChecked++;
@@ -478,18 +838,82 @@ inline int MmxSolve(CBitBoard m_bb, int alpha, int beta) {
 }
 
 inline CValue SolveValue(Pos2& pos2, CValue alpha, CValue beta) {
-    if (nSNodesQuick>=(nAbortCheck<<4)) {
-        WipeNodeStats();
-        if (CheckAbort(fPrintAbort)) {
-            return 0;
-        }
-    }
     const int mmxBeta=int((beta+10099)/100)-100;
     const int mmxAlpha=int((alpha+10000)/100)-100;
+    const u4 nSNodesStart=nSNodesQuick;
     const CValue result=-MmxSolve(pos2.GetBB(), -mmxBeta, -mmxAlpha)*kStoneValue;
 
+    // the solver counts nodes in nSNodesQuick; move them to this thread's counters
+    Count(Counters().nSNodes, u4(nSNodesQuick-nSNodesStart));
+
     assert(result>-kInfinity);
-    TREEDEBUG_CALLSOLVER;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////
+// CMPCSolvePruner - forward pruning in the n64 solver, for probable solves.
+//    Nodes with enough empties for an MPC cut are tested with MPCCheck
+//    at the solve height, exactly as the midgame search would test them.
+///////////////////////////////////////////////////////////////////////
+
+class CMPCSolvePruner : public SolvePruner {
+public:
+    explicit CMPCSolvePruner(int aiPrune) : SolvePruner(hSolverStart+khMPCMinCut), iPrune(aiPrune), nProbeSNodes(0) {}
+
+    bool prune(int alpha, int beta, u64 mover, u64 enemy, int& value) override;
+
+    int iPrune;
+    u4 nProbeSNodes;    //!< solver nodes searched by the probes, already counted by their own SolveValue()
+};
+
+bool CMPCSolvePruner::prune(int alpha, int beta, u64 mover, u64 enemy, int& value) {
+    // unwind the solve quickly if the search has been aborted
+    if (Aborted()) {
+        value=alpha;
+        return true;
+    }
+
+    CBitBoard bb;
+    bb.mover=mover;
+    bb.empty=~(mover|enemy);
+    Pos2 pos2;
+    pos2.Initialize(bb, true);
+
+    CMoves moves;
+    if (!pos2.CalcMoves(moves))
+        return false;
+
+    const u4 nSNodesStart=nSNodesQuick;
+    CMoveValue best;
+    int iPruneCheck=iPrune;
+    const bool fCut=MPCCheck(pos2, pos2.NEmpty()-hSolverStart, alpha*kStoneValue, beta*kStoneValue, moves, iPruneCheck, best);
+    nProbeSNodes+=nSNodesQuick-nSNodesStart;
+    if (Aborted()) {
+        value=alpha;
+        return true;
+    }
+    if (fCut)
+        value=best.value/kStoneValue;
+    return fCut;
+}
+
+///////////////////////////////////////////////////////////////////////
+// SelectiveSolveValue - probable solve with the n64 solver, pruning
+//    with MPC at iPrune.
+//    Like SolveValue(), the value is to the mover of the node above pos2.
+///////////////////////////////////////////////////////////////////////
+
+inline CValue SelectiveSolveValue(Pos2& pos2, CValue alpha, CValue beta, int iPrune) {
+    const int mmxBeta=int((beta+10099)/100)-100;
+    const int mmxAlpha=int((alpha+10000)/100)-100;
+    const u4 nSNodesStart=nSNodesQuick;
+    CMPCSolvePruner pruner(iPrune);
+    const CBitBoard& bb=pos2.GetBB();
+    const CValue result=-solveNValue(-mmxBeta, -mmxAlpha, bb.mover, bb.getEnemy(), &pruner)*kStoneValue;
+
+    Count(Counters().nSNodes, u4(nSNodesQuick-nSNodesStart-pruner.nProbeSNodes));
+
+    assert(result>-kInfinity || Aborted());
     return result;
 }
 
@@ -508,11 +932,18 @@ inline CValue SolveValue(Pos2& pos2, CValue alpha, CValue beta) {
 CValue ChildValue(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune) {
     CValue result(0);
 
+    pvTable.Clear(height);
+
     // Solver evaluation if near end
     if (pos2.NEmpty()<=hSolverStart) {
         return SolveValue(pos2, alpha, beta);
     }
 
+    // Probable solve near the end: the n64 solver with MPC is faster than the tree search
+    if (iPrune && height+hSolverStart>=pos2.NEmpty() && pos2.NEmpty()<=nEmptySelectiveSolve) {
+        return SelectiveSolveValue(pos2, alpha, beta, iPrune);
+    }
+
     // Static value if no height
     if (height<=0) {
         result=-StaticValue(pos2, 0);
@@ -529,11 +960,12 @@ CValue ChildValue(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune)
         switch(pass) {
         case 0:
             result=-ValueBookCacheOrTree(pos2, height, -beta, -alpha, moves, iPrune);
-            assert(result>-kInfinity || abortRound);
+            assert(result>-kInfinity || Aborted());
             break;
         case 1:
             result=ValueBookCacheOrTree(pos2, height, alpha, beta, moves, iPrune);
-            assert(result>-kInfinity || abortRound);
+            assert(result>-kInfinity || Aborted());
+            pvTable.PrependPass(height);
             break;
         case 2:
             result=pos2.TerminalValue();
@@ -550,13 +982,24 @@ CValue ChildValue(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune)
 
 //! Output intermediate search results to a stream.
 //! <PV> <Value> <NGamesInBook> <Ply>
-static void OutputSearchInfo(std::ostream& os, CMoveValue mv, bool fPassBefore, CHeightInfoX hix) {
+//!
+//! The PV is line, with moves separated by '-', or mv's move if line is empty.
+static void OutputSearchInfo(std::ostream& os, CMoveValue mv, const std::vector<CMove>& line, bool fPassBefore, CHeightInfoX hix) {
     os << "search ";
     if (fPassBefore) {
         os << "PA-";
         mv.value=-mv.value;
     }
-    os << mv.move;
+    if (line.empty())
+        os << mv.move;
+    for (size_t i=0; i<line.size(); i++) {
+        if (i)
+            os << '-';
+        if (line[i].IsPass())
+            os << "PA";
+        else
+            os << line[i];
+    }
 
     const std::streamsize precision=os.precision(2);
     const std::ios_base::fmtflags flags=os.setf(std::ios::showpos);
@@ -568,6 +1011,269 @@ static void OutputSearchInfo(std::ostream& os, CMoveValue mv, bool fPassBefore,
     os << " 0 " << hix << "\n";
 }
 
+//! Principal variation of a root move whose search returned vChild: the move, followed by the
+//! child's line if the value is exact.
+static void RootMoveLine(CMove move, int height, CValue vChild, CValue vSearchAlpha, CValue beta, std::vector<CMove>& line) {
+    if (vChild>vSearchAlpha && vChild<beta)
+        pvTable.Line(height-1, line);
+    else
+        line.clear();
+    line.insert(line.begin(), move);
+}
+
+//! Value of a root move, searched with window (vSearchAlpha, beta), using a null-window search first if fNegascout
+static CValue RootMoveValue(const Pos2& pos2, CMove move, int height, CValue vSearchAlpha, CValue beta, int iPrune, bool fNegascout) {
+    const int hChild=height-1;
+    CValue vChild;
+
+    Pos2 child = pos2;
+    child.MakeMoveBB(move.Square());
+    if (fNegascout && vSearchAlpha>-kInfinity) {
+        vChild=ChildValue(child, hChild, vSearchAlpha, vSearchAlpha+1, iPrune);
+        assert(vChild>-kInfinity || Aborted());
+        const bool fResearch=vChild>vSearchAlpha && vChild<beta;
+        ProfileNegascout(height, pos2.NEmpty(), fResearch);
+        if (fResearch) {
+            vChild=ChildValue(child, hChild, vChild, beta, iPrune);
+            assert(vChild>-kInfinity || Aborted());
+        }
+    }
+    else {
+        vChild=ChildValue(child, hChild, vSearchAlpha, beta, iPrune);
+        assert(vChild>-kInfinity || Aborted());
+    }
+    return vChild;
+}
+
+//! Value to report for a root move whose search returned vChild, given its value from the previous round
+static CValue ClampedValue(CValue vChild, CValue vPrevious, CValue alpha, CValue beta) {
+    // beta-clamp the value. If value>=beta then we use max(previous round's value, this round's value)
+    // unless beta>=64 stones in which case just use this round's value
+    if (vChild>=beta && beta<64*kStoneValue && vPrevious>vChild)
+        return vPrevious;
+
+    // alpha-clamp the value. If value<=alpha then we use min(previous round's value, this round's value)
+    // unless alpha<=64 stones in which case just use this round's value
+    if (vChild<=alpha && alpha>-64*kStoneValue && vPrevious<vChild)
+        return vPrevious;
+
+    return vChild;
+}
+
+//! Threads that search root moves for ValueMultiParallel(), kept from one call to the next.
+//!
+//! Each searching thread has its own workers, so engines in one process never wait for each other's.
+//! Idle workers sleep on a condition variable. While a worker runs a job its abortRound is linked to the
+//! owner's, so the timer or input stops the workers as soon as it stops the owner, and when it finishes its
+//! nodes are added to the owner's nHelperNodes.
+class CRootWorkers {
+public:
+    CRootWorkers() : pJob(NULL), pOwnerAbort(NULL), pOwnerCounters(NULL), nToStart(0), nRunning(0), fQuit(false) {}
+    ~CRootWorkers();
+
+    void Run(int nThreads, const std::function<void()>& job);
+
+private:
+    void Loop();
+
+    std::mutex mx;
+    std::condition_variable cvWork, cvDone;
+    std::vector<std::thread> threads;
+    const std::function<void()>* pJob;
+    std::atomic<bool>* pOwnerAbort;
+    CThreadCounters* pOwnerCounters;
+    int nToStart;       //!< workers still to pick up the job
+    int nRunning;       //!< workers that haven't finished the job
+    bool fQuit;
+};
+
+CRootWorkers::~CRootWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mx);
+        fQuit=true;
+    }
+    cvWork.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+//! Run job on nThreads workers at once and wait for them all to return, starting workers if there are too few
+void CRootWorkers::Run(int nThreads, const std::function<void()>& job) {
+    std::unique_lock<std::mutex> lock(mx);
+    while (int(threads.size())<nThreads)
+        threads.push_back(std::thread(&CRootWorkers::Loop, this));
+    pJob=&job;
+    pOwnerAbort=&abortRound;
+    pOwnerCounters=&Counters();
+    nToStart=nRunning=nThreads;
+    cvWork.notify_all();
+    while (nRunning)
+        cvDone.wait(lock);
+}
+
+void CRootWorkers::Loop() {
+    std::unique_lock<std::mutex> lock(mx);
+    for (;;) {
+        while (!nToStart && !fQuit)
+            cvWork.wait(lock);
+        if (fQuit)
+            break;
+        nToStart--;
+        const std::function<void()>& job=*pJob;
+        std::atomic<bool>* const pAbort=pOwnerAbort;
+        CThreadCounters* const pCounters=pOwnerCounters;
+        lock.unlock();
+
+        LinkAbort(pAbort);
+        const u64 nNodesStart=SearchNodes();
+        job();
+        pCounters->nHelperNodes.fetch_add(SearchNodes()-nNodesStart, std::memory_order_relaxed);
+        UnlinkAbort();
+
+        lock.lock();
+        if (--nRunning==0)
+            cvDone.notify_one();
+    }
+}
+
+//! ValueMulti() with the root moves searched by nThreads threads at once.
+//!
+//! Each thread takes the next unsearched move, with the search alpha given by the moves valued so far,
+//! and shares this thread's cache, book and evaluator. This thread waits; the workers are this thread's
+//! CRootWorkers, which an abort of this thread also stops.
+//! Results are the same as ValueMulti()'s except that a move may be searched with a lower alpha than it
+//! would have been if its predecessors had finished first; its value is then exact rather than an alpha cutoff.
+static void ValueMultiParallel(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u4 nBest, const std::vector<CMoveValue>& mvs
+                , bool fPrintBestMoves, bool fPassBefore, std::vector<CMoveValue>& mvsEvaluated, u4& nValued, int nThreads) {
+    const bool fNegascout=height>=hNegascout;
+    const bool fWld=std::max(abs(alpha), abs(beta))<64*kStoneValue;
+    const bool fNegascoutRound=(alpha>=0) || (beta<=0);
+    const CHeightInfoX hix(height, iPrune, fWld, pos2.NEmpty());
+
+    // this thread's search parameters, for the workers
+    CBook* const pBook=book;
+    CCache* const pCache=cache;
+    CEvaluator* const pEvaluator=evaluator;
+    CMPCStats* const pMpcs=mpcs;
+    const int hRead=hBookRead;
+    std::ostream& os=EngineOut();
+    const CPVNode* const pFollow=pvFollow;
+    CSearchProfile* const pProfile=pSearchProfile;
+
+    // state shared by the workers, protected by mx
+    std::mutex mx;
+    size_t iNext=0;             // index in mvs of the next move to search
+    bool fStop=false;           // no more moves will be searched, and searches in progress are abandoned
+    std::vector<std::atomic<bool>*> pAborts;    // abortRound of each worker
+    std::vector<char> fValued(mvs.size(), false), fLow(mvs.size(), false);
+    std::vector<CMoveValue> results(mvs.size());
+    std::vector<std::vector<CMove> > lines(mvs.size());
+
+    // stop the workers; called with mx held
+    auto Stop=[&]() {
+        fStop=true;
+        for (std::atomic<bool>* pAbort : pAborts)
+            pAbort->store(true, std::memory_order_relaxed);
+    };
+
+    mvsEvaluated.clear();
+
+    const std::function<void()> Work=[&]() {
+        book=pBook;
+        cache=pCache;
+        evaluator=pEvaluator;
+        mpcs=pMpcs;
+        hBookRead=hRead;
+        pEngineOut=&os;
+        std::copy(pFollow, pFollow+NN+1, pvFollow);
+        mpcProbes.Clear();
+
+        // each worker profiles into its own copy, added to this thread's profile when it's done
+        std::unique_ptr<CSearchProfile> profile(pProfile ? new CSearchProfile : NULL);
+        CProfileScope profileScope(profile.get());
+
+        std::unique_lock<std::mutex> lock(mx);
+        pAborts.push_back(&abortRound);
+        while (!fStop && iNext<mvs.size()) {
+            const CValue vSearchAlpha=mvsEvaluated.size()<nBest ? alpha : std::max(mvsEvaluated[nBest-1].value, alpha);
+            if (vSearchAlpha>=beta)
+                break;
+            const size_t iMove=iNext++;
+            const CMoveValue& mvOld=mvs[iMove];
+
+            lock.unlock();
+            const CValue vChild=RootMoveValue(pos2, mvOld.move, height, vSearchAlpha, beta, iPrune, fNegascout);
+            std::vector<CMove> line;
+            RootMoveLine(mvOld.move, height, vChild, vSearchAlpha, beta, line);
+            lock.lock();
+            if (Aborted())
+                break;
+
+            CMoveValue mv;
+            mv.move=mvOld.move;
+            mv.value=ClampedValue(vChild, mvOld.value, alpha, beta);
+
+            // print out round results, unless this is a 100% negascout round; see ValueMulti()
+            if (fPrintBestMoves && !fNegascoutRound) {
+                if (vChild>vSearchAlpha || iMove<nBest)
+                    OutputSearchInfo(os, mv, line, fPassBefore, hix);
+            }
+            if (vChild>vSearchAlpha) {
+                fValued[iMove]=true;
+                results[iMove]=mv;
+                lines[iMove].swap(line);
+                mvsEvaluated.insert(upper_bound(mvsEvaluated.begin(),mvsEvaluated.end(),mv),mv);
+                // beta cutoff when iPrune==0, see notes for ValueMulti()
+                if (iPrune==0 && mvsEvaluated.size()>=nBest && mvsEvaluated[nBest-1].value>=beta)
+                    Stop();
+            }
+            else {
+                if (mvOld.value<vChild)
+                    mv.value=mvOld.value;
+                fLow[iMove]=true;
+                results[iMove]=mv;
+            }
+        }
+        pAborts.erase(std::find(pAborts.begin(), pAborts.end(), &abortRound));
+        if (profile)
+            pProfile->Add(*profile);
+    };
+
+    static thread_local CRootWorkers workers;
+    pCache->SetShared(true);
+    workers.Run(nThreads, Work);
+    pCache->SetShared(false);
+
+    // Valued moves stably sorted by value, then moves that suffered alpha-cutoff and unsearched moves in their original order
+    mvsEvaluated.clear();
+    for (size_t i=0; i<mvs.size(); i++) {
+        if (fValued[i])
+            mvsEvaluated.push_back(results[i]);
+    }
+    std::stable_sort(mvsEvaluated.begin(), mvsEvaluated.end());
+    nValued = static_cast<u4>(mvsEvaluated.size());
+    pvTable.Clear(height);
+    for (size_t i=0; i<mvs.size() && nValued; i++) {
+        if (fValued[i] && mvs[i].move==mvsEvaluated[0].move)
+            pvTable.SetLine(height, lines[i]);
+    }
+    if (nValued<nBest && !Aborted()) {
+        if (alpha>-kInfinity)
+            nValued=nBest;
+        else
+            assert(0);
+    }
+    for (size_t i=0; i<mvs.size(); i++) {
+        if (fLow[i])
+            mvsEvaluated.push_back(results[i]);
+    }
+    for (size_t i=0; i<mvs.size(); i++) {
+        if (!fValued[i] && !fLow[i])
+            mvsEvaluated.push_back(mvs[i]);
+    }
+    assert(mvsEvaluated.size() || Aborted());
+}
+
 ///////////////////////////////////////////////////////////////////////
 //! values a set of moves and return the best values.
 // Inputs:
@@ -577,6 +1283,8 @@ static void OutputSearchInfo(std::ostream& os, CMoveValue mv, bool fPassBefore,
 //            be in order (for best performance) so pass the result from the previous height in
 //! \param fPrintBestMoves true if the routine should print search updates as it goes through the moves
 //! \param fPassBefore if true, updates are printed with a preceding "PA-" and the negative of the value is printed.
+//! \param nThreads number of threads searching moves at once. More than one is only used when nBest>1;
+//!    see ValueMultiParallel().
 //!
 //! \note if iPrune==0 the routine will return as soon as nBest moves have been found with value>=beta.
 //!
@@ -591,10 +1299,9 @@ static void OutputSearchInfo(std::ostream& os, CMoveValue mv, bool fPassBefore,
 ///////////////////////////////////////////////////////////////////////
 
 void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u4 nBest, const std::vector<CMoveValue>& mvs
-                , bool fPrintBestMoves, bool fPassBefore, std::vector<CMoveValue>& mvsEvaluated, u4& nValued) {
+                , bool fPrintBestMoves, bool fPassBefore, std::vector<CMoveValue>& mvsEvaluated, u4& nValued, int nThreads) {
     CValue vChild, vSearchAlpha = alpha;
     CMove    move;
-    int hChild;
     std::vector<CMoveValue> mvsLow;
     CMoveValue mv;
     std::vector<CMoveValue>::const_iterator i;
@@ -602,17 +1309,25 @@ void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u
     const bool fDebugPrint=false;
     const bool fWld=std::max(abs(alpha), abs(beta))<64*kStoneValue;
     const bool fNegascoutRound=(alpha>=0) || (beta<=0);
+    std::vector<CMove> line;
 
     if (fDebugPrint) {
-        std::cout << "ValueMulti(" <<height<< "," <<alpha<< "," <<beta<< "," <<iPrune<< "," <<nBest<< ")\n";
+        EngineOut() << "ValueMulti(" <<height<< "," <<alpha<< "," <<beta<< "," <<iPrune<< "," <<nBest<< ")\n";
         //Print();
     }
 
-    hChild=height-1;
+    // node-limited searches must stop at the same point every time, so they stay on this thread
+    nThreads=std::min(nThreads, int(mvs.size()));
+    if (nThreads>1 && nBest>1 && nAbortNodes==kNoNodeLimit) {
+        ValueMultiParallel(pos2, height, alpha, beta, iPrune, nBest, mvs, fPrintBestMoves, fPassBefore, mvsEvaluated, nValued, nThreads);
+        return;
+    }
+
     mvsEvaluated.erase(mvsEvaluated.begin(), mvsEvaluated.end());
+    pvTable.Clear(height);
 
     // test moves in order
-    for (i=mvs.begin(); i!=mvs.end() && !abortRound; i++) {
+    for (i=mvs.begin(); i!=mvs.end() && !Aborted(); i++) {
 
         // calculate the move and search alpha
         if (mvsEvaluated.size()<nBest)
@@ -625,51 +1340,17 @@ void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u
         move=i->move;
 
         if (fDebugPrint)
-            std::cout << move << ": " ;
+            EngineOut() << move << ": " ;
 
-        // make move
-        Pos2 saved_pos = pos2;
-        pos2.MakeMoveBB(move.Square());
-        // get value,possibly using negascout
-        if (fNegascout && vSearchAlpha>-kInfinity) {
-            TREEDEBUG_BEFORE_NEGASCOUT;
-            vChild=ChildValue(pos2, hChild, vSearchAlpha, vSearchAlpha+1, iPrune);
-            assert(vChild>-kInfinity || abortRound);
-            TREEDEBUG_AFTER_NEGASCOUT;
-            if (vChild>vSearchAlpha && vChild<beta) {
-                TREEDEBUG_BEFORE;
-                vChild=ChildValue(pos2, hChild, vChild, beta, iPrune);
-                assert(vChild>-kInfinity || abortRound);
-                TREEDEBUG_AFTER;
-            }
-        }
-        else {                
-            TREEDEBUG_BEFORE;
-            vChild=ChildValue(pos2, hChild, vSearchAlpha, beta, iPrune);
-            assert(vChild>-kInfinity || abortRound);
-            TREEDEBUG_AFTER;
-        }
+        vChild=RootMoveValue(pos2, move, height, vSearchAlpha, beta, iPrune, fNegascout);
         if (fDebugPrint)
-            std::cout << vChild << "\t";
+            EngineOut() << vChild << "\t";
 
-        // undo move
-        pos2 = saved_pos;
         // add to the list of values
-        if (!abortRound) {
+        if (!Aborted()) {
             mv.move=move;
-            mv.value=vChild;
-
-            // beta-clamp the value. If value>=beta then we use max(previous round's value, this round's value)
-            // unless beta>=64 stones in which case just use this round's value
-            if (vChild>=beta && beta<64*kStoneValue && i->value>vChild) {
-                mv.value=i->value;
-            }
-
-            // alpha-clamp the value. If value<=alpha then we use min(previous round's value, this round's value)
-            // unless alpha<=64 stones in which case just use this round's value
-            if (vChild<=alpha && alpha>-64*kStoneValue && i->value<vChild) {
-                mv.value=i->value;
-            }
+            mv.value=ClampedValue(vChild, i->value, alpha, beta);
+            RootMoveLine(move, height, vChild, vSearchAlpha, beta, line);
 
             // print out round results, unless this is a 100% negascout round
             // there's no generic output symbol for a 100% negascout round.
@@ -677,11 +1358,13 @@ void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u
                 // print if the move's value is >=alpha (means we have a reasonable value for it)
                 // or if it's one of the first nBest moves (means it's a WLD round and we have a WLD value)
                 if (vChild>vSearchAlpha || i<mvs.begin()+nBest) {
-                    OutputSearchInfo(std::cout, mv, fPassBefore, CHeightInfoX(height, iPrune, fWld, pos2.NEmpty()));
+                    OutputSearchInfo(EngineOut(), mv, line, fPassBefore, CHeightInfoX(height, iPrune, fWld, pos2.NEmpty()));
                 }
             }
             if (vChild>vSearchAlpha) {
-                mvsEvaluated.insert(upper_bound(mvsEvaluated.begin(),mvsEvaluated.end(),mv),mv);
+                // the root's line is the line of the best move so far
+                if (mvsEvaluated.insert(upper_bound(mvsEvaluated.begin(),mvsEvaluated.end(),mv),mv)==mvsEvaluated.begin())
+                    pvTable.SetLine(height, line);
                 // beta cutoff when iPrune==0, see notes for this routine
                 if (iPrune==0 && mvsEvaluated.size()>=nBest && mvsEvaluated[nBest-1].value>=beta)
                     break;
@@ -696,23 +1379,65 @@ void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u
     }
 
     if (fDebugPrint)
-        std::cout << "\nmvsEvaluated: " << mvsEvaluated << "\nmvsLow" << mvsLow << "\n";
+        EngineOut() << "\nmvsEvaluated: " << mvsEvaluated << "\nmvsLow" << mvsLow << "\n";
 
     // prepare to return
     nValued = static_cast<u4>(mvsEvaluated.size());
-    if (nValued<nBest && !abortRound) {
+    if (nValued<nBest && !Aborted()) {
         if (alpha>-kInfinity)
             nValued=nBest;
         else
             assert(0);
     }
-    assert(abortRound || nValued>=nBest || alpha>-kInfinity);
+    assert(Aborted() || nValued>=nBest || alpha>-kInfinity);
     mvsEvaluated.insert(mvsEvaluated.end(),mvsLow.begin(),mvsLow.end());
-    assert(mvsEvaluated.size() || abortRound);
+    assert(mvsEvaluated.size() || Aborted());
     // If we had a beta cutoff,some moves weren't even tried, put them last.
     mvsEvaluated.insert(mvsEvaluated.end(),i,mvs.end());
 }
 
+//! Value the root of a full-width WLD round with a proof-number search, instead of ValueMulti().
+//!
+//! \param nMaxNodes give up if the position isn't settled in this many nodes
+//! \return false if the proof-number search gave up or was aborted; then mvsEvaluated and nValued are unchanged.
+//!    Otherwise they are set as ValueMulti(pos2, height, -kStoneValue, kStoneValue, 0, 1, mvs, ...) would set them:
+//!    the move that achieves the WLD value, then the other moves in their original order.
+static bool PNValueMulti(Pos2& pos2, int height, u64 nMaxNodes, const std::vector<CMoveValue>& mvs, bool fPrintBestMoves,
+                         bool fPassBefore, std::vector<CMoveValue>& mvsEvaluated, u4& nValued) {
+    std::vector<CMove> moves;
+    for (const CMoveValue& mv : mvs)
+        moves.push_back(mv.move);
+
+    // Proof numbers don't fit in the cache's entries, so the PN search has a table of its own, one per searching
+    // thread. It is allocated by the first PN search on the thread and kept from one search to the next, like the
+    // cache; only a change of size reallocates it.
+    static thread_local std::unique_ptr<CPNSearch> pPN;
+    const size_t nBytes=size_t(nPNSearchMB)<<20;
+    if (!pPN || pPN->Bytes()!=nBytes)
+        pPN.reset(new CPNSearch(nBytes, kPNLeafEmpties));
+    CMoveValue best;
+    if (!pPN->ValueWLD(pos2.GetBB(), moves, nMaxNodes, best.value, best.move))
+        return false;
+
+    // values are clamped with the previous round's, as in ValueMulti(). When the position is won the
+    // other moves are left unsearched; otherwise they are known to be no better than the best.
+    mvsEvaluated.clear();
+    for (const CMoveValue& mv : mvs) {
+        if (mv.move==best.move)
+            best.value=ClampedValue(best.value, mv.value, -kStoneValue, kStoneValue);
+        else
+            mvsEvaluated.push_back(CMoveValue(mv.move, best.value>0 ? mv.value : std::min(mv.value, best.value)));
+    }
+    mvsEvaluated.insert(mvsEvaluated.begin(), best);
+    nValued=1;
+
+    const std::vector<CMove> line(1, best.move);
+    pvTable.SetLine(height, line);
+    if (fPrintBestMoves)
+        OutputSearchInfo(EngineOut(), best, line, fPassBefore, CHeightInfoX(height, 0, true, pos2.NEmpty()));
+    return true;
+}
+
 //! set book read & write heights prior to calling Value()
 void SetBookHeights(int height) {
 
@@ -729,6 +1454,51 @@ void InitializeCache() {
 
 int iffMidgame=5;
 
+// aspiration windows for exact-value rounds
+const CValue kAspirationWindow=2*kStoneValue;   //!< distance of the first window's bounds from the previous round's values
+const CValue kAspirationWidening=4;             //!< each re-search moves the failed bound this many times further out
+
+//! ValueMulti() with an aspiration window around the values from the previous round.
+//!
+//! The window runs from kAspirationWindow below the nBest'th value in mvsOld to kAspirationWindow above the best.
+//! If the search fails low or high the failed bound is moved past the fail-soft value that came back and the
+//! moves are searched again, best first. The moves are passed back to ValueMulti() with the values from the
+//! failed search, so its clamping keeps the tighter of the old and new bounds for moves that fail again.
+//! Once a bound reaches alpha or beta it can no longer fail.
+//!
+//! \pre the first nBest moves of mvsOld were valued by an exact-value round
+void AspirationValueMulti(Pos2& pos2, const CHeightInfo& hi, CValue alpha, CValue beta, u4 nBest, const std::vector<CMoveValue>& mvsOld,
+                                 const CSearchInfo& si, bool fPassBefore, std::vector<CMoveValue>& mvsNew, u4& nEvalNew) {
+    CValue delta=kAspirationWindow;
+    CValue vLow=std::max(CValue(mvsOld[nBest-1].value-delta), alpha);
+    CValue vHigh=std::min(CValue(mvsOld[0].value+delta), beta);
+    CSearchProfile::CAspirationCell* pCell=pSearchProfile ? &pSearchProfile->Aspiration(hi.height) : NULL;
+    std::vector<CMoveValue> mvs=mvsOld;
+
+    if (pCell) pCell->nSearches++;
+    for (;;) {
+        ValueMulti(pos2, hi.height, vLow, vHigh, hi.iPrune, nBest, mvs, si.PrintRound(), fPassBefore, mvsNew, nEvalNew, si.nRootThreads);
+        if (Aborted())
+            return;
+
+        delta*=kAspirationWidening;
+        bool fFailed=false;
+        if (vLow>alpha && mvsNew[nBest-1].value<=vLow) {
+            vLow=std::max(CValue(mvsNew[nBest-1].value-delta), alpha);
+            fFailed=true;
+            if (pCell) pCell->nFailLows++;
+        }
+        if (vHigh<beta && mvsNew[0].value>=vHigh) {
+            vHigh=std::min(CValue(mvsNew[0].value+delta), beta);
+            fFailed=true;
+            if (pCell) pCell->nFailHighs++;
+        }
+        if (!fFailed)
+            return;
+        mvs=mvsNew;
+    }
+}
+
 //! Value a position by iterative-deepening search.
 //!
 //! \param[in] moves moves to check. Can be any subset of the legal moves from the position.
@@ -748,12 +1518,17 @@ void IterativeValue(Pos2& pos2, CMoves moves, const CCalcParams& cp,
     int iPrune=pos2.NEmpty()<=hSolverStart+1?0:si.iPruneMidgame;
     CHeightInfo hi(1,iPrune,false, pos2.NEmpty());
     double tElapsed = 0.0;
+    double tRound = 0.0;    // predicted time of the next round
+    double nNodesRound = 0; // nodes searched by the last round
+    u64 nNodesStart, nNodesRoundStart;  // SearchNodes() at the start of the search and round; other searches in the process don't count
     CValue alpha, beta;
     CNodeStats nsStart, nsEnd;
     std::vector<CMoveValue> mvsOld, mvsNew;
     u4 nEvalOld, nEvalNew;
     CMoves movesFull;
     bool fFull;    // true if we are checking all subnodes
+    bool fAborted=false;    // abortRound as of the end of the last round
+    bool fExactOld=false;   // true if mvsOld holds values from an exact-value round rather than WLD values
 
     pos2.CalcMoves(movesFull);
     fFull= movesFull==moves;
@@ -765,12 +1540,17 @@ void IterativeValue(Pos2& pos2, CMoves moves, const CCalcParams& cp,
 
     //assert(mpcs && mpcs->Valid());
 
-    // print MPC stat static value?
-    if (si.NeedMPCStats())
-        std::cout << "\t" << StaticValue(pos2, 0);
+    // profile the search if asked to, unless the caller is already collecting a profile
+    std::unique_ptr<CSearchProfile> profile;
+    if (si.NeedProfile() && !pSearchProfile)
+        profile.reset(new CSearchProfile);
+    CProfileScope profileScope(profile ? profile.get() : pSearchProfile);
 
-    // initialize cache and book read height
+    // initialize cache, move ordering tables and book read height
     InitializeCache();
+    moveHistory.Clear();
+    mpcProbes.Clear();
+    ClearPVFollow();
 
     // Initialize the move lists
     CMoveValue mv;
@@ -781,28 +1561,40 @@ void IterativeValue(Pos2& pos2, CMoves moves, const CCalcParams& cp,
 
     // Initialize timing info
     nsStart.Read();
+    nNodesStart=nNodesRoundStart=SearchNodes();
     cp.SetAbortTime(nsStart, pos2.NEmpty(), si.tRemaining);
     mvk.Clear();
     mvk.move.Set(-1);
     mvk.fKnown=false;
 
+    // MPC stats compare the static value with the value at each height
+    if (si.NeedMPCStats())
+        mvk.mpcValues.assign(1, StaticValue(pos2, 0));
+
     // increase search width for rand games in midgame because of weak eval for rand games
     if (pos2.NEmpty()>36 && (si.NeedRandSearch()) && (si.iPruneMidgame>1))
         hi.iPrune--;
 
     // iterate
-    while (!mvk.move.Valid() || cp.RoundOK(hi, pos2.NEmpty(), tElapsed, si.tRemaining) ) {
-        if (fPrintTree) TreeDebugStartRound(hi);
+    while (!mvk.move.Valid() || cp.RoundOK(hi, pos2.NEmpty(), tElapsed, tRound, si.tRemaining) ) {
+        const i8 tRoundStart=GetTicks();
         SetBookHeights(hi.height);
 
+        // Clearly decided positions are often settled by a proof-number search in far fewer nodes than a
+        // full-width WLD search. Close ones aren't, so it gets a budget in proportion to the nodes searched
+        // so far, which a round typically about matches.
+        const bool fPNSolved=hi.fWLD && !hi.iPrune && nBest==1 && pos2.NEmpty()<=nEmptyPNSearch
+            && mvk.fKnown && abs(mvk.value)>=nPNSearchMargin*kStoneValue
+            && PNValueMulti(pos2, hi.height, u64((nNodesRoundStart-nNodesStart)*dPNSearchNodes), mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew);
+
         // Set alpha and beta depending on whether this is an WLD search or exact value search.
         if (hi.fWLD) {
             // if we're doing a full-width WLD search do an aspiration WD or DL search first
-            if (mvk.fKnown && !hi.iPrune) {
+            if (mvk.fKnown && !hi.iPrune && !fPNSolved) {
                 if (mvk.value<0)
-                    ValueMulti(pos2, hi.height, -kStoneValue, 0, hi.iPrune, nBest, mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew);
+                    ValueMulti(pos2, hi.height, -kStoneValue, 0, hi.iPrune, nBest, mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew, si.nRootThreads);
                 else if (mvk.value>0)
-                    ValueMulti(pos2, hi.height, 0, kStoneValue, hi.iPrune, nBest, mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew);
+                    ValueMulti(pos2, hi.height, 0, kStoneValue, hi.iPrune, nBest, mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew, si.nRootThreads);
                 else {
                     // aspiration searches don't seem to help if value==0
                 }
@@ -815,12 +1607,27 @@ void IterativeValue(Pos2& pos2, CMoves moves, const CCalcParams& cp,
             beta=kWipeout;
         }
 
-        ValueMulti(pos2, hi.height, alpha, beta, hi.iPrune, nBest, mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew);
+        if (!hi.fWLD && fExactOld && nEvalOld>=u4(nBest))
+            AspirationValueMulti(pos2, hi, alpha, beta, nBest, mvsOld, si, fPassBefore, mvsNew, nEvalNew);
+        else if (!fPNSolved)
+            ValueMulti(pos2, hi.height, alpha, beta, hi.iPrune, nBest, mvsOld, si.PrintRound(), fPassBefore, mvsNew, nEvalNew, si.nRootThreads);
+
+        // abortRound can be set by the timer thread at any moment; decide once whether this round completed
+        fAborted=Aborted();
 
         // calc timing info
         nsEnd.Read();
         mvk.ns=nsEnd-nsStart;
         tElapsed=mvk.ns.Seconds();
+        mvk.timing.AddRound(hi, SecondsSince(tRoundStart));
+
+        // measure the machine for predicting later rounds. Aborted rounds would understate the cost
+        const u64 nNodesEnd=SearchNodes();
+        const double nNodesNew=double(nNodesEnd-nNodesRoundStart);
+        if (!fAborted && !si.NeedMPCStats())
+            timeModel.AddRound(hi, pos2.NEmpty(), nNodesRound, nNodesNew, SecondsSince(tRoundStart));
+        nNodesRound=nNodesNew;
+        nNodesRoundStart=nNodesEnd;
 
         // update mvk
         if (nEvalNew){
@@ -829,54 +1636,76 @@ void IterativeValue(Pos2& pos2, CMoves moves, const CCalcParams& cp,
             mvk.fKnown=true;
             mvk.hiBest=hi;
         }
-        if (!abortRound)
+        if (!fAborted)
             mvk.hiFull=hi;
 
         // special checks when calculating mpc stats
         if (si.NeedMPCStats())
-            printf("\t%d",mvk.value);
+            mvk.mpcValues.push_back(mvk.value);
 
         // are we done?
         // don't stop on wipeouts, we could have had an MPC cutoff
         //    and it might not really be a wipeout...
-        //if (abortRound || mvsNew[0].value>=kWipeout)
-        if (abortRound)
+        //if (fAborted || mvsNew[0].value>=kWipeout)
+        if (fAborted) {
+            if (fPrintAbort)
+                EngineOut() << ">> Abort round!!!\n";
+            // input can abort the first round before any move is valued; return an unvalued
+            // move rather than none, so one client can't bring down an engine server.
+            if (!mvk.move.Valid())
+                mvk.move=mvsOld[0].move;
             break;
+        }
 
         // get parameters for next round, break if we've solved
+        const bool fExactRound=!hi.fWLD;
+        std::vector<CMove> pv;
+        pvTable.Line(hi.height, pv);
         if(!hi.NextRound(pos2.NEmpty(),si))
             break;
+        tRound=timeModel.PredictRound(hi, pos2.NEmpty(), nNodesRound, tElapsed);
 
         nEvalOld=nEvalNew;
         mvsOld=mvsNew;
+        fExactOld=fExactRound;
+
+        // search the principal variation first in the next round
+        SetPVFollow(pos2, pv);
     }
 
+    // stop the timer so abortRound keeps the value the book code below expects
+    CancelAbortTime(fAborted);
+
     assert(mvk.move.Valid());
-    if (book) {
+    if (book && !si.NeedReadOnlyBook()) {
         bool fStoreUnsolved;
         if (si.NeedNoAddSoloUnsolvedToBook())
-            fStoreUnsolved=!abortRound && nBest>1;
+            fStoreUnsolved=!fAborted && nBest>1;
         else
             fStoreUnsolved=true;
 
+        const i8 tStoreStart=GetTicks();
         book->StoreIterativeResult(pos2.GetBB(), nBest, nEvalOld,nEvalNew,mvsOld,mvsNew,mvk, fFull, fStoreUnsolved);
+        mvk.timing.tStore=SecondsSince(tStoreStart);
     }
     if (si.PrintMoveSearchStats()) {
         u4 i;
         if (nEvalNew) {
-            std::cout << mvk.hiBest << " (" << pos2.NEmpty() << " empty)\t";
+            EngineOut() << mvk.hiBest << " (" << pos2.NEmpty() << " empty)\t";
             for (i=0; i<nEvalNew; i++) {
-                std::cout << mvsNew[i] << "\t";
+                EngineOut() << mvsNew[i] << "\t";
             }
         }
-        if (abortRound) {
-            std::cout << mvk.hiFull << " (" << pos2.NEmpty() << " empty)\t";
+        if (fAborted) {
+            EngineOut() << mvk.hiFull << " (" << pos2.NEmpty() << " empty)\t";
             for (i=0; i<nEvalOld; i++) {
-                std::cout << mvsOld[i] << "\t";
+                EngineOut() << mvsOld[i] << "\t";
             }
         }
-        std::cout << "\t" << tElapsed << "s elapsed\n";
+        EngineOut() << "\t" << tElapsed << "s elapsed\n";
     }
+    if (profile)
+        EngineOut() << *profile;
 
     // calc timing info
     nsEnd.Read();
@@ -960,6 +1789,14 @@ void InitForcedOpenings() {
     std::cerr << "Map Size: Black: " << foms[1].size() << ", White: " << foms[0].size() << "\n";
 }
 
+//! Look up a move in the book, timing the lookup
+static bool BookMove(Pos2& pos2, const CSearchInfo& si, CMVK& mvk, bool fPassBefore) {
+    const i8 tStart=GetTicks();
+    const bool fFound=book->GetRandomMove(CQPosition(pos2.GetBB(), pos2.BlackMove()), si, mvk, fPassBefore);
+    mvk.timing.tBook=SecondsSince(tStart);
+    return fFound;
+}
+
 //! TimedMVK - calculate a move. Inrease height until the game is
 //!    solved or (height>=minDepth && time>=minTime).
 //!    Special case if move is forced or in book.
@@ -986,6 +1823,7 @@ void TimedMVK(Pos2& pos2, const CCalcParams& cp, const CSearchInfo& si, CMVK& mv
     start.Read();
 
     mvk.Clear();
+    mvk.timing.Clear();
 
 #ifdef _DEBUG
     mvk.move.Set(-1);
@@ -1022,7 +1860,7 @@ void TimedMVK(Pos2& pos2, const CCalcParams& cp, const CSearchInfo& si, CMVK& mv
         mvk.fBook=true;
         mvk.value=0;
     }
-    else if (book && book->GetRandomMove(CQPosition(pos2.GetBB(), pos2.BlackMove()), si, mvk, fPassBefore)) {
+    else if (book && BookMove(pos2, si, mvk, fPassBefore)) {
         // move in book
         mvk.fKnown=true;
         mvk.fBook=true;
@@ -1042,12 +1880,12 @@ void TimedMVK(Pos2& pos2, const CCalcParams& cp, const CSearchInfo& si, CMVK& mv
         else {
             // value the move
             if (si.PrintAnalysis())
-                std::cout << (si.PrintPondering()?"status Analyzing":"status Thinking") << std::endl;
+                EngineOut() << (si.PrintPondering()?"status Analyzing":"status Thinking") << std::endl;
             IterativeValue(pos2, moves, cp, si, mvk, fPassBefore, 1);        
             assert(mvk.move.Valid());
             fIterativeNS=true;
             if (si.PrintAnalysis())
-                std::cout << "status" << std::endl;
+                EngineOut() << "status" << std::endl;
         }
     }
 
@@ -1056,4 +1894,6 @@ void TimedMVK(Pos2& pos2, const CCalcParams& cp, const CSearchInfo& si, CMVK& mv
         end.Read();
         mvk.ns=end-start;
     }
+    if (si.PrintMoveSearchStats())
+        EngineOut() << mvk.timing << "\n";
 }
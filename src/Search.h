@@ -9,7 +9,9 @@
 void TimedMVK(Pos2& pos2, const CCalcParams& cp, const CSearchInfo& si, CMVK& mvk, bool fPassBefore);
 void IterativeValue(Pos2& pos2, CMoves moves, const CCalcParams& cp, const CSearchInfo& si, CMVK& mvk, bool fPassBefore, int nBest);
 void ValueMulti(Pos2& pos2, int height, CValue alpha, CValue beta, int iPrune, u4 nBest, const std::vector<CMoveValue>& mvs
-				, bool fPrintBestMoves, bool fPassBefore, std::vector<CMoveValue>& mvsEvaluated, u4& nValued);
+				, bool fPrintBestMoves, bool fPassBefore, std::vector<CMoveValue>& mvsEvaluated, u4& nValued, int nThreads=1);
+void AspirationValueMulti(Pos2& pos2, const CHeightInfo& hi, CValue alpha, CValue beta, u4 nBest, const std::vector<CMoveValue>& mvsOld,
+				const CSearchInfo& si, bool fPassBefore, std::vector<CMoveValue>& mvsNew, u4& nEvalNew);
 //IterativeValue support routines
 void SetBookHeights(int height);
 
@@ -1,9 +1,9 @@
 #include "SearchParams.h"
 
 // search parameters
-CBook* book=0;
-CCache* cache=0;
-CEvaluator* evaluator=0;
-CMPCStats* mpcs=0;
+thread_local CBook* book=0;
+thread_local CCache* cache=0;
+thread_local CEvaluator* evaluator=0;
+thread_local CMPCStats* mpcs=0;
 
-int hBookRead=0;
\ No newline at end of file
+thread_local int hBookRead=0;
\ No newline at end of file
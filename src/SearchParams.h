@@ -3,11 +3,13 @@ class CCache;
 class CEvaluator;
 class CMPCStats;
 
-extern CBook* book;
+// Each thread searches with its own parameters, set by CPlayerComputer::SetParameters(),
+// so several engines can play at once.
+extern thread_local CBook* book;
 
 // search parameters
-extern CCache* cache;
-extern CEvaluator* evaluator;
-extern CMPCStats* mpcs;
+extern thread_local CCache* cache;
+extern thread_local CEvaluator* evaluator;
+extern thread_local CMPCStats* mpcs;
 
-extern int hBookRead;
\ No newline at end of file
+extern thread_local int hBookRead;
\ No newline at end of file
@@ -1,11 +1,17 @@
 #include <vector>
 #include <iomanip>
+#include <memory>
+#include <sstream>
 #include "n64/test.h"
 #include "core/Cache.h"
+#include "core/CalcParams.h"
 #include "core/Book.h"
 #include "core/MPCStats.h"
+#include "core/SearchProfile.h"
 #include "core/BitBoardTest.h"
 #include "SpeedTest.h"
+#include "n64/solve.h"
+#include "PNSearch.h"
 #include "Search.h"
 #include "Evaluator.h"
 #include "PlayerComputer.h"
@@ -155,8 +161,6 @@ void TestEndgameAccuracy(){
 	start.Read();
 
 	for (i=0; i<nEndgames; i++) {
-		::nBBFlips=0;
-
 
 		bool fBlackMove=false;
 
@@ -249,6 +253,128 @@ void TestIterativeValue() {
 }
 
 
+//! Value all moves at the given depth, with the root moves searched by nThreads threads
+static std::vector<CMoveValue> ValueAllMoves(const CQPosition& testPosition, int depth, int nThreads) {
+	CCache acache(1<<14);
+	cache = &acache;
+	InitializeCache();
+
+	std::vector<CMoveValue> mvs = createMoves(testPosition);
+	Pos2 pos2;
+	pos2.Initialize(testPosition.BitBoard(), testPosition.BlackMove());
+	u4 nValued=0;
+	std::vector<CMoveValue> mvsEvaluated;
+	ValueMulti(pos2, depth, -kInfinity, kInfinity, 0, u4(mvs.size()), mvs, false, false, mvsEvaluated, nValued, nThreads);
+	assertEquals(mvs.size(), nValued);
+	assertEquals(mvs.size(), mvsEvaluated.size());
+
+	cache = NULL;
+	return mvsEvaluated;
+}
+
+//! Searching root moves on several threads gives the same values, in the same order, as searching them one at a time
+void TestParallelValueMulti() {
+	const int nEmpty = 22;
+	CBook* oldBook = book;
+	book = NULL;
+	SetBookHeights(nEmpty);
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	mpcs = CMPCStats::GetMPCStats('J','A',5);
+
+	const COsGame osGame = LoadTestGames().at(0);
+	const CQPosition testPosition = PositionFromEmpties(osGame, nEmpty);
+	for (int depth=1; depth<=4; depth++) {
+		const std::vector<CMoveValue> serial=ValueAllMoves(testPosition, depth, 1);
+		// the workers' nodes count towards this thread's search, once, and are in its profile
+		std::unique_ptr<CSearchProfile> profile(new CSearchProfile);
+		CNodeStats start, end;
+		start.Read();
+		const u64 nSearchNodesStart=SearchNodes();
+		std::vector<CMoveValue> parallel;
+		{
+			CProfileScope profileScope(profile.get());
+			parallel=ValueAllMoves(testPosition, depth, 3);
+		}
+		end.Read();
+		assertEquals(i64((end-start).Nodes()), i64(SearchNodes()-nSearchNodesStart));
+		u64 nProfiledNodes=0;
+		for (int height=0; height<CSearchProfile::kMaxHeight; height++) {
+			for (int nEmpty=0; nEmpty<CSearchProfile::kMaxEmpty; nEmpty++)
+				nProfiledNodes+=profile->Cell(height, nEmpty).nNodes;
+		}
+		assertEquals(i64((end-start).nINodes), i64(nProfiledNodes));
+
+		assertEquals(serial.size(), parallel.size());
+		for (size_t i=0; i<serial.size(); i++) {
+			TEST(serial[i].move==parallel[i].move);
+			assertEquals(serial[i].value, parallel[i].value);
+		}
+	}
+
+	book = oldBook;
+}
+
+//! Each PV printed by ValueMulti() starts with its root move and is legal from the root position,
+//! and the best move's line goes past the root move
+void TestPrincipalVariation() {
+	const int nEmpty = 22;
+	const int depth = 4;
+	CBook* oldBook = book;
+	book = NULL;
+	SetBookHeights(depth);
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	mpcs = CMPCStats::GetMPCStats('J','A',5);
+	CCache acache(1<<14);
+	cache = &acache;
+	InitializeCache();
+
+	const COsGame osGame = LoadTestGames().at(0);
+	const CQPosition testPosition = PositionFromEmpties(osGame, nEmpty);
+	std::vector<CMoveValue> mvs = createMoves(testPosition);
+	Pos2 pos2;
+	pos2.Initialize(testPosition.BitBoard(), testPosition.BlackMove());
+	u4 nValued=0;
+	std::vector<CMoveValue> mvsEvaluated;
+	std::ostringstream out;
+	std::ostream* const pOldOut = pEngineOut;
+	pEngineOut = &out;
+	ValueMulti(pos2, depth, -kInfinity, kInfinity, 0, u4(mvs.size()), mvs, true, false, mvsEvaluated, nValued);
+	pEngineOut = pOldOut;
+
+	std::istringstream in(out.str());
+	std::string sLine;
+	int nLines = 0;
+	while (std::getline(in, sLine)) {
+		std::istringstream is(sLine);
+		std::string sSearch, sPV;
+		is >> sSearch >> sPV;
+		TEST(sSearch=="search");
+
+		Pos2 pos = pos2;
+		for (size_t i=0; i<sPV.size(); i+=3) {
+			const CMove move(sPV.substr(i, 2));
+			CMoves moves;
+			pos.CalcMoves(moves);
+			if (move.IsPass()) {
+				TEST(i>0);
+				assertEquals(0, moves.NMoves());
+				pos.PassBB();
+			}
+			else {
+				TEST(moves.IsValid(move));
+				pos.MakeMoveBB(move.Square());
+			}
+		}
+		if (CMove(sPV.substr(0, 2))==mvsEvaluated[0].move)
+			TEST(sPV.size()>2);
+		nLines++;
+	}
+	assertEquals(int(mvs.size()), nLines);
+
+	cache = NULL;
+	book = oldBook;
+}
+
 void TestStaticValue() {
 	std::vector<COsGame> testGames = LoadTestGames();
 	evaluator = CEvaluator::FindEvaluator('J','A');
@@ -264,8 +390,225 @@ void TestStaticValue() {
 	}
 }
 
+void TestPNSearch() {
+	const int nPositions=20;
+	CPNSearch pn(1<<20, 8);
+	int n=0;
+	for (int i=0; i<nEndgames && n<nPositions; i++) {
+		const CQPosition qpos(bds[i].board, false);
+		CMoves moves;
+		if (qpos.NEmpty()<12 || !qpos.CalcMoves(moves))
+			continue;
+		n++;
+		std::vector<CMove> mvs;
+		CMove move;
+		while (moves.GetNext(move))
+			mvs.push_back(move);
+
+		// a budget too small to prove anything. The table is new: positions proven earlier may be transpositions.
+		CValue value;
+		assertFalse(CPNSearch(1<<16, 8).ValueWLD(qpos.BitBoard(), mvs, 0, value, move));
+
+		assertTrue(pn.ValueWLD(qpos.BitBoard(), mvs, kNoNodeLimit, value, move));
+		const int result=bds[i].nResultNoEmpties;
+		assertEquals((result>0)-(result<0), value/kStoneValue);
+
+		// the move achieves the value
+		CQPosition child(qpos);
+		child.MakeMove(move);
+		const CBitBoard& bb=child.BitBoard();
+		const int childResult=-solveNValue(-64, 64, bb.mover, bb.getEnemy());
+		assertEquals((childResult>0)-(childResult<0), value/kStoneValue);
+	}
+	assertEquals(nPositions, n);
+}
+
+//! A search over some of a position's moves leaves nothing in the table that makes a later search,
+//! where the position is a child, think the position is lost when only the moves searched lose
+void TestPNSearchSubset() {
+	const int nPositions=5;
+	int n=0;
+	for (int i=0; i<nEndgames && n<nPositions; i++) {
+		const CQPosition qpos(bds[i].board, false);
+		CMoves moves;
+		if (qpos.NEmpty()<12 || !qpos.CalcMoves(moves))
+			continue;
+		n++;
+		CPNSearch pn(1<<20, 8);
+		std::vector<CMove> mvs;
+		CMove move;
+		while (moves.GetNext(move))
+			mvs.push_back(move);
+
+		// search each child over each of its moves on its own
+		CValue value;
+		for (const CMove& mv : mvs) {
+			CQPosition child(qpos);
+			child.MakeMove(mv);
+			CMoves childMoves;
+			if (!child.CalcMoves(childMoves))
+				continue;
+			CMove childMove;
+			while (childMoves.GetNext(childMove)) {
+				CMove best;
+				assertTrue(pn.ValueWLD(child.BitBoard(), std::vector<CMove>(1, childMove), kNoNodeLimit, value, best));
+			}
+		}
+
+		assertTrue(pn.ValueWLD(qpos.BitBoard(), mvs, kNoNodeLimit, value, move));
+		const int result=bds[i].nResultNoEmpties;
+		assertEquals((result>0)-(result<0), value/kStoneValue);
+	}
+	assertEquals(nPositions, n);
+}
+
+//! Node-limited search from an empty cache, valuing the best nBest moves with three root threads available
+static CMVK FixedNodesSearch(const CQPosition& position, u64 nNodes, int nBest, u64& nSearched) {
+	CCache acache(1<<14);
+	cache = &acache;
+	CCalcParamsFixedNodes cp(nNodes);
+	CSearchInfo si(4, 5, 0, 0, CSearchInfo::kNeedMove+CSearchInfo::kNeedValue, 1e6, 0, 0);
+	si.nRootThreads = 3;
+
+	CMoves moves;
+	position.CalcMoves(moves);
+	Pos2 pos2;
+	pos2.Initialize(position.BitBoard(), position.BlackMove());
+	CMVK mvk;
+	const u64 nStart = SearchNodes();
+	IterativeValue(pos2, moves, cp, si, mvk, false, nBest);
+	nSearched = SearchNodes()-nStart;
+
+	cache = NULL;
+	return mvk;
+}
+
+//! A node-limited search gives the same move, value and node count every time it is run,
+//! including when it values several moves and would otherwise search them on several threads
+void TestFixedNodes() {
+	const int nEmpty = 36;
+	const u64 nNodes = 100000;
+	CBook* oldBook = book;
+	book = NULL;
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	mpcs = CMPCStats::GetMPCStats('J','A',5);
+
+	const CQPosition testPosition = PositionFromEmpties(LoadTestGames().at(0), nEmpty);
+	CMoves moves;
+	testPosition.CalcMoves(moves);
+	for (int nBest : {1, int(moves.NMoves())}) {
+		u64 nSearched1, nSearched2;
+		const CMVK mvk1 = FixedNodesSearch(testPosition, nNodes, nBest, nSearched1);
+		const CMVK mvk2 = FixedNodesSearch(testPosition, nNodes, nBest, nSearched2);
+		TEST(mvk1.move==mvk2.move);
+		assertEquals(mvk1.value, mvk2.value);
+		assertEquals(i64(nSearched1), i64(nSearched2));
+		assertTrue(nSearched1>=nNodes);
+	}
+
+	// the node limit leaves abortRound set, which would stop the next test's searches
+	CancelAbortTime(false);
+	book = oldBook;
+}
+
+//! Best value of a search of position's moves to the given height from an empty cache:
+//! with an aspiration window around the values in mvsOld if fAspiration, otherwise with a full window
+static CValue RootValue(const CQPosition& position, int height, int iPrune, const std::vector<CMoveValue>& mvsOld, bool fAspiration) {
+	CCache acache(1<<14);
+	cache = &acache;
+	InitializeCache();
+
+	Pos2 pos2;
+	pos2.Initialize(position.BitBoard(), position.BlackMove());
+	const CSearchInfo si(iPrune, iPrune, 0, 0, CSearchInfo::kNeedMove+CSearchInfo::kNeedValue, 1e6, 0, 0);
+	std::vector<CMoveValue> mvsNew;
+	u4 nValued=0;
+	if (fAspiration)
+		AspirationValueMulti(pos2, CHeightInfo(height, iPrune, false, position.NEmpty()), -kWipeout, kWipeout, 1, mvsOld, si, false, mvsNew, nValued);
+	else
+		ValueMulti(pos2, height, -kWipeout, kWipeout, iPrune, 1, mvsOld, false, false, mvsNew, nValued);
+	assertTrue(nValued>=1);
+
+	cache = NULL;
+	return mvsNew[0].value;
+}
+
+//! An aspiration search finds the same best value as a full-window search, including when the previous
+//! round's values are far enough off that it fails low or high and has to widen the window
+void TestAspirationValueMulti() {
+	const int height = 6;
+	CBook* oldBook = book;
+	book = NULL;
+	evaluator = CEvaluator::FindEvaluator('J','A');
+	mpcs = CMPCStats::GetMPCStats('J','A',5);
+
+	std::unique_ptr<CSearchProfile> profile(new CSearchProfile);
+	CProfileScope profileScope(profile.get());
+	const COsGame osGame = LoadTestGames().at(0);
+	for (int nEmpty : {30, 36, 42}) {
+		SetBookHeights(height);
+		const CQPosition testPosition = PositionFromEmpties(osGame, nEmpty);
+		for (int iPrune : {0, 4}) {
+			// the previous round: values of all moves, with the first exact
+			Pos2 pos2;
+			pos2.Initialize(testPosition.BitBoard(), testPosition.BlackMove());
+			CCache acache(1<<14);
+			cache = &acache;
+			InitializeCache();
+			std::vector<CMoveValue> mvsPrevious;
+			u4 nValued=0;
+			ValueMulti(pos2, height-1, -kWipeout, kWipeout, iPrune, 1, createMoves(testPosition), false, false, mvsPrevious, nValued);
+			cache = NULL;
+
+			const CValue value = RootValue(testPosition, height, iPrune, mvsPrevious, false);
+			for (CValue offset : {0, 8*kStoneValue, -8*kStoneValue}) {
+				std::vector<CMoveValue> mvsOld = mvsPrevious;
+				for (CMoveValue& mv : mvsOld)
+					mv.value += offset;
+				assertEquals(value, RootValue(testPosition, height, iPrune, mvsOld, true));
+			}
+		}
+	}
+
+	// the offsets were large enough to make the aspiration searches fail both ways
+	const CSearchProfile::CAspirationCell& cell = profile->Aspiration(height);
+	assertTrue(cell.nFailLows>0);
+	assertTrue(cell.nFailHighs>0);
+
+	book = oldBook;
+}
+
+//! A hint search prints its rounds to the engine output but does not profile the search unless asked to
+void TestHintProfile() {
+	// print flags as in NBoard mode
+	CComputerDefaults cd;
+	cd.booklevel=CComputerDefaults::kNoBook;
+	cd.sCalcParams="s4";
+	cd.fsPrint=-1&~CSearchInfo::kPrintMove&~CSearchInfo::kPrintGameAnalysis;
+	cd.nCacheBytes=1<<20;
+	CPlayerComputer computer(cd);
+
+	const CQPosition testPosition = PositionFromEmpties(LoadTestGames().at(0), 30);
+	std::ostringstream out;
+	std::ostream* const pOldOut = pEngineOut;
+	pEngineOut = &out;
+	computer.Hint(testPosition, 1);
+	pEngineOut = pOldOut;
+
+	assertFalse(out.str().empty());
+	assertTrue(out.str().find("profile nodes")==std::string::npos);
+	cache = NULL;
+}
+
 void TestSearch() {
 	TestStaticValue();
 	TestIterativeValue();
+	TestParallelValueMulti();
+	TestPrincipalVariation();
+	TestPNSearch();
+	TestPNSearchSubset();
+	TestFixedNodes();
+	TestAspirationValueMulti();
+	TestHintProfile();
 	TestEndgameAccuracy();
 }
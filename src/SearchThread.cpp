@@ -0,0 +1,118 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// running an engine's searches on their own thread
+
+#include <algorithm>
+
+#include "core/NodeStats.h"
+#include "SearchThread.h"
+
+//! On a CSearchThread, set when the current search has been asked to stop
+static thread_local const std::atomic<bool>* pStopRequested=NULL;
+
+//! True if this is a CSearchThread and its current search has been asked to stop.
+//!
+//! HasInput() reports this, so that SetAbortTime() stops a search asked to stop before it started its timer.
+bool SearchStopRequested() {
+    return pStopRequested && pStopRequested->load();
+}
+
+CSearchThread::CSearchThread(std::ostream& os) : fBusy(false), fPondering(false), fQuit(false), fStop(false), pAbortRound(NULL) {
+    thread=std::thread(&CSearchThread::Run, this, &os);
+    std::unique_lock<std::mutex> guard(mutex);
+    while (!pAbortRound)
+        cv.wait(guard);
+}
+
+CSearchThread::~CSearchThread() {
+    Abort();
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        fQuit=true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+//! Run search after the searches already waiting, stopping or dropping any ponder search
+void CSearchThread::Add(const std::function<void()>& search) {
+    Add(search, false);
+}
+
+//! Run search when the thread has nothing else to do.
+//!
+//! The search is stopped when another search is added, including another ponder search, so it
+//! must not need to finish.
+void CSearchThread::AddPonder(const std::function<void()>& search) {
+    Add(search, true);
+}
+
+void CSearchThread::Add(const std::function<void()>& search, bool fPonder) {
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        StopPondering();
+        searches.push_back(CJob{search, fPonder});
+    }
+    cv.notify_all();
+}
+
+//! Stop the running search if it's a ponder search, and drop waiting ponder searches. Call with mutex held.
+void CSearchThread::StopPondering() {
+    searches.erase(std::remove_if(searches.begin(), searches.end(), [](const CJob& job) { return job.fPonder; }), searches.end());
+    if (fBusy && fPondering) {
+        fStop=true;
+        SignalAbort(pAbortRound);
+    }
+}
+
+//! Stop the running search and drop the waiting ones. Doesn't wait for the search to stop.
+//!
+//! The search is stopped even if it has not yet started its timer, since SetAbortTime()
+//! sees the request through HasInput().
+void CSearchThread::Abort() {
+    std::unique_lock<std::mutex> guard(mutex);
+    searches.clear();
+    if (fBusy) {
+        fStop=true;
+        SignalAbort(pAbortRound);
+    }
+}
+
+//! Wait until all searches are done. Ponder searches are stopped rather than waited for.
+void CSearchThread::Wait() {
+    std::unique_lock<std::mutex> guard(mutex);
+    StopPondering();
+    while (fBusy || !searches.empty())
+        cv.wait(guard);
+}
+
+//! Search thread's job: run searches as they are added
+void CSearchThread::Run(std::ostream* pos) {
+    pEngineOut=pos;
+    pStopRequested=&fStop;
+    std::unique_lock<std::mutex> guard(mutex);
+    pAbortRound=&abortRound;
+    cv.notify_all();
+
+    for (;;) {
+        while (searches.empty() && !fQuit)
+            cv.wait(guard);
+        if (fQuit)
+            break;
+
+        const CJob job=searches.front();
+        searches.pop_front();
+        fBusy=true;
+        fPondering=job.fPonder;
+        fStop=false;
+        guard.unlock();
+        job.search();
+        guard.lock();
+        fBusy=false;
+        fPondering=false;
+        cv.notify_all();
+    }
+}
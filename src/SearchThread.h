@@ -0,0 +1,58 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// running an engine's searches on their own thread
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+//! Runs an engine's searches, one after the other, so the thread reading its commands stays free.
+//!
+//! The command thread can stop the current search at once with Abort(). Engine output on the
+//! search thread goes to the stream given to the constructor; the command thread must Wait()
+//! before writing to that stream itself.
+//!
+//! A search added with AddPonder() only uses time the thread would otherwise spend idle: adding
+//! any search stops it, or drops it if it hasn't started.
+class CSearchThread {
+public:
+    explicit CSearchThread(std::ostream& os);
+    ~CSearchThread();
+
+    void Add(const std::function<void()>& search);
+    void AddPonder(const std::function<void()>& search);
+    void Abort();
+    void Wait();
+
+private:
+    void Run(std::ostream* pos);
+    void Add(const std::function<void()>& search, bool fPonder);
+    void StopPondering();
+
+    //! A search waiting to run
+    struct CJob {
+        std::function<void()> search;
+        bool fPonder;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<CJob> searches;
+    bool fBusy;     //!< a search is running
+    bool fPondering;    //!< the running search was added with AddPonder()
+    bool fQuit;
+    std::atomic<bool> fStop;    //!< the running search should stop
+    std::atomic<bool>* pAbortRound;     //!< abortRound of the search thread
+    std::thread thread;
+};
+
+bool SearchStopRequested();
@@ -0,0 +1,247 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// engine-versus-engine matches
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "core/BitBoard.h"
+#include "core/CalcParams.h"
+#include "game/Game.h"
+
+#include "PlayerComputer.h"
+#include "SelfPlay.h"
+
+using namespace std;
+
+//////////////////////////////////////
+// CMatchStats
+//////////////////////////////////////
+
+CMatchStats::CMatchStats() : nWins(0), nDraws(0), nLosses(0), nPairs(0),
+    sumDiscs(0), sumDiscs2(0), sumScore(0), sumScore2(0) {
+}
+
+static double GameScore(int nNet) {
+    return nNet>0 ? 1 : nNet<0 ? 0 : 0.5;
+}
+
+//! Add the results of a pair of games. nNet1 and nNet2 are the net discs to computer 1 in each game.
+void CMatchStats::AddPair(int nNet1, int nNet2) {
+    for (int nNet : {nNet1, nNet2}) {
+        if (nNet>0)
+            nWins++;
+        else if (nNet<0)
+            nLosses++;
+        else
+            nDraws++;
+    }
+
+    const double discs=(nNet1+nNet2)*0.5;
+    const double score=(GameScore(nNet1)+GameScore(nNet2))*0.5;
+    nPairs++;
+    sumDiscs+=discs;
+    sumDiscs2+=discs*discs;
+    sumScore+=score;
+    sumScore2+=score*score;
+}
+
+//! Half-width of the 95% confidence interval for the mean of n samples with the given sum and sum of squares
+static double ConfidenceInterval(u4 n, double sum, double sum2) {
+    if (n<2)
+        return 0;
+    const double mean=sum/n;
+    const double variance=max(0.0, (sum2-n*mean*mean)/(n-1));
+    return 1.96*sqrt(variance/n);
+}
+
+//! Computer 1's average score per game (win=1, draw=0.5), or 0 if no games have been played
+double CMatchStats::Score() const {
+    return nPairs ? sumScore/nPairs : 0;
+}
+
+//! Half-width of the 95% confidence interval for Score()
+double CMatchStats::ScoreInterval() const {
+    return ConfidenceInterval(nPairs, sumScore, sumScore2);
+}
+
+//! Computer 1's average net discs per game, or 0 if no games have been played
+double CMatchStats::Discs() const {
+    return nPairs ? sumDiscs/nPairs : 0;
+}
+
+//! Half-width of the 95% confidence interval for Discs()
+double CMatchStats::DiscsInterval() const {
+    return ConfidenceInterval(nPairs, sumDiscs, sumDiscs2);
+}
+
+//! Elo difference corresponding to an expected score. Scores are clamped to [0.001, 0.999].
+double CMatchStats::Elo(double score) {
+    score=min(max(score, 0.001), 0.999);
+    return 400*log10(score/(1-score));
+}
+
+void CMatchStats::Out(ostream& os) const {
+    os << "computer1 has Wins: " << nWins << "  Draws: " << nDraws << "  Losses: " << nLosses << "\n";
+    if (nPairs==0)
+        return;
+
+    const double score=Score();
+    const double dScore=ScoreInterval();
+    const double discs=Discs();
+    const double dDiscs=DiscsInterval();
+
+    const ios::fmtflags flags=os.flags();
+    const streamsize precision=os.precision();
+    os << fixed << setprecision(3) << "score: " << score << " +/- " << dScore;
+    os << setprecision(0) << showpos << "   elo: " << Elo(score) << " [" << Elo(score-dScore) << ", " << Elo(score+dScore) << "]\n";
+    os << setprecision(2) << "discs: " << discs << noshowpos << " +/- " << dDiscs << " per game\n";
+    os << "(95% confidence intervals from " << nPairs << " pairs of games)\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+//////////////////////////////////////
+// CSelfPlay
+//////////////////////////////////////
+
+//! Plays computer 1 against computer 2 from each position in CompareStart.pos, once with each color.
+//!
+//! Each thread has its own pair of computers, so the games have separate caches and search contexts.
+//! Finished games are appended to Compare.ggf as they come in.
+class CSelfPlay {
+public:
+    CSelfPlay(const string& fnOpening);
+    ~CSelfPlay();
+
+    bool Open();
+    void Play(CPlayerComputer& computer1, CPlayerComputer& computer2);
+
+    CMatchStats stats;
+
+private:
+    bool NextStart(CBitBoard& bb);
+    void AddPair(const COsGame games[2], const int nNets[2]);
+
+    string fnOpening;
+    FILE* fpStart;
+    ofstream osGames;
+    mutex mx;
+};
+
+CSelfPlay::CSelfPlay(const string& afnOpening) : fnOpening(afnOpening), fpStart(NULL) {
+}
+
+CSelfPlay::~CSelfPlay() {
+    if (fpStart)
+        fclose(fpStart);
+}
+
+bool CSelfPlay::Open() {
+    fpStart=fopen("CompareStart.pos","rb");
+    if (!fpStart) {
+        cerr << "Can't open CompareStart.pos\n";
+        return false;
+    }
+    osGames.open("Compare.ggf");
+    if (!osGames) {
+        cerr << "Can't create Compare.ggf\n";
+        return false;
+    }
+    return true;
+}
+
+//! Get the next start position. \return false if there are none left
+bool CSelfPlay::NextStart(CBitBoard& bb) {
+    lock_guard<mutex> lock(mx);
+    return fread(&bb,sizeof(bb),1,fpStart)==1;
+}
+
+void CSelfPlay::AddPair(const COsGame games[2], const int nNets[2]) {
+    lock_guard<mutex> lock(mx);
+    stats.AddPair(nNets[0], nNets[1]);
+    osGames << games[0] << "\n" << games[1] << "\n";
+    osGames.flush();
+    cout << nNets[0] << '\t' << nNets[1] << '\n';
+}
+
+//! Thread job: play pairs of games until the start positions run out
+void CSelfPlay::Play(CPlayerComputer& computer1, CPlayerComputer& computer2) {
+    CBitBoard bb;
+    while (NextStart(bb)) {
+        char sBoardText[NN+1];
+        bb.GetSBoard(sBoardText, true);
+
+        COsGame games[2];
+        int nNets[2];
+        for (int i=0; i<2; i++) {
+            // clear caches
+            computer1.Clear();
+            computer2.Clear();
+
+            unique_ptr<CGame> game;
+            {
+                // the constructor reads the opening file and calls gmtime(), so one at a time
+                lock_guard<mutex> lock(mx);
+                game.reset(new CGame(i?&computer2:&computer1, i?&computer1:&computer2, tMatch, fnOpening));
+            }
+            game->Initialize(sBoardText, true);
+
+            nNets[i]=game->Play();
+            if (i)
+                nNets[i]=-nNets[i];
+            games[i]=*game;
+        }
+        AddPair(games, nNets);
+    }
+}
+
+//! Play computer 1 against computer 2 from the positions in CompareStart.pos using nThreads threads.
+//!
+//! If nThreads is 0, use one thread per core. The computers share the cache memory given in parameters.txt.
+void Compare(const CComputerDefaults& cd1, const CComputerDefaults& cd2, int nThreads, const string& fnOpening) {
+    if (nThreads<=0)
+        nThreads=max(1, int(thread::hardware_concurrency()));
+
+    CSelfPlay selfPlay(fnOpening);
+    if (!selfPlay.Open())
+        return;
+
+    // move-by-move output from several games at once is unreadable.
+    // Each computer has its own cache, so split the memory between them.
+    CComputerDefaults cds[2]={cd1, cd2};
+    for (CComputerDefaults& cd : cds) {
+        if (nThreads>1)
+            cd.fsPrint=cd.fsPrintOpponent=0;
+        cd.nCacheBytes=maxCacheMem/(2*nThreads);
+    }
+
+    // construct the computers on this thread; finding evaluators and books is not thread safe
+    vector<unique_ptr<CPlayerComputer> > computers;
+    for (int i=0; i<nThreads*2; i++) {
+        computers.emplace_back(new CPlayerComputer(cds[i&1]));
+        ostringstream os;
+        os << computers.back()->Name() << "-" << (i&1)+1;
+        computers.back()->SetName(os.str().c_str());
+    }
+
+    cout << "Playing on " << nThreads << " thread" << (nThreads==1?"":"s") << "\n";
+    vector<thread> threads;
+    for (int i=0; i<nThreads; i++)
+        threads.emplace_back(&CSelfPlay::Play, &selfPlay, ref(*computers[i*2]), ref(*computers[i*2+1]));
+    for (thread& t : threads)
+        t.join();
+
+    cout << selfPlay.stats;
+}
@@ -0,0 +1,44 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// engine-versus-engine matches
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "n64/types.h"
+
+class CComputerDefaults;
+
+//! Results of a match between computer 1 and computer 2, played in pairs of games from the same start position.
+//!
+//! The two games of a pair share an opening, so each pair is scored as one sample when
+//! calculating confidence intervals.
+class CMatchStats {
+public:
+    CMatchStats();
+
+    void AddPair(int nNet1, int nNet2);
+    void Out(std::ostream& os) const;
+
+    double Score() const;
+    double ScoreInterval() const;
+    double Discs() const;
+    double DiscsInterval() const;
+    static double Elo(double score);
+
+    int nWins, nDraws, nLosses;
+
+private:
+    u4 nPairs;
+    double sumDiscs, sumDiscs2;     //!< sum of (squares of) average net discs per pair, to computer 1
+    double sumScore, sumScore2;     //!< sum of (squares of) average score per pair (win=1, draw=0.5)
+};
+
+inline std::ostream& operator<<(std::ostream& os, const CMatchStats& stats) { stats.Out(os); return os; }
+
+void Compare(const CComputerDefaults& cd1, const CComputerDefaults& cd2, int nThreads, const std::string& fnOpening);
@@ -0,0 +1,31 @@
+#include <cmath>
+#include "n64/test.h"
+#include "SelfPlay.h"
+
+//! Match statistics for a known set of pairs: 3 wins, 2 draws and 3 losses for computer 1
+void TestMatchStats() {
+	CMatchStats stats;
+	assertEquals(0, stats.ScoreInterval(), 1e-6);
+
+	stats.AddPair(2, 4);	// two wins: score 1, 3 discs
+	assertEquals(1, stats.Score(), 1e-6);
+	assertEquals(0, stats.ScoreInterval(), 1e-6);	// not enough pairs for an interval
+	stats.AddPair(0, 0);	// two draws: score 0.5, 0 discs
+	stats.AddPair(-2, 6);	// a loss and a win: score 0.5, 2 discs
+	stats.AddPair(-4, -2);	// two losses: score 0, -3 discs
+
+	assertEquals(3, stats.nWins);
+	assertEquals(2, stats.nDraws);
+	assertEquals(3, stats.nLosses);
+
+	// pair scores 1, .5, .5, 0 have sample variance 1/6; pair discs 3, 0, 2, -3 have sample variance 7
+	assertEquals(0.5, stats.Score(), 1e-6);
+	assertEquals(1.96*sqrt(1.0/6/4), stats.ScoreInterval(), 1e-6);
+	assertEquals(0.5, stats.Discs(), 1e-6);
+	assertEquals(1.96*sqrt(7.0/4), stats.DiscsInterval(), 1e-6);
+
+	assertEquals(0, CMatchStats::Elo(0.5), 1e-3);
+	assertEquals(400*log10(3.0), CMatchStats::Elo(0.75), 1e-3);
+	assertEquals(-400*log10(3.0), CMatchStats::Elo(0.25), 1e-3);
+	assertEquals(400*log10(999.0), CMatchStats::Elo(1), 1e-3);		// clamped
+}
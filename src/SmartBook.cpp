@@ -5,6 +5,7 @@
 
 #include "core/options.h"
 #include "core/CalcParams.h"
+#include "core/NodeStats.h"
 #include "game/Game.h"
 
 #include "Pos2.h"
@@ -55,17 +56,22 @@ void CSmartBook::PlayEdmundGames(int iEdmund) {
 map<std::string, CSmartBook*> bookList;
 
 
+//! Name of the book file used by computers with this evaluator and search parameters
+std::string CSmartBook::Filename(char evalType, char coeffSet, const CCalcParams& cp) {
+	ostringstream os;
+	os << fnBaseDir << "coefficients/" << evalType << coeffSet << "_" << cp << ".book";
+	return os.str();
+}
+
 CSmartBook* CSmartBook::FindBook(char evalType, char coeffSet, CCalcParams* pcp) {
 	CSmartBook* result;
 	map<std::string, CSmartBook*>::iterator ptr;
 
-	ostringstream os;
-	os << fnBaseDir << "coefficients/" << evalType << coeffSet << "_" << *pcp << ".book";
-	std::string fnBook=os.str();
+	std::string fnBook=Filename(evalType, coeffSet, *pcp);
 	ptr=bookList.find(fnBook);
 	if (ptr==bookList.end()) {
 		try {
-			result=new CSmartBook(os.str().c_str());
+			result=new CSmartBook(fnBook.c_str());
 		}
 		catch (const std::string& s) {
 			// the book constructor only throws an exception if the book is damaged.
@@ -74,7 +80,7 @@ CSmartBook* CSmartBook::FindBook(char evalType, char coeffSet, CCalcParams* pcp)
 			std::cerr << s;
 			_exit(-3);
 		}
-		bookList[os.str()]=result;
+		bookList[fnBook]=result;
 		assert(result);
 	}
 	else {
@@ -145,7 +151,7 @@ void CSmartBook::NegamaxAndCorrectPosition(CQPosition pos, CBookData* bd, int& n
 				Pos2 pos2;
 				pos2.Initialize(pos.BitBoard(), pos.BlackMove());
 				if (fPrintCorrections)
-					cout << "\nstatus Adding deviation: " << pos.NEmpty() << " empty" << std::endl;
+					EngineOut() << "\nstatus Adding deviation: " << pos.NEmpty() << " empty" << std::endl;
 				abortOnInput=false;
 				IterativeValue(pos2, movesNonbook, cp, si, mvk, false, 1);
 				abortOnInput=true;
@@ -186,7 +192,7 @@ void CSmartBook::CorrectGame(const COsGame& game, int iGameType, int& nSearches,
 		// if this is a valid book node
 		if (pos.NEmpty()>=NEmptyMin() && pos.CalcMoves(moves)) {
 			if (fPrintCorrections) {
-				cout<<"------------------------------------\nCorrecting Position from game:\n";
+				EngineOut()<<"------------------------------------\nCorrecting Position from game:\n";
 				pos.Print();
 			}
 			bd=FindNonconstData(pos.BitBoard());
@@ -200,8 +206,8 @@ void CSmartBook::CorrectGame(const COsGame& game, int iGameType, int& nSearches,
 				CMVK mvk;
 
 				if (fPrintCorrections) {
-					cout << "OLD: not in book\n";
-					cout << "\n" << pos.NEmpty() << " search because node not in book\n";
+					EngineOut() << "OLD: not in book\n";
+					EngineOut() << "\n" << pos.NEmpty() << " search because node not in book\n";
 				}
 				Pos2 pos2;
 				pos2.Initialize(pos.BitBoard(), pos.BlackMove());
@@ -217,7 +223,7 @@ void CSmartBook::CorrectGame(const COsGame& game, int iGameType, int& nSearches,
 			}
 			else {
 				if (fPrintCorrections)
-					cout << "OLD: " << *bd << "\n";
+					EngineOut() << "OLD: " << *bd << "\n";
 			}
 			if (iGameType>=0)
 				bd->IncrementGameCount(iGameType);
@@ -230,14 +236,14 @@ void CSmartBook::CorrectGame(const COsGame& game, int iGameType, int& nSearches,
 				}
 			}
 			if (fPrintCorrections)
-				cout << "NEW: " << *bd << "\n";
+				EngineOut() << "NEW: " << *bd << "\n";
 		}
 	}
 	nsEnd.Read();
 
 	if (fPrintCorrections) {
-		cout <<"\nDone correcting game positions! ";
-		cout << nSearches << " searches in " << (nsEnd-nsStart).Seconds() << "s\n";
+		EngineOut() <<"\nDone correcting game positions! ";
+		EngineOut() << nSearches << " searches in " << (nsEnd-nsStart).Seconds() << "s\n";
 	}
 	m_fAltered=true;
 }
@@ -283,7 +289,7 @@ void CSmartBook::IncreaseHeight(CQPosition pos, CBookData* bd, CHeightInfo hi, i
 
 		if (fPrintCorrections) {
 			hi.SetNEmpty(pos.NEmpty());
-			cout << "\n" << pos.NEmpty() << " search increased-height leaf node ("
+			EngineOut() << "\n" << pos.NEmpty() << " search increased-height leaf node ("
 				<< bd->Hi() << "->" << hi << ")\n";
 		}
 		CSearchInfo si(m_pComputer->cd.iPruneMidgame, m_pComputer->cd.iPruneEndgame,
@@ -373,7 +379,7 @@ void CSmartBook::NegamaxAndCorrectAll(int& nSearches) {
 			size_t size=entries[nEmpty].size();
 			if (size) {
 				cerr << "RED ALERT: BOOK MAY BE CORRUPT\nErasing " << size << " entries at " << nEmpty << "empties\n";
-				cout << "RED ALERT: BOOK MAY BE CORRUPT\nErasing " << size << " entries at " << nEmpty << "empties\n";
+				EngineOut() << "RED ALERT: BOOK MAY BE CORRUPT\nErasing " << size << " entries at " << nEmpty << "empties\n";
 				entries[nEmpty].clear();
 			}
 		}
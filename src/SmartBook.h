@@ -22,6 +22,7 @@ public:
     //! \name Book library
     //! \{
     static CSmartBook* FindBook(char evalType, char coeffSet, CCalcParams* pcp);
+    static std::string Filename(char evalType, char coeffSet, const CCalcParams& cp);
     static void Clean();
     //! \}
 
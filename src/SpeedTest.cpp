@@ -9,6 +9,7 @@
 #include <string>
 #include <iomanip>
 #include <math.h>
+#include <memory>
 #include "core/Moves.h"
 #include "core/QPosition.h"
 #include "core/Cache.h"
@@ -17,6 +18,7 @@
 #include "core/NodeStats.h"
 #include "core/CalcParams.h"
 #include "core/MPCStats.h"
+#include "core/SearchProfile.h"
 
 #include "SpeedTest.h"
 #include "Evaluator.h"
@@ -157,6 +159,8 @@ void TestMidgameSpeed(int nEmpty, CHeightInfo hi, int nGames, int flags) {
     	cout << "\n";
 
     	cout << end-start << "\n";
+    	(end-start).OutCounters(cout);
+    	cout << "\n";
     }
     else {
     	cout << nCorrect << "\t" << tTotal/nGames << "\n";
@@ -268,6 +272,13 @@ void FFOTest() {
 
 void TestMoveSpeed(int hSolveFrom, int nGames, char* sMode) {
     CHeightInfo hi(hSolveFrom-hSolverStart, 0,true);
+
+    // if the mode contains a p, profile the searches and print the profile at the end
+    std::unique_ptr<CSearchProfile> profile;
+    if (sMode && strchr(sMode,'p'))
+        profile.reset(new CSearchProfile);
+    CProfileScope profileScope(profile.get());
+
 #ifdef GET_RID
     	//FFOTest();
     	// if the mode contains an e it is endgame only
@@ -280,4 +291,7 @@ void TestMoveSpeed(int hSolveFrom, int nGames, char* sMode) {
     	TestMidgameSpeed(hEndgame, CHeightInfo(hEndgame-hSolverStart,0,true), 12, kPrintTestHeader);
     	const int hMidgame=28;
     	TestMidgameSpeed(36, CHeightInfo(hMidgame,4,false), 12, kPrintTestHeader);
+
+    if (profile)
+        cout << *profile;
 }    
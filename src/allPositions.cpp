@@ -2,25 +2,40 @@
 //  All Rights Reserved
 // This file is distributed subject to GNU GPL version 3. See the files
 // GPLv3.txt and License.txt in the instructions subdirectory for details.
-#define __STDC_FORMAT_MACROS
-#include <inttypes.h>
 
-#include <cstdlib>
+//! \file
+//! Enumerate all positions reachable from the start position, ply by ply.
+//!
+//! Each ply is stored in <dir>/ply<n>.bin as sorted, unique 16-byte boards (minimal reflections,
+//! ordered by operator<). A ply is built from the previous one in two phases:
+//!   1. Worker threads expand chunks of the previous ply into their own buffers. A full buffer is
+//!      radix sorted, deduplicated and spilled to disk as a run.
+//!   2. The runs are merged. Samples kept from each run split the key space into partitions,
+//!      which are merged by separate threads and then concatenated into the ply file.
+//! Memory use is bounded by the run buffers, so the depth reached is limited by disk rather than RAM.
+//! An interrupted enumeration restarts from the deepest complete ply file.
+//!
+//! usage: allpos [maxPly [dir [nThreads [runMB]]]]
+
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iostream>
-#include <set>
-#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
-// #define USE_GOOGLE_SPARSE_HASH
-
-#ifdef USE_GOOGLE_SPARSE_HASH
-#include <sparsehash/sparse_hash_set>
-#endif
-
 #include "core/BitBoard.h"
 #include "core/Moves.h"
+#include "core/Ticks.h"
 #include "Evaluator.h"
 #include "Search.h"
 #include "pattern/FastFlip.h"
@@ -28,59 +43,466 @@
 
 using namespace std;
 
-struct CBitBoardHash {
-    u64 operator()(const CBitBoard& bb) const {
-        return bb.Hash();
-    }
+static const size_t kChunkBoards=1<<16;    // boards handed to an expanding thread at a time
+static const size_t kIOBoards=1<<12;       // buffer size for reading and writing board files
+static const u64 kSampleInterval=1<<12;    // board files keep every kSampleInterval'th board to choose partitions
+static const size_t kMaxFanIn=64;          // maximum number of runs merged at once
+static const size_t kMaxChildren=64;       // more than the number of children of any position
+
+static void Die(const string& msg) {
+    cerr << "allpos: " << msg << endl;
+    exit(-1);
+}
+
+static string FileName(const string& dir, const string& prefix, u64 n, const string& suffix=".bin") {
+    ostringstream os;
+    os << dir << "/" << prefix << n << suffix;
+    return os.str();
+}
+
+static bool FileExists(const string& fn) {
+    return ifstream(fn.c_str(), ios::binary).good();
+}
+
+/////////////////////////////////////////////////////
+// Board files
+/////////////////////////////////////////////////////
+
+//! Buffered reader for the boards [begin, end) of a board file
+class CBoardReader {
+public:
+    CBoardReader(const string& fn, u64 begin=0, u64 end=~u64(0));
+
+    bool Get(CBitBoard& bb);
+    size_t Read(vector<CBitBoard>& boards, size_t n);
+
+    static u64 NBoards(const string& fn);
+    static CBitBoard BoardAt(ifstream& in, u64 i);
+
+private:
+    ifstream in;
+    vector<CBitBoard> buf;
+    size_t iBuf;
+    u64 nRemaining;
 };
 
-#ifdef USE_GOOGLE_SPARSE_HASH
-typedef google::sparse_hash_set<CBitBoard, CBitBoardHash> PlySet;
-#else
-typedef unordered_set<CBitBoard, CBitBoardHash> PlySet;
-#endif
+CBoardReader::CBoardReader(const string& fn, u64 begin, u64 end) : in(fn.c_str(), ios::binary), iBuf(0) {
+    if (!in)
+        Die("can't open "+fn);
+    nRemaining=min(end, NBoards(fn))-begin;
+    in.seekg(begin*sizeof(CBitBoard));
+}
+
+//! Read the next board. \return false at the end of the range
+bool CBoardReader::Get(CBitBoard& bb) {
+    if (iBuf==buf.size()) {
+        iBuf=0;
+        if (!Read(buf, kIOBoards))
+            return false;
+    }
+    bb=buf[iBuf++];
+    return true;
+}
+
+//! Replace the contents of boards with up to n boards read directly from the file.
+//! \return the number of boards read
+size_t CBoardReader::Read(vector<CBitBoard>& boards, size_t n) {
+    boards.resize(size_t(min<u64>(n, nRemaining)));
+    if (!boards.empty()) {
+        in.read((char*)&boards[0], boards.size()*sizeof(CBitBoard));
+        if (!in)
+            Die("error reading board file");
+        nRemaining-=boards.size();
+    }
+    return boards.size();
+}
 
-void AllPositions() {
+u64 CBoardReader::NBoards(const string& fn) {
+    ifstream in(fn.c_str(), ios::binary|ios::ate);
+    if (!in)
+        Die("can't open "+fn);
+    return u64(in.tellg())/sizeof(CBitBoard);
+}
+
+CBitBoard CBoardReader::BoardAt(ifstream& in, u64 i) {
     CBitBoard bb;
-    bb.Initialize();
-    PlySet *current = new PlySet;
-    current->insert(bb);
-    PlySet *next = new PlySet;
-    bool black_move = true;
-    unsigned step;
-    for (step = 0; step < 12; ++step, black_move = !black_move) {
-        cout << "Move: " << step << " ply count " << current->size() << endl;
-        for (CBitBoard cbb: *current) {
-            u64 move_bits = mobility(cbb.mover, cbb.getEnemy());
-            if (move_bits) {
-                CMoves moves;
-                moves.Set(move_bits);
-                CMove move;
-                while (moves.GetNext(move)) {
-                    CBitBoard nbb = cbb;
-                    const int sq = move.Square();
-                    const uint64_t flip = flips(sq, nbb.mover, nbb.getEnemy());
-                    const uint64_t square_mask = mask(sq);
-                    nbb.mover ^= (flip | square_mask);
-                    nbb.empty ^= square_mask;
-                    nbb.InvertColors();
-                    next->insert(nbb.MinimalReflection());
-                }
-            } else {
-                CBitBoard nbb = cbb;
-                u64 enemy_move_bits = mobility(nbb.getEnemy(), nbb.mover);
-                if (enemy_move_bits) {
-                    nbb.InvertColors();
-                    next->insert(nbb.MinimalReflection());
-                }
-            }
+    in.seekg(i*sizeof(CBitBoard));
+    in.read((char*)&bb, sizeof(bb));
+    if (!in)
+        Die("error reading board file");
+    return bb;
+}
+
+//! A sorted, unique board file and a sample of its boards
+struct CRun {
+    string fn;
+    u64 n;
+    vector<CBitBoard> samples;    //!< boards at indices 0, kSampleInterval, 2*kSampleInterval, ...
+
+    u64 LowerBound(const CBitBoard& bb) const;
+};
+
+//! Index of the first board in the file that is not less than bb
+u64 CRun::LowerBound(const CBitBoard& bb) const {
+    // the samples narrow the search to one interval; finish with a binary search of the file
+    const size_t iSample=lower_bound(samples.begin(), samples.end(), bb)-samples.begin();
+    if (iSample==0)
+        return 0;
+    u64 lo=(iSample-1)*kSampleInterval+1;
+    u64 hi=min(n, iSample*kSampleInterval);
+    ifstream in(fn.c_str(), ios::binary);
+    while (lo<hi) {
+        const u64 mid=(lo+hi)/2;
+        if (CBoardReader::BoardAt(in, mid)<bb)
+            lo=mid+1;
+        else
+            hi=mid;
+    }
+    return lo;
+}
+
+//! Buffered writer for board files that keeps samples as it goes
+class CBoardWriter {
+public:
+    CBoardWriter(const string& fn);
+    ~CBoardWriter() { Close(); }
+
+    void Put(const CBitBoard& bb);
+    void Close();
+    CRun Run();
+
+private:
+    ofstream out;
+    vector<CBitBoard> buf;
+    CRun run;
+};
+
+CBoardWriter::CBoardWriter(const string& fn) : out(fn.c_str(), ios::binary|ios::trunc) {
+    if (!out)
+        Die("can't create "+fn);
+    run.fn=fn;
+    run.n=0;
+    buf.reserve(kIOBoards);
+}
+
+void CBoardWriter::Put(const CBitBoard& bb) {
+    if (run.n%kSampleInterval==0)
+        run.samples.push_back(bb);
+    run.n++;
+    buf.push_back(bb);
+    if (buf.size()==kIOBoards) {
+        out.write((const char*)&buf[0], buf.size()*sizeof(CBitBoard));
+        buf.clear();
+    }
+}
+
+void CBoardWriter::Close() {
+    if (!out.is_open())
+        return;
+    if (!buf.empty())
+        out.write((const char*)&buf[0], buf.size()*sizeof(CBitBoard));
+    buf.clear();
+    out.close();
+    if (!out)
+        Die("error writing "+run.fn);
+}
+
+//! Close the file and return its description
+CRun CBoardWriter::Run() {
+    Close();
+    return run;
+}
+
+/////////////////////////////////////////////////////
+// Sorting and merging
+/////////////////////////////////////////////////////
+
+//! 16-bit digit d of the sort key; digits 0-3 come from empty and 4-7 from mover, matching operator<
+static inline unsigned Digit(const CBitBoard& bb, int d) {
+    const u64 word=d<4 ? bb.empty : bb.mover;
+    return unsigned(word>>(16*(d&3)))&0xFFFF;
+}
+
+//! LSD radix sort on the 128-bit key. Passes on digits that are the same in every board are skipped.
+static void RadixSort(vector<CBitBoard>& boards, vector<CBitBoard>& scratch) {
+    const size_t n=boards.size();
+    vector<u64> counts(8<<16);
+    for (const CBitBoard& bb : boards) {
+        for (int d=0; d<8; d++)
+            counts[(d<<16)+Digit(bb, d)]++;
+    }
+
+    scratch.resize(n);
+    for (int d=0; d<8; d++) {
+        u64* count=&counts[d<<16];
+        if (count[Digit(boards[0], d)]==n)
+            continue;
+        u64 offset=0;
+        for (int i=0; i<1<<16; i++) {
+            const u64 c=count[i];
+            count[i]=offset;
+            offset+=c;
         }
-        PlySet *t = current;
-        current = next;
-        next = t;
-        next->clear();
+        for (const CBitBoard& bb : boards)
+            scratch[count[Digit(bb, d)]++]=bb;
+        boards.swap(scratch);
+    }
+}
+
+//! Merge the boards in [*pLo, *pHi) of the runs into a sorted, unique board file.
+//! A NULL bound is open.
+static CRun MergeRuns(const vector<const CRun*>& runs, const CBitBoard* pLo, const CBitBoard* pHi, const string& fnOut) {
+    vector<unique_ptr<CBoardReader> > readers;
+    typedef pair<CBitBoard, size_t> THead;
+    priority_queue<THead, vector<THead>, greater<THead> > heads;
+
+    for (const CRun* run : runs) {
+        const u64 begin=pLo ? run->LowerBound(*pLo) : 0;
+        const u64 end=pHi ? run->LowerBound(*pHi) : run->n;
+        if (begin<end) {
+            readers.emplace_back(new CBoardReader(run->fn, begin, end));
+            CBitBoard bb;
+            readers.back()->Get(bb);
+            heads.push(THead(bb, readers.size()-1));
+        }
+    }
+
+    CBoardWriter writer(fnOut);
+    CBitBoard bbLast;
+    bool fAny=false;
+    while (!heads.empty()) {
+        const THead head=heads.top();
+        heads.pop();
+        if (!fAny || head.first!=bbLast) {
+            writer.Put(head.first);
+            bbLast=head.first;
+            fAny=true;
+        }
+        CBitBoard bb;
+        if (readers[head.second]->Get(bb))
+            heads.push(THead(bb, head.second));
+    }
+    return writer.Run();
+}
+
+//! Call job(i) for each i in [0,n) using nThreads threads
+static void ParallelFor(int nThreads, size_t n, const function<void(size_t)>& job) {
+    atomic<size_t> next(0);
+    vector<thread> threads;
+    for (int t=0; t<nThreads; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i; (i=next++)<n; )
+                job(i);
+        });
+    }
+    for (thread& t : threads)
+        t.join();
+}
+
+/////////////////////////////////////////////////////
+// Ply generation
+/////////////////////////////////////////////////////
+
+//! Append the minimal reflections of all positions reachable in one ply from bb.
+//! A pass counts as a ply; positions where neither side can move have no children.
+static void AddChildren(const CBitBoard& bb, vector<CBitBoard>& children) {
+    u64 move_bits = mobility(bb.mover, bb.getEnemy());
+    if (move_bits) {
+        CMoves moves;
+        moves.Set(move_bits);
+        CMove move;
+        while (moves.GetNext(move)) {
+            CBitBoard nbb = bb;
+            const int sq = move.Square();
+            const uint64_t flip = flips(sq, nbb.mover, nbb.getEnemy());
+            const uint64_t square_mask = mask(sq);
+            nbb.mover ^= (flip | square_mask);
+            nbb.empty ^= square_mask;
+            nbb.InvertColors();
+            children.push_back(nbb.MinimalReflection());
+        }
+    } else {
+        CBitBoard nbb = bb;
+        u64 enemy_move_bits = mobility(nbb.getEnemy(), nbb.mover);
+        if (enemy_move_bits) {
+            nbb.InvertColors();
+            children.push_back(nbb.MinimalReflection());
+        }
+    }
+}
+
+//! Builds one ply file from the previous one
+class CPlyBuilder {
+public:
+    CPlyBuilder(const string& dir, int nThreads, u64 runBoards);
+
+    u64 Build(const string& fnIn, const string& fnOut);
+    size_t NRuns() const { return nRuns; }
+
+private:
+    void Expand();
+    void Spill(vector<CBitBoard>& boards, vector<CBitBoard>& scratch);
+    void ReduceRuns();
+    u64 MergePartitions(const string& fnOut);
+    string TempFile(const string& prefix);
+
+    string dir;
+    int nThreads;
+    u64 runBoards;
+
+    unique_ptr<CBoardReader> input;
+    mutex mxInput;
+    vector<CRun> runs;
+    mutex mxRuns;
+    atomic<u64> nTempFiles;
+    size_t nRuns;
+};
+
+CPlyBuilder::CPlyBuilder(const string& adir, int anThreads, u64 arunBoards)
+    : dir(adir), nThreads(anThreads), runBoards(arunBoards), nTempFiles(0), nRuns(0) {
+}
+
+string CPlyBuilder::TempFile(const string& prefix) {
+    return FileName(dir, prefix, nTempFiles++, ".tmp");
+}
+
+//! Build the ply after fnIn and write it to fnOut. \return the number of positions
+u64 CPlyBuilder::Build(const string& fnIn, const string& fnOut) {
+    input.reset(new CBoardReader(fnIn));
+    runs.clear();
+    ParallelFor(nThreads, nThreads, [this](size_t) { Expand(); });
+    input.reset();
+    nRuns=runs.size();
+
+    ReduceRuns();
+    return MergePartitions(fnOut);
+}
+
+//! Thread job: expand chunks of the input until it is used up, spilling runs as the buffer fills
+void CPlyBuilder::Expand() {
+    vector<CBitBoard> chunk, children, scratch;
+    children.reserve(runBoards);
+    for (;;) {
+        {
+            lock_guard<mutex> lock(mxInput);
+            if (!input->Read(chunk, kChunkBoards))
+                break;
+        }
+        for (const CBitBoard& bb : chunk) {
+            if (children.size()+kMaxChildren>runBoards)
+                Spill(children, scratch);
+            AddChildren(bb, children);
+        }
+    }
+    if (!children.empty())
+        Spill(children, scratch);
+}
+
+//! Sort and deduplicate boards, write them to a new run, and empty boards
+void CPlyBuilder::Spill(vector<CBitBoard>& boards, vector<CBitBoard>& scratch) {
+    RadixSort(boards, scratch);
+    CBoardWriter writer(TempFile("run"));
+    for (size_t i=0; i<boards.size(); i++) {
+        if (i==0 || boards[i]!=boards[i-1])
+            writer.Put(boards[i]);
+    }
+    CRun run=writer.Run();
+    boards.clear();
+
+    lock_guard<mutex> lock(mxRuns);
+    runs.push_back(run);
+}
+
+//! Merge groups of runs until there are few enough to merge at once
+void CPlyBuilder::ReduceRuns() {
+    while (runs.size()>kMaxFanIn) {
+        const size_t nGroups=(runs.size()+kMaxFanIn-1)/kMaxFanIn;
+        vector<CRun> merged(nGroups);
+        ParallelFor(nThreads, nGroups, [&](size_t iGroup) {
+            vector<const CRun*> group;
+            for (size_t i=iGroup*kMaxFanIn; i<runs.size() && i<(iGroup+1)*kMaxFanIn; i++)
+                group.push_back(&runs[i]);
+            merged[iGroup]=MergeRuns(group, NULL, NULL, TempFile("run"));
+            for (const CRun* run : group)
+                remove(run->fn.c_str());
+        });
+        runs.swap(merged);
+    }
+}
+
+//! Merge the runs into fnOut, one key range per task. \return the number of positions
+u64 CPlyBuilder::MergePartitions(const string& fnOut) {
+    vector<const CRun*> pRuns;
+    vector<CBitBoard> samples;
+    for (const CRun& run : runs) {
+        pRuns.push_back(&run);
+        samples.insert(samples.end(), run.samples.begin(), run.samples.end());
+    }
+    sort(samples.begin(), samples.end());
+    samples.erase(unique(samples.begin(), samples.end()), samples.end());
+
+    // several partitions per thread so a thread that finishes early can take another
+    const size_t nPartitions=max<size_t>(1, min<size_t>(nThreads*4, samples.size()));
+    vector<CBitBoard> splitters;
+    for (size_t i=1; i<nPartitions; i++)
+        splitters.push_back(samples[i*samples.size()/nPartitions]);
+
+    vector<CRun> parts(nPartitions);
+    ParallelFor(nThreads, nPartitions, [&](size_t i) {
+        const CBitBoard* pLo=i ? &splitters[i-1] : NULL;
+        const CBitBoard* pHi=i<splitters.size() ? &splitters[i] : NULL;
+        parts[i]=MergeRuns(pRuns, pLo, pHi, TempFile("part"));
+    });
+    for (const CRun& run : runs)
+        remove(run.fn.c_str());
+    runs.clear();
+
+    // write to a temporary file so an interrupted run never leaves a partial ply file
+    const string fnTemp=fnOut+".tmp";
+    u64 n=0;
+    {
+        ofstream out(fnTemp.c_str(), ios::binary|ios::trunc);
+        vector<CBitBoard> boards;
+        for (const CRun& part : parts) {
+            CBoardReader reader(part.fn);
+            while (reader.Read(boards, kChunkBoards))
+                out.write((const char*)&boards[0], boards.size()*sizeof(CBitBoard));
+            remove(part.fn.c_str());
+            n+=part.n;
+        }
+        out.close();
+        if (!out)
+            Die("error writing "+fnTemp);
+    }
+    remove(fnOut.c_str());
+    if (rename(fnTemp.c_str(), fnOut.c_str()))
+        Die("can't rename "+fnTemp);
+    return n;
+}
+
+void AllPositions(int maxPly, const string& dir, int nThreads, u64 runMB) {
+    // each thread needs its run buffer plus the same again as scratch space for sorting
+    const u64 runBoards=max<u64>(kMaxChildren*2, (runMB<<20)/(2*sizeof(CBitBoard)*nThreads));
+
+    // restart from the deepest complete ply
+    int ply=0;
+    if (!FileExists(FileName(dir, "ply", 0))) {
+        CBitBoard bb;
+        bb.Initialize();
+        CBoardWriter writer(FileName(dir, "ply", 0));
+        writer.Put(bb.MinimalReflection());
+    }
+    while (ply<maxPly && FileExists(FileName(dir, "ply", ply+1)))
+        ply++;
+    cout << "Move: " << ply << " ply count " << CBoardReader::NBoards(FileName(dir, "ply", ply)) << endl;
+
+    CPlyBuilder builder(dir, nThreads, runBoards);
+    for (; ply<maxPly; ply++) {
+        const i8 tStart=GetTicks();
+        const u64 n=builder.Build(FileName(dir, "ply", ply), FileName(dir, "ply", ply+1));
+        cout << "Move: " << ply+1 << " ply count " << n << "\t(" << builder.NRuns() << " runs, "
+             << SecondsSince(tStart) << " s)" << endl;
     }
-    cout << "Move: " << step << " ply count " << current->size() << endl;
 }
 
 bool HasInput() { return false; }
@@ -90,5 +512,12 @@ int main(int argc, char **argv) {
     initFlips();
     InitConfigToPotMob();
 
-    AllPositions();    
+    const int maxPly = argc>1 ? atoi(argv[1]) : 12;
+    const string dir = argc>2 ? argv[2] : ".";
+    int nThreads = argc>3 ? atoi(argv[3]) : int(thread::hardware_concurrency());
+    const u64 runMB = argc>4 ? atoi(argv[4]) : 1024;
+    if (nThreads<1)
+        nThreads=1;
+
+    AllPositions(maxPly, dir, nThreads, runMB);
 }
@@ -1,7 +1,7 @@
 #include <cassert>
-#include <fstream>
 
 #include "../n64/test.h"
+#include "../odk/GgfReader.h"
 #include "BitBoard.h"
 #include "Moves.h"
 #include "QPosition.h"
@@ -179,18 +179,17 @@ std::vector<COsGame> LoadTestGames() {
 	std::vector<COsGame> sgTest;
 
 	std::string fn="TestGames.ggf";
-	std::ifstream is(fn.c_str());
-	if (!is){
+	CMappedFile file;
+	if (!file.Open(fn)){
 		std::cerr << "Can't open test games file " << fn << "\n";
 		std::cout << "Can't open test games file " << fn << "\n";
 	}
 	else {
-		COsGame game;
-		while (is >> game) {
+		CGgfParser().ForEach(file.Text(), [&sgTest](const COsGame& game) {
 			if (game.Result().status==COsResult::kNormalEnd) {
 				sgTest.push_back(game);
 			}
-		}
+		});
 		if (sgTest.empty()) {
 			std::cerr << "Can't load any test games \n";
 			std::cout << "Can't load any test games \n";
@@ -21,6 +21,7 @@
 #include "../odk/OsObjects.h"
 
 #include "Moves.h"
+#include "NodeStats.h"
 #include "QPosition.h"
 #include "options.h"
 #include "Book.h"
@@ -242,7 +243,7 @@ void CBookData::StoreLeaf(const CHeightInfoX& hixNew, CValue v, const CBoni& bon
             values.SetLeaf(v, hixNew.WldProven());
             values.AssignLeaf(boni);
         } else {
-            std::cout << "WARNING: StoreLeaf asked to store non-leaf" << std::endl;
+            EngineOut() << "WARNING: StoreLeaf asked to store non-leaf" << std::endl;
         }
     }
 }
@@ -489,7 +490,7 @@ void CBook::Read() {
 
             if (m_os) {
                 if (m_nHashErr) {
-                    std::cout << "Book appears to be corrupt\n";
+                    EngineOut() << "Book appears to be corrupt\n";
                 }
                 *m_os << "Done\n";
             }
@@ -510,7 +511,8 @@ void CBook::Read() {
         }
     }
     if (m_os) {
-        *m_os << "Done loading book " << m_store->ToString() << std::endl;
+        if (m_store)
+            *m_os << "Done loading book " << m_store->ToString() << std::endl;
         *m_os << "Book contains " << entries[32].size() << " entries at 32 empty, of which "
             << CountProvenPositions(entries[32]) << " have been solved at 100% WLD or 100%" << std::endl;
     }
@@ -629,7 +631,7 @@ void CBook::ReadVersion1(Reader& in) {
     for (nRead=0; nRead<nSize && HashRead(&board, sizeof(board), in) && HashRead(&bd, sizeof(bd), in); nRead++) {
         int nEmpty=bitCountInt(board.empty);
         assert((board.mover & board.empty) == 0);
-        std::cout << "Book " << nRead << " nEmpty " << nEmpty << std::endl;
+        EngineOut() << "Book " << nRead << " nEmpty " << nEmpty << std::endl;
         if (nEmpty<nEmptyBookMax) {
             entries[nEmpty][board]=bd;
         }
@@ -1020,7 +1022,7 @@ static u4 Probability(u4 loss, int randomShift) {
 //! \param mvs [in] vector of move information from GetSubnodes()
 //! \param chosen [out] chosen move and value
 //! \param randomShift [in] book randomness will be 2^randomShift discs.
-//! \param fPrintRandomInfo [in] true if we should print information about the choice to std::cout
+//! \param fPrintRandomInfo [in] true if we should print information about the choice to EngineOut()
 static void PickRandomMove(vector<CMVPS>& mvs, int randomShift, CMoveValue& chosen, bool fPrintRandomInfo) {
     u4 i, nChoices;
     u4 randUsed, randNumber, loss, probability;
@@ -1058,7 +1060,7 @@ static void PickRandomMove(vector<CMVPS>& mvs, int randomShift, CMoveValue& chos
     }
 
     if (fPrintRandomInfo)
-        cout << "\nChoosing move " << i+1 << "/" << nChoices << " - " << mvs[i] << "\n";
+        EngineOut() << "\nChoosing move " << i+1 << "/" << nChoices << " - " << mvs[i] << "\n";
 
     chosen = mvs[i];
 }
@@ -1100,13 +1102,13 @@ void CBook::GetSubnodes(const CQPosition& pos, int vContempt, std::vector<CMVPS>
             // In this case it can be fixed either by negamaxing the book or by playing a game through
             // the bad position.
             if(!sbd->Values().IsAssigned()) {
-                cout << "============= RED ALERT: BOOK BUG ==========\n";
-                cout << "A subnode of this position\n";
+                EngineOut() << "============= RED ALERT: BOOK BUG ==========\n";
+                EngineOut() << "A subnode of this position\n";
                 pos.Print();
-                cout << " After the move " << mv << " gives the book bug position:\n";
+                EngineOut() << " After the move " << mv << " gives the book bug position:\n";
                 subpos.Print();
-                cout << (*sbd);
-                cout << "\n=========== End book bug ==================\n";
+                EngineOut() << (*sbd);
+                EngineOut() << "\n=========== End book bug ==================\n";
             }
         }
     }
@@ -1125,8 +1127,8 @@ void CBook::PrintSubnodes(u4 iPrintLevel, const std::vector<CMVPS>& mvs, bool fB
     if (iPrintLevel) {
         vector<CMVPS>::const_iterator i;
         for (i=mvs.begin(); i!=mvs.end(); i++)
-            i->Out(cout, iPrintLevel, i->pass?fBlackMove:!fBlackMove);
-        cout << '\n';
+            i->Out(EngineOut(), iPrintLevel, i->pass?fBlackMove:!fBlackMove);
+        EngineOut() << '\n';
     }
 }
 
@@ -1157,7 +1159,7 @@ void CBook::PrintDrawTree(CQPosition pos, const std::string& pre, Collection& tr
     CMinimalReflection mr(pos.BitBoard());
     auto it=transpositions.find(mr);
     if (it!=transpositions.end()) {
-        std::cout << pre << " <transposition of " << it->second << ">\n";
+        EngineOut() << pre << " <transposition of " << it->second << ">\n";
         return;
     }
     transpositions[mr]=pre;
@@ -1182,14 +1184,14 @@ void CBook::PrintDrawTree(CQPosition pos, const std::string& pre, Collection& tr
                 post+="PA ";
             post+=std::string(it->move)+" ";
             if (it->sbd->IsProven())
-                std::cout << post << "<proven>\n";
+                EngineOut() << post << "<proven>\n";
             else if (it->sbd->IsBranch()) {
                 CQPosition posSub=pos;
                 posSub.MakeMove(it->move);
                 PrintDrawTree(posSub, post, transpositions);
             }
             else {
-                std::cout << post << "<" << it->sbd->Hi() << ">\n";
+                EngineOut() << post << "<" << it->sbd->Hi() << ">\n";
             }    
         }
     }
@@ -1290,8 +1292,8 @@ bool CBook::GetRandomMove(const CQPosition& pos, const CSearchInfo& si, CMVK& mv
     }
 
     if (fPrintLevel) {
-        cout << "BOOK: " << *bd << "\n";
-        cout << "Contempt: " << si.vContempt << "; Randomness: " << si.rs << "\n";
+        EngineOut() << "BOOK: " << *bd << "\n";
+        EngineOut() << "Contempt: " << si.vContempt << "; Randomness: " << si.rs << "\n";
     }
 
     // check for error condition and return false if we have one
@@ -1306,7 +1308,7 @@ bool CBook::GetRandomMove(const CQPosition& pos, const CSearchInfo& si, CMVK& mv
 
     // no error condition.
     if (fPassBefore) {
-        std::cout << "book PA 0 0 0 0\n";
+        EngineOut() << "book PA 0 0 0 0\n";
         mvk.move.Set(-1);
         mvk.value=0;
         mvk.fKnown=0;
@@ -1332,7 +1334,7 @@ bool CBook::GetRandomMove(const CQPosition& pos, const CSearchInfo& si, CMVK& mv
                 if (it->sbd->IsProven()) {
                     const CBookValue& values=it->sbd->Values();
                     if (!(it->pass?values.Loss():values.Win()))
-                        cout << "RED ALERT: Book error, Loss has a possible win or draw\n";
+                        EngineOut() << "RED ALERT: Book error, Loss has a possible win or draw\n";
                 }
             }
         }
@@ -1342,7 +1344,7 @@ bool CBook::GetRandomMove(const CQPosition& pos, const CSearchInfo& si, CMVK& mv
                 if (it->sbd->IsProven()) {
                     const CBookValue& values=it->sbd->Values();
                     if (it->pass?values.Win():values.Loss())
-                        cout << "RED ALERT: Book error, Draw has a possible win\n";
+                        EngineOut() << "RED ALERT: Book error, Draw has a possible win\n";
                 }
             }
             if (mvs[0].value>=0)
@@ -1370,7 +1372,7 @@ bool CBook::GetRandomMove(const CQPosition& pos, const CSearchInfo& si, CMVK& mv
 //!
 //! An Edmund node is one that is probable-solved, but the best played move is not the best move (in a WLD sense).
 //! \param[out] mv Move and value of best unplayed deviation.
-//! \param[in] fPrintEdmund True if we should print information about this node to std::cout
+//! \param[in] fPrintEdmund True if we should print information about this node to EngineOut()
 //! \param[in] iEdmund Amount of edmundization to do. 1=probable solves, 2=midgame searches, 4=draw/draw
 bool CBook::GetEdmundMove(const CQPosition& pos, CMoveValue& mv, bool fPrintEdmund, int iEdmund) const {
     // Find the book data. Return false if unusable.
@@ -1438,11 +1440,11 @@ bool CBook::GetEdmundMove(const CQPosition& pos, CMoveValue& mv, bool fPrintEdmu
         fEdmund=false;
 
     if (fEdmund && fPrintEdmund) {
-        cout << "--- Found an edmund position ---\n";
-        cout << "Best played : " << mvBestPlayed << ".  Best deviation: " << mv << ".\n";
+        EngineOut() << "--- Found an edmund position ---\n";
+        EngineOut() << "Best played : " << mvBestPlayed << ".  Best deviation: " << mv << ".\n";
         pos.Print(false);
         GetAndPrintSubnodes(pos, 0, 2);
-        cout << "--------------------------------\n";
+        EngineOut() << "--------------------------------\n";
     }
     return fEdmund;
 }
@@ -1580,7 +1582,7 @@ void CBook::NegamaxAll() {
                 if (m_os) {
                     *m_os << "RED ALERT: BOOK MAY BE CORRUPT\nErasing " << size << " entries at " << nEmpty << "empties\n";
                 }
-                cout << "RED ALERT: BOOK MAY BE CORRUPT\nErasing " << size << " entries at " << nEmpty << "empties\n";
+                EngineOut() << "RED ALERT: BOOK MAY BE CORRUPT\nErasing " << size << " entries at " << nEmpty << "empties\n";
                 entries[nEmpty].clear();
             }
         }
@@ -1738,14 +1740,14 @@ bool CBook::operator==(const CBook& b) const {
                 CQPosition pos(it->first, true);
                 pos.FPrint(stdout);
 
-                it->second.Out(std::cout);
-                std::cout << "\n";
+                it->second.Out(EngineOut());
+                EngineOut() << "\n";
                 GetAndPrintSubnodes(pos, 0, -1);
 
                 printf("\n and for the other book \n\n");
 
-                bit->second.Out(std::cout);
-                std::cout << "\n";
+                bit->second.Out(EngineOut());
+                EngineOut() << "\n";
                 b.GetAndPrintSubnodes(pos, 0, -1);
 
                 fflush(stdout);
@@ -1833,7 +1835,7 @@ void CBook::StoreIterativeResult(const CBitBoard& bb, int nBest, int nEvalOld,in
         assert(mvk.hiFull.Valid());
         if (fWLDSolved) {
             // solved root node
-            std::cout << "AddToBook mode - solved node" << std::endl;
+            EngineOut() << "AddToBook mode - solved node" << std::endl;
             if (fFull)
                 StoreLeaf(bb,CHeightInfoX(mvk.hiFull, nEmpty),value);
 
@@ -1862,7 +1864,7 @@ void CBook::StoreIterativeResult(const CBitBoard& bb, int nBest, int nEvalOld,in
             }
 
             // if round was aborted, add any evaluated nodes from the aborted round
-            if (abortRound) {
+            if (Aborted()) {
                 fWLDSolved=mvk.hiBest.WldProven(nEmpty);
                 for (i=0; i<nEvalNew; i++) {
                     CQPosition pos(bb, true);
@@ -1931,7 +1933,7 @@ void CBook::ReadStructFile(const char* filename) {
         } 
         ++entries;
     }
-    std::cout << "read: " << entries << " solved: " << solved << std::endl;
+    EngineOut() << "read: " << entries << " solved: " << solved << std::endl;
     m_store.reset(new File("converted.JA_s26.book"));
     Write();
 }
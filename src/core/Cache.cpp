@@ -17,15 +17,6 @@ using namespace std;
 
 const bool printCacheStores=false;
 
-#define CACHE_STATS 0
-#if CACHE_STATS
-#define UPDATE_CACHE_STATS queries++; if (result) writes++;
-#define UPDATE_CACHE_STATS2 readMoves++; if (result->data.Importance()>=Importance(height,aPrune,nEmpty)) readValues++;
-#else
-#define UPDATE_CACHE_STATS
-#define UPDATE_CACHE_STATS2
-#endif
-
 // if nMPCCache is 1, we allow the cache to return an MPC value instead of a full-width value
 //    when we're not solving.
 // if it is 2, we allow the cache to return an MPC value instead of a FW value when the MPC value is
@@ -217,7 +208,6 @@ CCache::CCache(u4 anbuckets) {
     assert((nBuckets&(nBuckets-1))==0);
 
     Clear();
-    ClearStats();
 }
 
 CCache::~CCache() {
@@ -245,13 +235,10 @@ void CCache::SetStale() {
   staleCount += 1;
 }
 
-void CCache::PrintStats() const {
-    printf(" cache: %6d queries, %6d read moves, %6d read values, %6d writes\n",
-    	queries, readMoves, readValues, writes);
-}
-
-void CCache::ClearStats() {
-    queries=readMoves=readValues=writes=0;
+void CCache::SetShared(bool afShared) {
+    if (afShared && !mutexes)
+        mutexes.reset(new std::mutex[kNMutexes]);
+    fShared=afShared;
 }
 
 // FindOld -- find an entry in the cache. If there is no entry return NULL.
@@ -276,6 +263,7 @@ CCacheData* CCache::FindOld(const CBitBoard& board, u64 hash) {
 //    Return the cache entry.
 CCacheData* CCache::FindNew(const CBitBoard& board, u64 hash, int height, int aPrune, int anEmpty) {
     CCacheData* result, *result2;
+    CSearchProfile* pProfile=pSearchProfile;
 
     hash&=nBuckets-1;
     result=buckets+hash;
@@ -284,25 +272,37 @@ CCacheData* CCache::FindNew(const CBitBoard& board, u64 hash, int height, int aP
     // is this position in cache?
     if (result->board==board) {
     	result->SetStale(staleCount);
+    	if (pProfile) pProfile->Cell(height, anEmpty).nCacheUpdates++;
     }
     else if (result2->board==board) {
     	result=result2;
     	result->SetStale(staleCount);
+    	if (pProfile) pProfile->Cell(height, anEmpty).nCacheUpdates++;
     }
 
     // This position isn't the one in the cache...
     else if (result->isStale(staleCount) || result->Replaceable(height, aPrune, anEmpty)) {
+    	if (pProfile) CountStore(pProfile->Cell(height, anEmpty), *result);
     	result->Initialize(board, height, aPrune, anEmpty);
     }
     else if (result2->isStale(staleCount) || result2->Replaceable(height, aPrune, anEmpty)) {
     	result=result2;
+    	if (pProfile) CountStore(pProfile->Cell(height, anEmpty), *result);
     	result->Initialize(board, height, aPrune, anEmpty);
     }
 
-    else
+    else {
     	result=0;
-
-    UPDATE_CACHE_STATS;
+    	if (pProfile) pProfile->Cell(height, anEmpty).nCacheRejects++;
+    }
 
     return result;
 }
+
+// CountStore -- profile a store of a new position into entry cd, before cd is overwritten
+void CCache::CountStore(CSearchProfile::CCell& cell, const CCacheData& cd) const {
+    if (cd.isStale(staleCount) || cd.board.IsImpossible())
+    	cell.nCacheStores++;
+    else
+    	cell.nCacheReplaces++;
+}
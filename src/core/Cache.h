@@ -7,8 +7,12 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+
 #include "BitBoard.h"
 #include "Moves.h"
+#include "SearchProfile.h"
 
 #if defined(_WIN32)
 #include <xmmintrin.h>
@@ -33,6 +37,7 @@ public:
 
     // info
     const CBitBoard& Board() const;
+    CMove BestMove() const { return bestMove; }
 
     // load info from cache. Returns TRUE if we can return value immediately
     bool Load(int height, int iPrune, int nEmpty, CValue alpha, CValue beta, CMove& bestMove,
@@ -85,8 +90,6 @@ public:
 
     // Other
     void SetStale();
-    void PrintStats() const;
-    void ClearStats();
     void Clear();
     //void Verify();
 
@@ -103,10 +106,39 @@ public:
     CCacheData* FindNew(const CBitBoard& pos, u64 hash, int height, int iPrune, int nEmpty);
 
     int NBuckets() { return nBuckets; }
+
+    //! \name Sharing between threads
+    //! While the cache is shared, callers hold a CCacheLock from finding an entry until they are done with it.
+    //! Only call SetShared() when no other thread is using the cache.
+    //! \{
+    void SetShared(bool fShared);
+    bool Shared() const { return fShared; }
+    //! \}
 private:
-    i4 queries, readMoves, readValues, writes;
+    void CountStore(CSearchProfile::CCell& cell, const CCacheData& cd) const;
+    std::mutex* Mutex(u64 hash) const { return fShared ? &mutexes[(hash&(nBuckets-1))>>1 & (kNMutexes-1)] : NULL; }
+
+    //! Number of locks while the cache is shared. Both buckets a position can go in have the same lock.
+    enum { kNMutexes=4096 };
+
     CCacheData* buckets;
     u4 nBuckets;
     u1 staleCount = 0;
+    bool fShared = false;
+    std::unique_ptr<std::mutex[]> mutexes;
     friend class CPlayerWithCache;
+    friend class CCacheLock;
+};
+
+//! Locks the buckets for a hash while the cache is shared by several threads; does nothing otherwise.
+class CCacheLock {
+public:
+    CCacheLock(const CCache& cache, u64 hash) : pMutex(cache.Mutex(hash)) { if (pMutex) pMutex->lock(); }
+    ~CCacheLock() { if (pMutex) pMutex->unlock(); }
+
+    CCacheLock(const CCacheLock&) = delete;
+    CCacheLock& operator=(const CCacheLock&) = delete;
+
+private:
+    std::mutex* pMutex;
 };
@@ -11,6 +11,7 @@
 
 #include "options.h"
 #include "CalcParams.h"
+#include "TimeModel.h"
 
 using namespace std;
 
@@ -20,14 +21,14 @@ using namespace std;
 
 double tMatch;    // total time available for a match
 double dGHz;    //	double dGHz - Approx processor speed
-double tSetStale=0.17;    // time to SetStale() in seconds... so we don't lose on time
+thread_local double tSetStale=0.17;    // time to SetStale() in seconds... so we don't lose on time
 
 // maximum memory for cache
 uint64_t maxCacheMem=2ULL<<30; // 2 GB
 
 void SetMatchTime(double aMatchTime) {
     if (aMatchTime<=0)
-    	tMatch=10+maxCacheMem*2E-9/dGHz*60;
+    	tMatch=10+maxCacheMem*2E-9/timeModel.GHz()*60;
     else
     	tMatch=aMatchTime;
 }
@@ -38,7 +39,12 @@ void SetMatchTime(double aMatchTime) {
 
 // base class. most subclasses don't set abort time, so we won't need to override this
 
-bool CCalcParams::RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRemaining) const {
+//! Decide whether to search the round hi.
+//!
+//! \param tElapsed seconds spent on the move so far
+//! \param tRound predicted seconds for the round, from CTimeModel::PredictRound()
+//! \param tRemaining seconds left on the clock
+bool CCalcParams::RoundOK(const CHeightInfo& hi, int nEmpty, double, double, double) const {
     return hi<=MinHeight(nEmpty);
 }
 
@@ -79,6 +85,10 @@ CCalcParams* CCalcParams::NewFromString(const string& sCalcParams) {
     		is >> c >> nEmptyMinSolve;
     		pcp=new CCalcParamsAverageTime(nMinutesOrDepth,nEmptyMinSolve);
     		break;
+    	case 'n':
+    		if (nMinutesOrDepth>0)
+    			pcp=new CCalcParamsFixedNodes(nMinutesOrDepth);
+    		break;
     	}
     }
     if (pcp==NULL) {
@@ -270,13 +280,13 @@ void CCalcParamsAverageTime::SetAbortTime(const CNodeStats& nsStart, int nEmpty,
     ::SetAbortTime(TTypical(nEmpty)*1.5);
 }
 
-bool CCalcParamsAverageTime::RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRemaining) const {
+bool CCalcParamsAverageTime::RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRound, double tRemaining) const {
     if (nEmpty<=nEmptyMinSolve && !hi.ExactProven(nEmpty)) {
     	::ResetAbortTime(1e6);
     	return true;
     }
     ::ResetAbortTime(TTypical(nEmpty)*1.5);
-    return (tElapsed<=TTypical(nEmpty)*0.5);
+    return tElapsed+tRound<=TTypical(nEmpty);
 }
 
 double CCalcParamsAverageTime::TTypical(int nEmpty) const {
@@ -284,7 +294,7 @@ double CCalcParamsAverageTime::TTypical(int nEmpty) const {
 }
 
 int CCalcParamsAverageTime::LogCacheSize(int aPrune) const {
-    return int(log(dNPS*dGHz*tAverage*0.5)/log(2.0));
+    return int(log(timeModel.NPS()*tAverage*0.5)/log(2.0));
 }
 
 void CCalcParamsAverageTime::Out(ostream& os) const {
@@ -297,6 +307,36 @@ int CCalcParamsAverageTime::Strength() const {
     return LogCacheSize(4)*2-20;
 }
 
+//////////////////////////////////////
+// CCalcParamsFixedNodes
+//////////////////////////////////////
+
+CCalcParamsFixedNodes::CCalcParamsFixedNodes(u64 anNodes) {
+    nNodes=anNodes;
+}
+
+void CCalcParamsFixedNodes::SetAbortTime(const CNodeStats& nsStart, int nEmpty, double tRemaining) const {
+    ::SetAbortTime(1e6);
+    ::SetAbortNodes(nNodes);
+}
+
+// keep deepening until the node limit aborts a round or the position is solved
+bool CCalcParamsFixedNodes::RoundOK(const CHeightInfo&, int, double, double, double) const {
+    return true;
+}
+
+int CCalcParamsFixedNodes::LogCacheSize(int aPrune) const {
+    return int(log(nNodes*0.5)/log(2.0));
+}
+
+void CCalcParamsFixedNodes::Out(ostream& os) const {
+    os << "n" << nNodes;
+}
+
+int CCalcParamsFixedNodes::Strength() const {
+    return LogCacheSize(4)*2-20;
+}
+
 //////////////////////////////////////
 // CCalcParamsMatchTime
 //////////////////////////////////////
@@ -305,18 +345,14 @@ void CCalcParamsMatchTime::SetAbortTime(const CNodeStats& nsStart, int nEmpty, d
     ::SetAbortTime(std::min(TTypical(nEmpty, tRemaining)*2.0,tRemaining*0.5));
 }
 
-bool CCalcParamsMatchTime::RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRemaining) const {
+bool CCalcParamsMatchTime::RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRound, double tRemaining) const {
     double tt = TTypical(nEmpty, tRemaining);
-    double tStop=tt*0.5;
-    double tStopSpecial=tt*.3;
 
-    if (hi.WldProven(nEmpty)) {
-    	if (tElapsed>tStopSpecial && tElapsed<=tStop && false)
-    		cout << "special stop criterion for WLD round\n";
-    	return tElapsed<=tStopSpecial;
-    }
+    // once the move is known to win, draw or lose, a round only refines the value; be less willing to start it
+    if (hi.WldProven(nEmpty))
+    	return tElapsed+tRound<=tt*0.6;
     else
-    	return tElapsed<=tStop;
+    	return tElapsed+tRound<=tt;
 }
 
 double CCalcParamsMatchTime::TTypical(int nEmpty, double tRemaining) const {
@@ -18,9 +18,9 @@
 //////////////////////////////
 
 extern double tMatch;    // total time available for a match
-extern double dGHz;    // processor speed
+extern double dGHz;    // processor speed, until the time model has measured it (see CTimeModel)
 const double dNPS=400000;    // approx midgame nodes per second on a 1GHz machine
-extern double tSetStale;
+extern thread_local double tSetStale;
 
 // maximum amount of memory to allocate to cache table.
 //    should be a bit less than the total RAM on the computer.
@@ -38,7 +38,7 @@ public:
     virtual ~CCalcParams() {}
     // new functioms
     virtual void SetAbortTime(const CNodeStats& nsStart, int nEmpty, double tRemaining) const;
-    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRemaining) const;
+    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRound, double tRemaining) const;
     virtual int LogCacheSize(int aPrune) const;
     virtual void Out(std::ostream& os) const = 0;
     virtual void Name(std::ostream& os) const;
@@ -109,7 +109,7 @@ public:
     CCalcParamsAverageTime(double tAverage, int nEmptyMinSolve);
 
     virtual void SetAbortTime(const CNodeStats& nsStart, int nEmpty, double tRemaining) const;
-    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRemaining) const;
+    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRound, double tRemaining) const;
     virtual int LogCacheSize(int aPrune) const;
     virtual void Out(std::ostream& os) const;
     virtual int Strength() const;
@@ -120,10 +120,30 @@ protected:
     int nEmptyMinSolve;
 };
 
+//! Search until a fixed number of nodes have been searched, then play the best move found.
+//!
+//! Unlike the timed params the abort point doesn't depend on machine speed or load,
+//! so repeated runs search the same tree. The limit is on the searching thread's own nodes,
+//! so node-limited searches run on that one thread: ValueMulti() never hands their root moves
+//! to ValueMultiParallel()'s workers.
+class CCalcParamsFixedNodes: public CCalcParams {
+public:
+    CCalcParamsFixedNodes(u64 nNodes);
+
+    virtual void SetAbortTime(const CNodeStats& nsStart, int nEmpty, double tRemaining) const;
+    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRound, double tRemaining) const;
+    virtual int LogCacheSize(int aPrune) const;
+    virtual void Out(std::ostream& os) const;
+    virtual int Strength() const;
+
+protected:
+    u64 nNodes;
+};
+
 class CCalcParamsMatchTime: public CCalcParams {
 public:
     virtual void SetAbortTime(const CNodeStats& nsStart, int nEmpty, double tRemaining) const;
-    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRemaining) const;
+    virtual bool RoundOK(const CHeightInfo& hi, int nEmpty, double tElapsed, double tRound, double tRemaining) const;
     virtual void Out(std::ostream& os) const;
     virtual void Name(std::ostream& os) const;
     virtual int Strength() const;
@@ -10,6 +10,7 @@
 #include <time.h>
 #include <stdio.h>
 #include <math.h>
+#include <map>
 #include <sstream>
 
 using namespace std;
@@ -20,13 +21,10 @@ using namespace std;
 
 CMPCStats::CMPCStats(const char* fnStats, int anPrunes) {
     FILE* fpStats;
-    int nEmpty, nEmpties[kMaxTotPos], nPoints[kMaxTotPos];
-    double data[kMaxTotPos][kMaxMPCHeight];
     char separator;
-    int nRead, nRows, dummy, row, col, height, nCut, nDataPoints = 0, iPrune, iVersion;
+    int nRead, dummy, col, iVersion;
     int iStartCol;
-    double xx = 0.0, xy = 0.0, yy = 0.0;
-    float c = 0.0, sigma = 0.0;
+    double value;
 
     // open stats file
     fpStats=fopen(fnStats,"r");
@@ -57,29 +55,23 @@ CMPCStats::CMPCStats(const char* fnStats, int anPrunes) {
     	dMPCMultiplier = kStoneValue/10.0;
     }
 
-    // Initialize data
-    nPrunes=anPrunes;
-    nCutLocs=kMPCCuts;
-    sds=new TCutData*[nPrunes+1];
-    crs=new TCutData[hMax+1];
-    for (iPrune=0; iPrune<=nPrunes; iPrune++) {
-    	sds[iPrune]=new TCutData[hMax+1];
-    }
-
-    // repeatedly read in a row
-    for (row=0, nRead=1; nRead>0 && row<kMaxTotPos; row++) {
-        nRead=fscanf(fpStats,"%d",&(nEmpties[row]));
-        nPoints[row]=0;
+    // repeatedly read in a row. Version 1 files have no static value, so their column 0 is a placeholder.
+    vector<CMPCRow> rows;
+    for (nRead=1; nRead>0; ) {
+    	CMPCRow row;
+        nRead=fscanf(fpStats,"%d",&row.nEmpty);
+    	if (nRead<=0)
+    		break;
+    	row.values.resize(iStartCol, 0);
+    	rows.push_back(row);
     	if (EOF==fscanf(fpStats,"%c",&separator))
     		break;
     	if (separator=='\n') continue;
         for (col=iStartCol; nRead > 0; col++) {
     		if (col<=hMax) {
-    			nRead=fscanf(fpStats,"%lf",&(data[row][col]));
-                if (nRead > 0) {
-    				nPoints[row]++;
-    				data[row][col]*=dMPCMultiplier;
-    			}
+    			nRead=fscanf(fpStats,"%lf",&value);
+                if (nRead > 0)
+    				rows.back().values.push_back(value*dMPCMultiplier);
     		}
     		else
     			nRead=fscanf(fpStats,"%d",&dummy);
@@ -88,21 +80,55 @@ CMPCStats::CMPCStats(const char* fnStats, int anPrunes) {
             if (separator=='\n' || separator=='\r') break;
     	}
     }
-    nRows=row;
+    fclose(fpStats);
+
+    Fit(rows, anPrunes);
+
+    //Print(fnStats);
+}
+
+//! Fit the stats directly to calibration data, for instance from CalcMPCStats().
+//!
+//! \param ahMax largest height in the data; each row has values for heights 0..ahMax at most
+CMPCStats::CMPCStats(const vector<CMPCRow>& rows, int ahMax, int anPrunes) {
+    hMax=ahMax;
+    Fit(rows, anPrunes);
+}
+
+//! Calculate crs and sds from the data.
+//!
+//! Each (cut height, height) pair is fit separately for each number of empties as a regression
+//! through the origin of the deep value on the shallow value.
+void CMPCStats::Fit(const vector<CMPCRow>& rows, int anPrunes) {
+    int nEmpty, height, nCut, col, nDataPoints;
+    double xx = 0.0, xy = 0.0, yy = 0.0;
+    float c = 0.0, sigma = 0.0;
 
-    // calculate parameters for each possible cut pair at each depth
+    // Initialize data
+    nPrunes=anPrunes;
+    nCutLocs=kMPCCuts;
+    sds=new TCutData*[nPrunes+1];
+    crs=new TCutData[hMax+1];
+    for (int iPrune=0; iPrune<=nPrunes; iPrune++) {
+    	sds[iPrune]=new TCutData[hMax+1];
+    }
+
+    // calculate parameters for each possible cut at each depth
     for (nEmpty=0; nEmpty<60; nEmpty++) {
     	for (height=0; height<=hMax; height++) {
-    		sds[0][height][nEmpty][0]=sds[0][height][nEmpty][1]=0;
+    		for (nCut=0; nCut<kMaxMPCCuts; nCut++)
+    			sds[0][height][nEmpty][nCut]=crs[height][nEmpty][nCut]=0;
 
-    		for (nCut=0; nCut<2 && nCutLocs[height][nCut]; nCut++) {
+    		for (nCut=0; nCut<kMaxMPCCuts && nCutLocs[height][nCut]; nCut++) {
     			col=nCutLocs[height][nCut];	// height to use in prediction
     			yy=xx=xy=nDataPoints=0;
-    			for (row=0; row<nRows; row++) {
-    				if (height<=nPoints[row] && nEmpties[row]==nEmpty) {
-    					xx+=data[row][col]*data[row][col];
-    					xy+=data[row][col]*data[row][height];
-    					yy+=data[row][height]*data[row][height];
+    			for (const CMPCRow& row : rows) {
+    				if (height<int(row.values.size()) && row.nEmpty==nEmpty) {
+    					const double x=row.values[col];
+    					const double y=row.values[height];
+    					xx+=x*x;
+    					xy+=x*y;
+    					yy+=y*y;
     					nDataPoints++;
     				}
     			}
@@ -117,7 +143,7 @@ CMPCStats::CMPCStats(const char* fnStats, int anPrunes) {
 
     // fill in paramters for elements without enough data points
     for (height=0; height<=hMax; height++) {
-    	for (nCut=0; nCut<2 && nCutLocs[height][nCut]; nCut++) {
+    	for (nCut=0; nCut<kMaxMPCCuts && nCutLocs[height][nCut]; nCut++) {
     		c=sigma=0;
     		for (nEmpty=0; nEmpty<60; nEmpty++) {
     			if (sds[0][height][nEmpty][nCut]) {
@@ -148,10 +174,6 @@ CMPCStats::CMPCStats(const char* fnStats, int anPrunes) {
     default:
     	assert(0);
     }
-
-    fclose(fpStats);
-
-    //Print(fnStats);
 }
 
 void CMPCStats::Print(const char* fnStats) {
@@ -160,7 +182,7 @@ void CMPCStats::Print(const char* fnStats) {
     // print out stuff for debugging
     printf("Printing out debug info for MPC stats from %s\n", fnStats);
     for (height=0; height<=hMax; height++) {
-    	for (nCut=0; nCut<2 && nCutLocs[height][nCut]; nCut++) {
+    	for (nCut=0; nCut<kMaxMPCCuts && nCutLocs[height][nCut]; nCut++) {
     		printf("[%d/%d]\t",nCutLocs[height][nCut],height);
     		for (nEmpty=0; nEmpty<60; nEmpty++) {
     			printf("(%4.2f-%5.1f)\t",crs[height][nEmpty][nCut],sds[0][height][nEmpty][nCut]);
@@ -199,7 +221,7 @@ void CMPCStats::Multiply(int iPrune, double dMultiplier) {
 
     assert(iPrune>0 && iPrune<=nPrunes);
 
-    for (nCut=0; nCut<2; nCut++) {
+    for (nCut=0; nCut<kMaxMPCCuts; nCut++) {
     	for (height=0; height<=hMax; height++) {
     		for (nEmpty=0; nEmpty<60; nEmpty++) {
     			sds[iPrune][height][nEmpty][nCut]=float(sds[0][height][nEmpty][nCut]*dMultiplier);
@@ -216,7 +238,7 @@ void CMPCStats::Multiply(int iPrune, double dMultiplier1, double dMultiplier2) {
 
     for (nEmpty=0; nEmpty<60; nEmpty++) {
     	dMultiplier=(nEmpty>30)?dMultiplier1:dMultiplier2;
-    	for (nCut=0; nCut<2; nCut++) {
+    	for (nCut=0; nCut<kMaxMPCCuts; nCut++) {
     		for (height=0; height<=hMax; height++) {
     			sds[iPrune][height][nEmpty][nCut]=float(sds[0][height][nEmpty][nCut]*dMultiplier);
     		}
@@ -233,6 +255,24 @@ bool CMPCStats::Valid() const {
     return nCutLocs && nPrunes;
 }
 
+//! MPC stats read so far, by file name and number of prunes. Deleted at program exit.
+class CMPCStatsList: public std::map<std::pair<std::string, int>, CMPCStats*> {
+public:
+    ~CMPCStatsList();
+};
+
+static CMPCStatsList mpcStatsList;
+
+CMPCStatsList::~CMPCStatsList() {
+    for (iterator it=begin(); it!=end(); it++) {
+        delete it->second;
+    }
+}
+
+//! Get the MPC stats for an evaluator, or NULL if there are none.
+//!
+//! The stats are read once and shared by all callers, like evaluators and books; they must not
+//! be deleted. Not thread safe.
 CMPCStats* CMPCStats::GetMPCStats(char evalType,char aCoeffSet, int aPrune) {
     CMPCStats* mpcs;
     int hMaxMPC;
@@ -253,11 +293,18 @@ CMPCStats* CMPCStats::GetMPCStats(char evalType,char aCoeffSet, int aPrune) {
     		}
     	}
     	os << "coefficients/mpc" << evalType << aCoeffSet << "_" << hMaxMPC << ".txt";
-    	try {
-    		mpcs=new CMPCStats(os.str().c_str(), aPrune);
-    	}
-    	catch (int) {
-    		mpcs=NULL;
+    	{
+    		const std::pair<std::string, int> key(os.str(), aPrune);
+    		CMPCStatsList::iterator it=mpcStatsList.find(key);
+    		if (it!=mpcStatsList.end())
+    			return it->second;
+    		try {
+    			mpcs=new CMPCStats(os.str().c_str(), aPrune);
+    		}
+    		catch (int) {
+    			mpcs=NULL;
+    		}
+    		mpcStatsList[key]=mpcs;
     	}
     	break;
     default:
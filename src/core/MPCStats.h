@@ -5,35 +5,49 @@
 
 #pragma once
 
+#include <vector>
+
 #include "../n64/utils.h"
 
-typedef int TCutPair[2];
-typedef float TCutData[60][2];
+//! Most shallow searches tried at one height
+const int kMaxMPCCuts=3;
+
+typedef int TCutHeights[kMaxMPCCuts];
+typedef float TCutData[60][kMaxMPCCuts];
 
 const int khMPCMinCut=3;
 
-const TCutPair kMPCCuts[]={
+//! Heights of the shallow searches that predict the value at each height, tried in order; 0 ends the list
+const TCutHeights kMPCCuts[]={
     			{0,0}, {0,0}, {0,0}, // 0,1,2
     			{1,0}, {2,0}, {1,0}, // 3,4,5
     			{2,0}, {3,0}, {4,0}, // 6,7,8
     			{3,5}, {4,6}, {3,5}, // 9,10,11
-    			{4,0}, {5,0},		 // 12,13
-    			{4,0}, {5,0}, {6,0}, {7,0},		// 14,15,16,17
-    			{6,0}, {7,0},		// 18,19
-    			{6,0}, {7,0}, {8,0}, {9,0}, // 20,21,22,23
-    			{8,0}, {9,0},		// 24,25
-    			{10,0},				// 26
-    			{9,0}, {10,0}, {11,0},	//27,28,29
-    			{10,0}				// 30
+    			{2,4}, {3,5},		 // 12,13
+    			{2,4}, {3,5}, {2,4,6}, {3,5,7},		// 14,15,16,17
+    			{2,4,6}, {3,5,7},		// 18,19
+    			{2,4,6}, {3,5,7}, {4,6,8}, {5,7,9}, // 20,21,22,23
+    			{4,6,8}, {5,7,9},		// 24,25
+    			{6,8,10},			// 26
+    			{5,7,9}, {6,8,10}, {7,9,11},	//27,28,29
+    			{6,8,10}			// 30
 };
 
-const int kMaxMPCHeight=sizeof(kMPCCuts)/(2*sizeof(int));
+const int kMaxMPCHeight=sizeof(kMPCCuts)/sizeof(kMPCCuts[0]);
 
-class CMPCStats;
+//! One position's values from an MPC calibration run.
+//!
+//! values[h] is the value of the position searched to height h; values[0] is its static value.
+class CMPCRow {
+public:
+    int nEmpty;
+    std::vector<double> values;
+};
 
 class CMPCStats {
 public:
     CMPCStats(const char* fnStats, int anPrunes);
+    CMPCStats(const std::vector<CMPCRow>& rows, int hMax, int anPrunes);
     ~CMPCStats();
 
     bool BadCutHeight(int height);
@@ -47,8 +61,10 @@ public:
     static CMPCStats* GetMPCStats(char evalType,char aCoeffSet, int aPrune);
 
 protected:
+    void Fit(const std::vector<CMPCRow>& rows, int anPrunes);
+
     int hMax,nPrunes;
-    const TCutPair *nCutLocs;
+    const TCutHeights *nCutLocs;
     TCutData *crs, **sds;
 
 };
@@ -57,5 +73,4 @@ inline bool CMPCStats::BadCutHeight(int height) {
     return (height<khMPCMinCut || height>hMax);
 }
 
-const int kMaxPositions=50;
-const int kMaxTotPos=kMaxPositions*(NN-1);
\ No newline at end of file
+const int kMaxPositions=50;
\ No newline at end of file
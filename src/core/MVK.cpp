@@ -62,3 +62,32 @@ ostream& CMVK::Out(ostream& os) const {
 	os.precision(oldPrecision);
 	return os;
 }
+
+//////////////////////////////////////
+// CMoveTiming class
+//////////////////////////////////////
+
+void CMoveTiming::Clear() {
+	tBook=tStore=tSolve=0;
+	rounds.clear();
+}
+
+void CMoveTiming::AddRound(const CHeightInfo& hi, double t) {
+	rounds.push_back(std::make_pair(hi, t));
+	if (hi.IsKnownProbableSolve())
+		tSolve+=t;
+}
+
+//! Print the phase times on one line; each round is shown as <height>:<seconds>
+void CMoveTiming::Out(ostream& os) const {
+	const std::streamsize oldPrecision=os.precision(4);
+	const std::ios_base::fmtflags oldFlags=os.setf(ios::fixed, ios::floatfield);
+
+	os << "book " << tBook << "s, rounds";
+	for (size_t i=0; i<rounds.size(); i++)
+		os << " " << rounds[i].first << ":" << rounds[i].second << "s";
+	os << ", solve " << tSolve << "s, store " << tStore << "s";
+
+	os.flags(oldFlags);
+	os.precision(oldPrecision);
+}
@@ -37,6 +37,22 @@ public:
 	CMoves submoves;
 };
 
+//! Wall-clock time spent in each phase of choosing a move, in seconds
+class CMoveTiming {
+public:
+	double tBook;	//!< looking the position up in the book
+	double tStore;	//!< storing the search result in the book
+	double tSolve;	//!< iterative deepening rounds that search to the solver
+	std::vector<std::pair<CHeightInfo, double> > rounds;	//!< time of each iterative deepening round, in order
+
+	CMoveTiming() { Clear(); }
+	void Clear();
+	void AddRound(const CHeightInfo& hi, double t);
+	void Out(std::ostream& os) const;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const CMoveTiming& timing) { timing.Out(os); return os; }
+
 class CMVK : public CMoveValue {
 public:
 	//void FPrint(FILE* fp) const;
@@ -48,6 +64,8 @@ public:
 	bool fBook;		// true if this move comes from the book
 	bool fKnown;	// true if the value has been evaluated
 	CNodeStats ns;
+	CMoveTiming timing;	//!< not reset by Clear(); TimedMVK() resets it for each move
+	std::vector<CValue> mpcValues;	//!< with kNeedMPCStats: the static value, then the value after each round
 };
 
 inline std::ostream& operator<<(std::ostream& os, const CMVK& mvk) { return mvk.Out(os);}
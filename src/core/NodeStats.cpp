@@ -13,6 +13,12 @@
 #include <iomanip>
 #include <sstream>
 #include <math.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
 #include "../n64/types.h"
 #include "../n64/utils.h"
 #include "Ticks.h"
@@ -20,29 +26,80 @@
 
 using namespace std;
 
-u4 nEvalsQuick=0;
-extern u4 nSNodesQuick;
-double nEvals=0, nSNodes=0, nINodes=0, nKFlips=0, nBBFlips=0;
+//////////////////////////////////////////////////////
+// Per-thread counter blocks
+//
+// Blocks are never freed. When a thread exits its block goes on a free list and
+// is handed to the next thread that searches; the counts it holds stay in the
+// totals, so the sum over all blocks is the total work done by the process.
+//////////////////////////////////////////////////////
+
+thread_local CThreadCounters* pThreadCounters=0;
+
+static std::atomic<CThreadCounters*> pAllCounters(0);
+static std::mutex counterMutex;
+static std::vector<CThreadCounters*>* pFreeCounters=new std::vector<CThreadCounters*>;
+
+static CThreadCounters* NewThreadCounters() {
+    // operator new only guarantees alignment to 16 bytes, so line up the block by hand
+    const size_t kAlign=alignof(CThreadCounters);
+    char* raw=new char[sizeof(CThreadCounters)+kAlign];
+    char* aligned=raw+kAlign-reinterpret_cast<uintptr_t>(raw)%kAlign;
+    CThreadCounters* p=new(aligned) CThreadCounters();
+    p->next=pAllCounters.load(std::memory_order_relaxed);
+    pAllCounters.store(p, std::memory_order_release);
+    return p;
+}
 
-bool abortRound;
-static double qtAbort;
-static double qtAbortBase;
+//! Returns the thread's counter block to the free list when the thread exits
+class CCounterLease {
+public:
+    CThreadCounters* p;
 
-void WipeNodeStats() {
-    nEvals+=nEvalsQuick;
-    nEvalsQuick=0;
-    nSNodes+=nSNodesQuick;
-    nSNodesQuick=0;
+    CCounterLease() : p(0) {}
+    ~CCounterLease() {
+        std::lock_guard<std::mutex> lock(counterMutex);
+        pFreeCounters->push_back(p);
+    }
+};
+
+CThreadCounters* AcquireThreadCounters() {
+    static thread_local CCounterLease lease;
+    {
+        std::lock_guard<std::mutex> lock(counterMutex);
+        if (pFreeCounters->empty())
+            lease.p=NewThreadCounters();
+        else {
+            lease.p=pFreeCounters->back();
+            pFreeCounters->pop_back();
+        }
+    }
+    pThreadCounters=lease.p;
+    return lease.p;
 }
 
 void CNodeStats::Read() {
-    WipeNodeStats();
+    u64 n[8]={0,0,0,0,0,0,0,0};
 
-    nSNodes=::nSNodes;
-    nKFlips=::nKFlips;
-    nBBFlips=::nBBFlips;
-    nINodes=::nINodes;
-    nEvals=::nEvals;
+    for (const CThreadCounters* p=pAllCounters.load(std::memory_order_acquire); p; p=p->next) {
+        n[0]+=p->nINodes.load(std::memory_order_relaxed);
+        n[1]+=p->nSNodes.load(std::memory_order_relaxed);
+        n[2]+=p->nBBFlips.load(std::memory_order_relaxed);
+        n[3]+=p->nEvals.load(std::memory_order_relaxed);
+        n[4]+=p->nCacheHits.load(std::memory_order_relaxed);
+        n[5]+=p->nCacheMisses.load(std::memory_order_relaxed);
+        n[6]+=p->nMPCCuts.load(std::memory_order_relaxed);
+        n[7]+=p->nBookHits.load(std::memory_order_relaxed);
+    }
+
+    nINodes=double(n[0]);
+    nSNodes=double(n[1]);
+    nBBFlips=double(n[2]);
+    nEvals=double(n[3]);
+    nCacheHits=double(n[4]);
+    nCacheMisses=double(n[5]);
+    nMPCCuts=double(n[6]);
+    nBookHits=double(n[7]);
     time=GetTicks();
 }
 
@@ -82,6 +139,21 @@ void CNodeStats::Out(ostream& os) const {
     os.setf(flags);
 }
 
+//! Print cache, MPC and book counters, e.g. "cache 1,234h/567m (68.5%), 89 MPC cuts, 0 book hits"
+void CNodeStats::OutCounters(ostream& os) const {
+    double nProbes=nCacheHits+nCacheMisses;
+
+    std::streamsize precision = os.precision();
+    auto flags = os.setf(ios::fixed, ios::floatfield);
+
+    os << "cache " << OutWithCommas(nCacheHits) << "h/" << OutWithCommas(nCacheMisses) << "m";
+    os << " (" << setprecision(1) << (nProbes?100*nCacheHits/nProbes:0) << "%), ";
+    os << OutWithCommas(nMPCCuts) << " MPC cuts, " << OutWithCommas(nBookHits) << " book hits";
+
+    os.precision(precision);
+    os.setf(flags);
+}
+
 void CNodeStats::OutShort(ostream& os) const {
     double nNodes=Nodes();
     double t=Seconds();
@@ -116,47 +188,289 @@ CNodeStats CNodeStats::operator-(const  CNodeStats& b) const {
     result.nINodes=nINodes-b.nINodes;
     result.nEvals=nEvals-b.nEvals;
     result.nSNodes=nSNodes-b.nSNodes;
-    result.nKFlips=nKFlips-b.nKFlips;
     result.nBBFlips=nBBFlips-b.nBBFlips;
+    result.nCacheHits=nCacheHits-b.nCacheHits;
+    result.nCacheMisses=nCacheMisses-b.nCacheMisses;
+    result.nMPCCuts=nMPCCuts-b.nMPCCuts;
+    result.nBookHits=nBookHits-b.nBookHits;
     result.time=time-b.time;
 
     return result;
 }
 double CNodeStats::Nodes() const {
-    return nKFlips+nBBFlips+nSNodes;
+    return nBBFlips+nSNodes;
 }
 
 double CNodeStats::Seconds() const {
     return time/(double)GetTicksPerSecond();
 }
 
+//////////////////////////////////////////////////////
+// Abort timer
+//
+// The search never looks at the clock. A watcher thread sleeps until the
+// deadline of each armed abort flag, or until SignalInput() wakes it, and then
+// sets the flag. The search pays only a relaxed load of the flag.
+//////////////////////////////////////////////////////
+
+//! Each thread has its own flag, so one engine's deadline doesn't stop another engine's search.
+thread_local std::atomic<bool> abortRound(false);
+
+//! If this flag is true, searches are aborted when the program has input.
+//! It is mostly on, but is turned off when book learning.
+std::atomic<bool> abortOnInput(true);
+
+class CAbortTimer {
+public:
+    CAbortTimer();
+
+    void Arm(std::atomic<bool>* pFlag, double seconds);
+    void Extend(std::atomic<bool>* pFlag, double seconds);
+    void Cancel(std::atomic<bool>* pFlag, bool fAborted);
+    void SignalInput();
+    void SignalInput(std::atomic<bool>* pFlag);
+    void Abort(std::atomic<bool>* pFlag);
+    void Link(std::atomic<bool>* pFlag, std::atomic<bool>* pLinked);
+    void Unlink(std::atomic<bool>* pLinked);
+
+private:
+    typedef std::chrono::steady_clock TClock;
+
+    //! An abort flag waiting for its deadline
+    struct CEntry {
+        std::atomic<bool>* pFlag;
+        TClock::time_point tBase, tDeadline;
+        bool fTimedOut;    //!< true if the flag was set because the deadline passed
+    };
+
+    void Run();
+    CEntry* Find(std::atomic<bool>* pFlag);
+    void Set(std::atomic<bool>* pFlag);
+    static TClock::time_point Deadline(TClock::time_point tBase, double seconds);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<CEntry> entries;
+    std::vector<std::pair<std::atomic<bool>*, std::atomic<bool>*> > links;    //!< (flag, flag set with it)
+};
+
+//! The abort timer. Never destroyed, so the watcher thread can't outlive its mutex at exit.
+static CAbortTimer& AbortTimer() {
+    static CAbortTimer* timer=new CAbortTimer;
+    return *timer;
+}
+
+CAbortTimer::CAbortTimer() {
+    std::thread(&CAbortTimer::Run, this).detach();
+}
+
+CAbortTimer::TClock::time_point CAbortTimer::Deadline(TClock::time_point tBase, double seconds) {
+    return tBase+std::chrono::duration_cast<TClock::duration>(std::chrono::duration<double>(seconds));
+}
+
+//! Find the entry for pFlag, or NULL if it isn't armed. The caller must hold the mutex.
+CAbortTimer::CEntry* CAbortTimer::Find(std::atomic<bool>* pFlag) {
+    for (CEntry& entry : entries) {
+        if (entry.pFlag==pFlag)
+            return &entry;
+    }
+    return NULL;
+}
+
+//! Set *pFlag and the flags linked to it. The caller must hold the mutex.
+void CAbortTimer::Set(std::atomic<bool>* pFlag) {
+    pFlag->store(true, std::memory_order_relaxed);
+    for (const auto& link : links) {
+        if (link.first==pFlag)
+            link.second->store(true, std::memory_order_relaxed);
+    }
+}
+
+//! Clear *pFlag and set it again in the given number of seconds
+void CAbortTimer::Arm(std::atomic<bool>* pFlag, double seconds) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        CEntry* pEntry=Find(pFlag);
+        if (!pEntry) {
+            entries.push_back(CEntry());
+            pEntry=&entries.back();
+            pEntry->pFlag=pFlag;
+        }
+        pEntry->tBase=TClock::now();
+        pEntry->tDeadline=Deadline(pEntry->tBase, seconds);
+        pEntry->fTimedOut=false;
+        pFlag->store(false, std::memory_order_relaxed);
+    }
+    cv.notify_one();
+}
+
+//! Move the deadline of *pFlag to the given number of seconds after it was armed.
+//!
+//! If the old deadline has already passed and the new one has not, the flag is cleared again.
+//! A flag set by input stays set.
+void CAbortTimer::Extend(std::atomic<bool>* pFlag, double seconds) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        CEntry* pEntry=Find(pFlag);
+        if (!pEntry)
+            return;
+        pEntry->tDeadline=Deadline(pEntry->tBase, seconds);
+        if (pEntry->fTimedOut && pEntry->tDeadline>TClock::now()) {
+            pEntry->fTimedOut=false;
+            pFlag->store(false, std::memory_order_relaxed);
+        }
+    }
+    cv.notify_one();
+}
+
+//! Stop watching *pFlag and leave it set to fAborted
+void CAbortTimer::Cancel(std::atomic<bool>* pFlag, bool fAborted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i=0; i<entries.size(); i++) {
+        if (entries[i].pFlag==pFlag) {
+            entries.erase(entries.begin()+i);
+            break;
+        }
+    }
+    pFlag->store(fAborted, std::memory_order_relaxed);
+}
+
+//! Set all armed flags if searches abort on input
+void CAbortTimer::SignalInput() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (abortOnInput) {
+        for (CEntry& entry : entries)
+            Set(entry.pFlag);
+    }
+}
+
+//! Set *pFlag, if it is armed, if searches abort on input
+void CAbortTimer::SignalInput(std::atomic<bool>* pFlag) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (abortOnInput && Find(pFlag))
+        Set(pFlag);
+}
+
+//! Set *pFlag, and the flags linked to it, now
+void CAbortTimer::Abort(std::atomic<bool>* pFlag) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Set(pFlag);
+}
+
+//! Set *pLinked whenever *pFlag is set from now on, and set or clear it now to match *pFlag
+void CAbortTimer::Link(std::atomic<bool>* pFlag, std::atomic<bool>* pLinked) {
+    std::lock_guard<std::mutex> lock(mutex);
+    links.push_back(std::make_pair(pFlag, pLinked));
+    pLinked->store(pFlag->load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+//! Stop setting *pLinked with the flag it was linked to
+void CAbortTimer::Unlink(std::atomic<bool>* pLinked) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i=0; i<links.size(); i++) {
+        if (links[i].second==pLinked) {
+            links.erase(links.begin()+i);
+            break;
+        }
+    }
+}
+
+//! Watcher thread's job: set flags as their deadlines pass
+void CAbortTimer::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        const TClock::time_point now=TClock::now();
+        bool fWaiting=false;
+        TClock::time_point tNext;
+
+        for (CEntry& entry : entries) {
+            if (entry.fTimedOut)
+                continue;
+            if (entry.tDeadline<=now) {
+                entry.fTimedOut=true;
+                Set(entry.pFlag);
+            }
+            else if (!fWaiting || entry.tDeadline<tNext) {
+                fWaiting=true;
+                tNext=entry.tDeadline;
+            }
+        }
+
+        if (fWaiting)
+            cv.wait_until(lock, tNext);
+        else
+            cv.wait(lock);
+    }
+}
+
+//! Clear abortRound and set it again after the given number of seconds, or earlier if there is input.
 void SetAbortTime(double seconds) {
+    extern bool HasInput();
+
     if (seconds <= 0)
     	seconds=.01;
 
     assert(seconds>0);
 
-    abortRound=false;
+    AbortTimer().Arm(&abortRound, seconds);
+    nAbortNodes=kNoNodeLimit;
 
-    qtAbortBase=double(GetTicks());
-    ResetAbortTime(seconds);
+    // input that arrived before the search started aborts it too
+    if (abortOnInput && HasInput())
+        abortRound=true;
 }
 
+//! Change the abort time to the given number of seconds after SetAbortTime() was called.
 void ResetAbortTime(double seconds) {
-    qtAbort=qtAbortBase+(double)GetTicksPerSecond()*seconds;
+    AbortTimer().Extend(&abortRound, seconds);
 }
 
-//! If this flag is true, searches are aborted when the program has input.
-//! It is mostly on, but is turned off when book learning.
-bool abortOnInput=true;
+//! End the timed search. abortRound is left at fAborted and no longer changes asynchronously.
+void CancelAbortTime(bool fAborted) {
+    AbortTimer().Cancel(&abortRound, fAborted);
+    nAbortNodes=kNoNodeLimit;
+}
+
+//! Node count at which this thread's search aborts, or kNoNodeLimit
+thread_local u64 nAbortNodes=kNoNodeLimit;
 
-//! return true if we should abort the search.
+//! Abort the current search once this thread has searched nNodes more nodes.
 //!
-//! This is true if we've used up our allocated time, or if HasInput() returns true.
-bool CheckAbort(bool fPrintAbort) {
-    extern bool HasInput();
-    abortRound = (GetTicks()>=qtAbort || (abortOnInput && HasInput()));
-    if (abortRound && fPrintAbort)
-    	cout << ">> Abort round!!!\n";
-    return abortRound;
+//! Call after SetAbortTime(), which clears the node limit.
+void SetAbortNodes(u64 nNodes) {
+    const CThreadCounters& counters=Counters();
+    nAbortNodes=counters.nBBFlips.load(std::memory_order_relaxed)+counters.nSNodes.load(std::memory_order_relaxed)+nNodes;
+}
+
+//! Abort the search whose abortRound is *pFlag, from any thread.
+//!
+//! Unlike storing to the flag directly, this also stops the threads helping that search; see LinkAbort().
+void SignalAbort(std::atomic<bool>* pFlag) {
+    AbortTimer().Abort(pFlag);
 }
+
+//! Make this thread's abortRound follow *pFlag, the abortRound of the search it is helping.
+//!
+//! abortRound is set to *pFlag's current value, and is set whenever the timer, input or SignalAbort() sets *pFlag,
+//! until UnlinkAbort().
+void LinkAbort(std::atomic<bool>* pFlag) {
+    AbortTimer().Link(pFlag, &abortRound);
+}
+
+void UnlinkAbort() {
+    AbortTimer().Unlink(&abortRound);
+}
+
+//! Called by the input thread when a line of input arrives
+void SignalInput() {
+    AbortTimer().SignalInput();
+}
+
+//! Called by the input thread of one engine when a line of input arrives for it.
+//!
+//! Only that engine's search, whose abortRound is *pFlag, is aborted.
+void SignalInput(std::atomic<bool>* pFlag) {
+    AbortTimer().SignalInput(pFlag);
+}
+
+thread_local std::ostream* pEngineOut=&std::cout;
@@ -12,21 +12,63 @@
 #ifndef _H_NODESTATS
 #define _H_NODESTATS
 
+#include <atomic>
 #include <iostream>
 #include "../n64/types.h"
 
-extern u4 nEvalsQuick, nSNodesQuick;
-extern double nEvals, nSNodes, nINodes, nKFlips, nBBFlips;
+//! Search counters belonging to a single thread.
+//!
+//! Only the owning thread writes to the block, so the counters are bumped with relaxed
+//! load/store pairs rather than locked adds. Blocks are padded to a cache line so that
+//! threads searching at the same time never share a line.
+//! CNodeStats::Read() sums the blocks of all threads.
+struct alignas(64) CThreadCounters {
+    std::atomic<u64> nEvals;        //!< static evaluations
+    std::atomic<u64> nINodes;       //!< interior nodes (calls to ValueTree)
+    std::atomic<u64> nSNodes;       //!< endgame solver nodes
+    std::atomic<u64> nBBFlips;      //!< moves made by the midgame search
+    std::atomic<u64> nCacheHits;    //!< cache probes that found the position
+    std::atomic<u64> nCacheMisses;  //!< cache probes that did not find the position
+    std::atomic<u64> nMPCCuts;      //!< subtrees forward-pruned by MPC
+    std::atomic<u64> nBookHits;     //!< book loads that returned a value
+    std::atomic<u64> nHelperNodes;  //!< nodes searched by other threads to help this thread's search; not in the totals
+    CThreadCounters* next;          //!< next block in the list of all blocks
+};
+
+extern thread_local CThreadCounters* pThreadCounters;
+CThreadCounters* AcquireThreadCounters();
+
+//! Counter block for the current thread, acquiring one on first use.
+inline CThreadCounters& Counters() {
+    CThreadCounters* p=pThreadCounters;
+    return p ? *p : *AcquireThreadCounters();
+}
+
+//! Add n to a counter owned by the current thread.
+inline void Count(std::atomic<u64>& counter, u64 n=1) {
+    counter.store(counter.load(std::memory_order_relaxed)+n, std::memory_order_relaxed);
+}
+
+//! Nodes (nBBFlips+nSNodes) searched by this thread, plus those searched by the threads helping its searches.
+//!
+//! Unlike CNodeStats::Read() this doesn't count other searches running in the process.
+inline u64 SearchNodes() {
+    const CThreadCounters& counters=Counters();
+    return counters.nBBFlips.load(std::memory_order_relaxed)+counters.nSNodes.load(std::memory_order_relaxed)
+        +counters.nHelperNodes.load(std::memory_order_relaxed);
+}
 
 class CNodeStats {
 public:
-    double nINodes, nSNodes, nKFlips, nBBFlips, nEvals;
+    double nINodes, nSNodes, nBBFlips, nEvals;
+    double nCacheHits, nCacheMisses, nMPCCuts, nBookHits;
 
     i8 time;
 
     void Read();
     void Out(std::ostream& os) const;
     void OutShort(std::ostream& os) const;
+    void OutCounters(std::ostream& os) const;
 
     CNodeStats operator-(const CNodeStats& b) const;
     double Seconds() const;
@@ -36,12 +78,46 @@ public:
 inline std::ostream& operator<<(std::ostream& os, const CNodeStats& ns) { ns.Out(os); return os; }
 
 // thinking on opponent's time
-extern bool abortRound;
-extern bool abortOnInput;
+extern thread_local std::atomic<bool> abortRound;
+extern std::atomic<bool> abortOnInput;
+
+//! true if the current search should stop.
+//!
+//! abortRound belongs to the searching thread but is set asynchronously by the abort timer thread, so this is a relaxed load
+//! and cheap enough to test anywhere in the search.
+inline bool Aborted() {
+    return abortRound.load(std::memory_order_relaxed);
+}
 
-void WipeNodeStats();
 void SetAbortTime(double seconds);
 void ResetAbortTime(double seconds);
-bool CheckAbort(bool fPrintAbort);
+void CancelAbortTime(bool fAborted);
+void SignalInput();
+void SignalInput(std::atomic<bool>* pFlag);
+void SignalAbort(std::atomic<bool>* pFlag);
+void LinkAbort(std::atomic<bool>* pFlag);
+void UnlinkAbort();
+
+//! Where this thread's engine writes its output: std::cout, or a client's connection
+//! when several engines run in one process.
+extern thread_local std::ostream* pEngineOut;
+inline std::ostream& EngineOut() { return *pEngineOut; }
+
+// node-limited searches
+const u64 kNoNodeLimit=~u64(0);
+extern thread_local u64 nAbortNodes;
+void SetAbortNodes(u64 nNodes);
+
+//! Set abortRound if this thread has searched past the limit given to SetAbortNodes().
+//!
+//! The limit is on the thread's own nodes (nBBFlips+nSNodes), so a node-limited search
+//! stops at the same point every time it is run.
+inline void CheckAbortNodes() {
+    if (nAbortNodes!=kNoNodeLimit) {
+        const CThreadCounters& counters=Counters();
+        if (counters.nBBFlips.load(std::memory_order_relaxed)+counters.nSNodes.load(std::memory_order_relaxed)>=nAbortNodes)
+            abortRound.store(true, std::memory_order_relaxed);
+    }
+}
 
-#endif // _H_NODESTATS
\ No newline at end of file
+#endif // _H_NODESTATS
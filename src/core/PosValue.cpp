@@ -0,0 +1,41 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+#include <cstring>
+
+#include "PosValue.h"
+
+// file header: magic number and version
+static const char sMagic[4]={'N','T','P','V'};
+static const u4 kVersion=1;
+
+bool CPosValue::Read(FILE* fp) {
+    return bb.Read(fp)
+    	&& fread(&value, sizeof(value), 1, fp)
+    	&& fread(&pass, sizeof(pass), 1, fp)
+    	&& fread(&square, sizeof(square), 1, fp);
+}
+
+bool CPosValue::Write(FILE* fp) const {
+    return bb.Write(fp)
+    	&& fwrite(&value, sizeof(value), 1, fp)
+    	&& fwrite(&pass, sizeof(pass), 1, fp)
+    	&& fwrite(&square, sizeof(square), 1, fp);
+}
+
+//! \return true if fp starts with a header for this version of the file format
+bool CPosValue::ReadHeader(FILE* fp) {
+    char magic[4];
+    u4 version;
+    return fread(magic, sizeof(magic), 1, fp)
+    	&& fread(&version, sizeof(version), 1, fp)
+    	&& memcmp(magic, sMagic, sizeof(magic))==0
+    	&& version==kVersion;
+}
+
+bool CPosValue::WriteHeader(FILE* fp) {
+    return fwrite(sMagic, sizeof(sMagic), 1, fp)
+    	&& fwrite(&kVersion, sizeof(kVersion), 1, fp);
+}
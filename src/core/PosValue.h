@@ -0,0 +1,33 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CPosValue class
+//////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdio>
+#include "BitBoard.h"
+
+//! A position with its searched value and best move, as stored in position value files.
+//!
+//! A file is a header followed by fixed-size records. Since every record has the same size,
+//! the number of complete records tells how far an interrupted run got.
+class CPosValue {
+public:
+    CBitBoard bb;           //!< the position; the mover is treated as black
+    CValueCompact value;    //!< value to the mover in bb
+    u1 pass;                //!< 0 if the mover has a move, 1 if the mover must pass, 2 if the game is over
+    i1 square;              //!< best move for the side that moves after any pass, or -1 if the game is over
+
+    enum { kHeaderSize=8, kRecordSize=20 };
+
+    bool Read(FILE* fp);
+    bool Write(FILE* fp) const;
+
+    static bool ReadHeader(FILE* fp);
+    static bool WriteHeader(FILE* fp);
+};
@@ -41,10 +41,11 @@ public:
 	//! These tell what kind of search to do
 	//! \{
 
-	//! Flags for NeedXxx() functions
+	//! Flags for NeedXxx() functions.
+	//! Some callers pass TPrint flags in fNeeds too, so flags added here take bits above every TPrint flag.
 	enum TNeed {
 		kNeedValue=1, kNeedMove=2, kNeedMPCStats=4, kNeedDeviations=8,
-		kNeedRandSearch=0x10, kNeedNoAddSoloUnsolvedToBook=0x20 };
+		kNeedRandSearch=0x10, kNeedNoAddSoloUnsolvedToBook=0x20, kNeedProfile=0x200, kNeedReadOnlyBook=0x400 };
 
 	//! Always calculate a value, even for a forced move
 	u4 NeedValue() const { return m_fNeeds & kNeedValue; };	
@@ -58,6 +59,11 @@ public:
 	u4 NeedRandSearch() const { return m_fNeeds & kNeedRandSearch; };
 	//! Do not add unsolved positions to book unless multiple best moves were calculated at full height
 	u4 NeedNoAddSoloUnsolvedToBook() const { return m_fNeeds & kNeedNoAddSoloUnsolvedToBook; };
+	//! Collect a CSearchProfile of the search and print it when done.
+	//! If the caller has already installed a profile with CProfileScope, the search adds to that one instead.
+	u4 NeedProfile() const { return m_fNeeds & kNeedProfile; };
+	//! Read values from the book but never store search results in it, so other threads can share the book
+	u4 NeedReadOnlyBook() const { return m_fNeeds & kNeedReadOnlyBook; };
 	//!\}
 
 
@@ -66,6 +72,7 @@ public:
 	int vContempt;
 	double tRemaining;
 	int iCache;
+	int nRootThreads;		//!< number of threads searching root moves at once when more than one move is valued
 private:
 	u4 m_fNeeds;		//!< flags that determine how to search
 	u4 m_fPrintLevel;	//!< print flags for book and search
@@ -81,5 +88,6 @@ inline CSearchInfo::CSearchInfo(int aiPruneMidgame, int aiPruneEndgame, int ars,
 	m_fNeeds=fNeeds;
 	tRemaining=atRemaining;
 	iCache=aiCache;
+	nRootThreads=1;
 }
 
@@ -0,0 +1,117 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CSearchProfile class
+//////////////////////////////////////////////////////
+
+#include <cstring>
+#include <iomanip>
+#include "SearchProfile.h"
+
+using namespace std;
+
+thread_local CSearchProfile* pSearchProfile=0;
+
+CSearchProfile::CSearchProfile() {
+    Clear();
+}
+
+void CSearchProfile::Clear() {
+    memset(cells, 0, sizeof(cells));
+    memset(mpc, 0, sizeof(mpc));
+    memset(aspiration, 0, sizeof(aspiration));
+}
+
+//! Add each u64 counter in table b to the one in the same place in table a
+template<class TTable> static void AddCounters(TTable& a, const TTable& b) {
+    u64* p=reinterpret_cast<u64*>(&a);
+    u64* const pEnd=reinterpret_cast<u64*>(reinterpret_cast<char*>(&a)+sizeof(a));
+    for (const u64* pb=reinterpret_cast<const u64*>(&b); p<pEnd; p++, pb++)
+        *p+=*pb;
+}
+
+//! Add the counters of another profile, e.g. one collected by a thread helping this profile's search
+void CSearchProfile::Add(const CSearchProfile& b) {
+    AddCounters(cells, b.cells);
+    AddCounters(mpc, b.mpc);
+    AddCounters(aspiration, b.aspiration);
+}
+
+static double Percent(u64 n, u64 nTotal) {
+    return nTotal ? 100.0*n/nTotal : 0;
+}
+
+//! Print the profile as tab-separated tables, one row per height and nEmpty (or iPrune) that was reached.
+//!
+//! Each table starts with a "profile <name>" line and a header line, and ends with a blank line.
+//! In the nodes table cut% is the percentage of nodes that cut off and cut@n is the percentage
+//! of those cutoffs that came from the n'th move searched. In the aspiration table faillow% and failhigh% are
+//! re-searches per 100 root searches, so they can pass 100 if a search fails more than once.
+void CSearchProfile::Report(ostream& os) const {
+    const std::streamsize precision=os.precision(1);
+    const ios_base::fmtflags flags=os.setf(ios::fixed, ios::floatfield);
+    int height, nEmpty, iPrune, i;
+
+    os << "profile nodes\n";
+    os << "height\tnEmpty\tnodes\tcut%";
+    for (i=1; i<kCutBuckets; i++)
+        os << "\tcut@" << i;
+    os << "\tcut@" << kCutBuckets << "+\tnullwin\tresearch%\tetc\tstable\n";
+    for (height=0; height<kMaxHeight; height++) {
+        for (nEmpty=0; nEmpty<kMaxEmpty; nEmpty++) {
+            const CCell& cell=cells[height][nEmpty];
+            if (!cell.nNodes)
+                continue;
+            u64 nCutoffs=0;
+            for (i=0; i<kCutBuckets; i++)
+                nCutoffs+=cell.nCutoffs[i];
+            os << height << '\t' << nEmpty << '\t' << cell.nNodes << '\t' << Percent(nCutoffs, cell.nNodes);
+            for (i=0; i<kCutBuckets; i++)
+                os << '\t' << Percent(cell.nCutoffs[i], nCutoffs);
+            os << '\t' << cell.nNullWindow << '\t' << Percent(cell.nResearch, cell.nNullWindow);
+            os << '\t' << cell.nEtcHits << '\t' << cell.nStabilityCuts << '\n';
+        }
+    }
+    os << "\n";
+
+    os << "profile mpc\n";
+    os << "height\tiPrune\tchecks\tprobes\treused\tcuts\tcut%\n";
+    for (height=0; height<kMaxHeight; height++) {
+        for (iPrune=0; iPrune<kMaxPrune; iPrune++) {
+            const CMPCCell& cell=mpc[height][iPrune];
+            if (cell.nChecks)
+                os << height << '\t' << iPrune << '\t' << cell.nChecks << '\t' << cell.nProbes << '\t' << cell.nReused
+                   << '\t' << cell.nCuts << '\t' << Percent(cell.nCuts, cell.nChecks) << '\n';
+        }
+    }
+    os << "\n";
+
+    os << "profile aspiration\n";
+    os << "height\tsearches\tfaillow%\tfailhigh%\n";
+    for (height=0; height<kMaxHeight; height++) {
+        const CAspirationCell& cell=aspiration[height];
+        if (cell.nSearches)
+            os << height << '\t' << cell.nSearches << '\t' << Percent(cell.nFailLows, cell.nSearches) << '\t' << Percent(cell.nFailHighs, cell.nSearches) << '\n';
+    }
+    os << "\n";
+
+    os << "profile cache\n";
+    os << "height\tnEmpty\tprobes\thit%\tcutoff%\tupdates\tstores\treplaces\trejects\n";
+    for (height=0; height<kMaxHeight; height++) {
+        for (nEmpty=0; nEmpty<kMaxEmpty; nEmpty++) {
+            const CCell& cell=cells[height][nEmpty];
+            if (!cell.nCacheProbes && !cell.nCacheUpdates && !cell.nCacheStores && !cell.nCacheReplaces && !cell.nCacheRejects)
+                continue;
+            os << height << '\t' << nEmpty << '\t' << cell.nCacheProbes << '\t' << Percent(cell.nCacheHits, cell.nCacheProbes);
+            os << '\t' << Percent(cell.nCacheCutoffs, cell.nCacheProbes) << '\t' << cell.nCacheUpdates << '\t' << cell.nCacheStores;
+            os << '\t' << cell.nCacheReplaces << '\t' << cell.nCacheRejects << '\n';
+        }
+    }
+    os << "\n";
+
+    os.precision(precision);
+    os.flags(flags);
+}
@@ -0,0 +1,104 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CSearchProfile class
+//////////////////////////////////////////////////////
+
+#pragma once
+
+#include <iostream>
+#include "../n64/types.h"
+
+//! Statistics on the shape of a search tree, used to tune move ordering and MPC.
+//!
+//! Profiling is off unless a profile is installed for the thread with CProfileScope.
+//! Each hook in the search then costs a thread-local load and a branch:
+//!
+//!    if (CSearchProfile* pProfile=pSearchProfile) pProfile->Cell(height, nEmpty).nEtcHits++;
+//!
+//! Node counters are kept by search height and number of empties, MPC counters by
+//! height and iPrune, and aspiration window counters by the height of the root search.
+class CSearchProfile {
+public:
+    enum { kMaxHeight=64, kMaxEmpty=64, kMaxPrune=8, kCutBuckets=8 };
+
+    //! Counters for nodes searched to one height with one number of empties
+    struct CCell {
+        u64 nNodes;                 //!< calls to ValueTree
+        u64 nCutoffs[kCutBuckets];  //!< beta cutoffs by the position of the cutting move; the last bucket holds all later moves
+        u64 nNullWindow;            //!< negascout null-window searches of a child
+        u64 nResearch;              //!< null-window searches that had to be repeated with the full window
+        u64 nEtcHits;               //!< children sorted first because the cache shows they cut off (ETC)
+        u64 nStabilityCuts;         //!< moves skipped by the stability bound in ValueMove
+        u64 nCacheProbes;           //!< lookups in ValueCacheOrTree
+        u64 nCacheHits;             //!< lookups that found the position
+        u64 nCacheCutoffs;          //!< lookups whose stored bounds answered the search
+        u64 nCacheUpdates;          //!< stores into the position's existing entry
+        u64 nCacheStores;           //!< stores into an empty or stale entry
+        u64 nCacheReplaces;         //!< stores that evicted a different, still current, position
+        u64 nCacheRejects;          //!< stores dropped because both entries were more important
+    };
+
+    //! Counters for MPC checks at one height and iPrune
+    struct CMPCCell {
+        u64 nChecks;    //!< cut heights tried
+        u64 nProbes;    //!< alpha or beta tests decided by a shallow search
+        u64 nReused;    //!< alpha or beta tests decided by the bounds from earlier shallow searches of the node
+        u64 nCuts;      //!< cut heights that pruned the node
+    };
+
+    //! Counters for aspiration-window root searches to one height
+    struct CAspirationCell {
+        u64 nSearches;  //!< root searches started with an aspiration window
+        u64 nFailLows;  //!< re-searches because the values fell below the window
+        u64 nFailHighs; //!< re-searches because the values rose above the window
+    };
+
+    CSearchProfile();
+
+    void Clear();
+    void Add(const CSearchProfile& b);
+    CCell& Cell(int height, int nEmpty);
+    CMPCCell& MPC(int height, int iPrune);
+    CAspirationCell& Aspiration(int height);
+    void Report(std::ostream& os) const;
+
+private:
+    CCell cells[kMaxHeight][kMaxEmpty];
+    CMPCCell mpc[kMaxHeight][kMaxPrune];
+    CAspirationCell aspiration[kMaxHeight];
+};
+
+//! Height and nEmpty are clamped so that a hook can never write outside the tables
+inline CSearchProfile::CCell& CSearchProfile::Cell(int height, int nEmpty) {
+    return cells[height<0?0:height<kMaxHeight?height:kMaxHeight-1][nEmpty<0?0:nEmpty<kMaxEmpty?nEmpty:kMaxEmpty-1];
+}
+
+inline CSearchProfile::CMPCCell& CSearchProfile::MPC(int height, int iPrune) {
+    return mpc[height<0?0:height<kMaxHeight?height:kMaxHeight-1][iPrune<0?0:iPrune<kMaxPrune?iPrune:kMaxPrune-1];
+}
+
+inline CSearchProfile::CAspirationCell& CSearchProfile::Aspiration(int height) {
+    return aspiration[height<0?0:height<kMaxHeight?height:kMaxHeight-1];
+}
+
+inline std::ostream& operator<<(std::ostream& os, const CSearchProfile& profile) { profile.Report(os); return os; }
+
+//! Profile collecting statistics for the current thread, or NULL if profiling is off
+extern thread_local CSearchProfile* pSearchProfile;
+
+//! Collect statistics in a profile for the current thread while this object exists
+class CProfileScope {
+public:
+    explicit CProfileScope(CSearchProfile* pProfile) : pPrevious(pSearchProfile) { pSearchProfile=pProfile; }
+    ~CProfileScope() { pSearchProfile=pPrevious; }
+
+private:
+    CSearchProfile* pPrevious;
+
+    CProfileScope(const CProfileScope&);
+    CProfileScope& operator=(const CProfileScope&);
+};
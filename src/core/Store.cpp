@@ -11,8 +11,8 @@ FileIo::FileIo(const std::string& path, bool forReading)  : m_path(path) {
 	const char* mode = forReading ? "rb" : "wb";
 	fp = fopen(path.c_str(), mode);
 	if (fp==NULL) {
-		fprintf(stderr, "Unable to open file %s\n", path.c_str());
-		exit(1);
+		const int err = errno;
+		throw IOException(std::string("Unable to open file ") + path + ' ' + strerror(err), path, err);
 	}
 }
 
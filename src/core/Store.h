@@ -72,6 +72,7 @@ protected:
 public:
 	const std::string m_path;
 
+  //! \throw IOException if the file can't be opened
   FileIo(const std::string& path, bool forReading);
   FileIo(FILE* fpt): fp(fpt) {}
 	size_t write(const void* data, size_t size, size_t count) {
@@ -21,4 +21,16 @@ void TestStore() {
 	nr = reader->read(buffer, 2, 1);
 	assertEquals(1, nr);
 	assertStringEquals("ob", buffer);
+
+	// a missing file is reported to the caller, which may carry on without it
+	File missing("no such directory/missing.book");
+	bool fThrown = false;
+	try {
+		missing.getReader();
+	}
+	catch (IOException& e) {
+		fThrown = true;
+		assertTrue(e.IsFileNotFound());
+	}
+	assertTrue(fThrown);
 }
@@ -6,12 +6,58 @@
 //////////////////////////////////////////////////////
 // portable time measuring functions
 // code added by Richard Delorme
+//
+// All clocks here are monotonic: they measure elapsed wall time and never
+// jump when the system time is changed.
 //////////////////////////////////////////////////////
 
 
 #include "Ticks.h"
 
-#if defined(_WIN32)
+#if defined(NTEST_TSC_TICKS)
+
+//////////////////////////////////////////////////////
+// Ticks from the processor's time stamp counter.
+//
+// Reading the TSC is cheaper than any system call, but it is only a usable
+// clock on processors with an invariant TSC (constant rate, synchronized
+// across cores), which is every x86-64 processor of the last decade or so.
+// The rate is calibrated against the system's monotonic clock on first use.
+//////////////////////////////////////////////////////
+
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+i8 GetTicks(void) {
+    return (i8)__rdtsc();
+}
+
+//! Count TSC ticks over about 50ms of the monotonic clock
+static i8 CalibrateTicksPerSecond() {
+    typedef std::chrono::steady_clock TClock;
+
+    const TClock::time_point tStart=TClock::now();
+    const i8 ticksStart=GetTicks();
+    TClock::time_point tEnd;
+    do {
+        tEnd=TClock::now();
+    } while (tEnd-tStart<std::chrono::milliseconds(50));
+    const i8 ticksEnd=GetTicks();
+
+    const double seconds=std::chrono::duration<double>(tEnd-tStart).count();
+    return (i8)((ticksEnd-ticksStart)/seconds);
+}
+
+i8 GetTicksPerSecond(void) {
+    static const i8 ticksPerSecond=CalibrateTicksPerSecond();
+    return ticksPerSecond;
+}
+
+#elif defined(_WIN32)
 #include <windows.h>
 
 i8 GetTicks(void) {
@@ -28,19 +74,20 @@ i8 GetTicksPerSecond(void) {
 
 #else
 
-#include <sys/time.h>
-#include <sys/resource.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <time.h>
 
 i8 GetTicks(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (i8) 1000000 * tv.tv_sec + tv.tv_usec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (i8) 1000000000 * ts.tv_sec + ts.tv_nsec;
 }
 
 i8 GetTicksPerSecond(void) {
-    return (i8) 1000000;
+    return (i8) 1000000000;
 }
 
 #endif // _WIN32
+
+double SecondsSince(i8 ticksStart) {
+    return (GetTicks()-ticksStart)/(double)GetTicksPerSecond();
+}
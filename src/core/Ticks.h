@@ -11,4 +11,7 @@
 i8 GetTicks();
 i8 GetTicksPerSecond();
 
+//! Seconds of wall time since GetTicks() returned ticksStart
+double SecondsSince(i8 ticksStart);
+
 #endif
@@ -0,0 +1,217 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CTimeModel class
+//////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "CalcParams.h"
+#include "TimeModel.h"
+
+using namespace std;
+
+CTimeModel timeModel;
+
+// older samples are forgotten at the rate of an average over this many samples
+static const double kMaxSamples=32;
+// branching factors aren't used until they have been seen this often
+static const double kMinSamples=2;
+// rounds smaller than this are mostly cache hits and say little about the next round
+static const double kMinNodes=1000;
+// rounds shorter than this are dominated by timer resolution
+static const double kMinSeconds=0.01;
+
+void CTimeModel::CEstimate::Add(double x) {
+    if (n<kMaxSamples)
+        n++;
+    mean+=(log(x)-mean)/n;
+}
+
+CTimeModel::CTimeModel() : fDirty(false) {
+}
+
+//! Keeps measurements taken since the last Save(), e.g. by searches that weren't part of a game
+CTimeModel::~CTimeModel() {
+    Save();
+}
+
+CTimeModel::TBfKey CTimeModel::BfKey(int nEmpty, int height, int iPrune, bool fWLD) {
+    return TBfKey(make_pair(nEmpty, height), make_pair(iPrune, fWLD?1:0));
+}
+
+//! Record a completed iterative deepening round.
+//!
+//! \param hi height of the round
+//! \param nNodesLast nodes searched by the previous round, or 0 if this is the first round
+//! \param nNodes nodes searched by this round
+//! \param t seconds taken by this round
+void CTimeModel::AddRound(const CHeightInfo& hi, int nEmpty, double nNodesLast, double nNodes, double t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (t>=kMinSeconds && nNodes>=kMinNodes) {
+        nps[TNpsKey(nEmpty, hi.iPrune)].Add(nNodes/t);
+        npsAll.Add(nNodes/t);
+        fDirty=true;
+    }
+    if (nNodesLast>=kMinNodes && nNodes>0) {
+        bfs[BfKey(nEmpty, hi.height, hi.iPrune, hi.fWLD)].Add(nNodes/nNodesLast);
+        fDirty=true;
+    }
+}
+
+//! Measured branching factor for a round, from this number of empties or the nearest one measured.
+//!
+//! Probable solves from nearby empties are searched to a correspondingly different height.
+//! \return false if no nearby round of this kind has been measured
+bool CTimeModel::BranchingFactor(const CHeightInfo& hi, int nEmpty, double& bf) const {
+    const int deltas[]={0, 1, -1, 2, -2};
+    for (int delta : deltas) {
+        const int height=hi.IsKnownProbableSolve()?hi.height+delta:hi.height;
+        auto it=bfs.find(BfKey(nEmpty+delta, height, hi.iPrune, hi.fWLD));
+        if (it!=bfs.end() && it->second.n>=kMinSamples) {
+            bf=exp(it->second.mean);
+            return true;
+        }
+    }
+    return false;
+}
+
+double CTimeModel::NPS(int nEmpty, int iPrune) const {
+    auto it=nps.find(TNpsKey(nEmpty, iPrune));
+    if (it!=nps.end())
+        return exp(it->second.mean);
+    if (npsAll.n)
+        return exp(npsAll.mean);
+    return dNPS*dGHz;
+}
+
+//! Predict the time a round will take.
+//!
+//! \param hi height of the round
+//! \param nNodesLast nodes searched by the previous round
+//! \param tElapsed seconds spent on the search so far
+//! \return predicted seconds. If this kind of round hasn't been measured, tElapsed: the
+//!    rule of thumb that each round takes about as long as all the rounds before it.
+double CTimeModel::PredictRound(const CHeightInfo& hi, int nEmpty, double nNodesLast, double tElapsed) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    double bf;
+    if (nNodesLast<kMinNodes || !BranchingFactor(hi, nEmpty, bf))
+        return tElapsed;
+    return nNodesLast*bf/NPS(nEmpty, hi.iPrune);
+}
+
+//! Typical nodes per second on this machine, over all positions measured
+double CTimeModel::NPS() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return npsAll.n?exp(npsAll.mean):dNPS*dGHz;
+}
+
+//! Machine speed in the units of dGHz, for code that scales a time by processor speed
+double CTimeModel::GHz() const {
+    return NPS()/dNPS;
+}
+
+//! Read the model from a file, and save it there from now on.
+//!
+//! If the file doesn't exist the model starts empty: measurements taken before this, by the startup
+//! self-test, are of test searches and are neither kept nor saved.
+void CTimeModel::Load(const string& afn) {
+    ifstream is(afn.c_str());
+    if (is)
+        Read(is);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!is) {
+        nps.clear();
+        bfs.clear();
+        npsAll=CEstimate();
+        fDirty=false;
+    }
+    fn=afn;
+}
+
+//! Write the model to its file if it has changed since it was last written.
+//!
+//! Called at the end of each game and when the program exits.
+//! Does nothing if Load() hasn't been called.
+void CTimeModel::Save() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fn.empty() || !fDirty)
+        return;
+
+    // write a new file and rename it, so an interrupted write doesn't lose the model.
+    // The temporary file is this process's own, so processes saving at the same time don't write into each other's.
+    ostringstream osTemp;
+    osTemp << fn << "." << getpid() << ".tmp";
+    const string fnTemp=osTemp.str();
+    {
+        ofstream os(fnTemp.c_str());
+        WriteLocked(os);
+        if (!os) {
+            cerr << "WARNING: can't write time model " << fnTemp << "\n";
+            return;
+        }
+    }
+    if (rename(fnTemp.c_str(), fn.c_str())!=0)
+        cerr << "WARNING: can't write time model " << fn << "\n";
+    else
+        fDirty=false;
+}
+
+//! Read a model written by Write(), replacing the current model.
+//!
+//! Lines that can't be parsed are skipped; the model is only a cache of measurements.
+void CTimeModel::Read(istream& is) {
+    std::lock_guard<std::mutex> lock(mutex);
+    nps.clear();
+    bfs.clear();
+    npsAll=CEstimate();
+
+    string sLine, sType;
+    while (getline(is, sLine)) {
+        istringstream isLine(sLine);
+        if (!(isLine >> sType))
+            continue;
+        int nEmpty, height, iPrune, fWLD;
+        CEstimate estimate;
+        if (sType=="speed") {
+            if (isLine >> estimate.n >> estimate.mean)
+                npsAll=estimate;
+        }
+        else if (sType=="nps") {
+            if (isLine >> nEmpty >> iPrune >> estimate.n >> estimate.mean)
+                nps[TNpsKey(nEmpty, iPrune)]=estimate;
+        }
+        else if (sType=="bf") {
+            if (isLine >> nEmpty >> height >> iPrune >> fWLD >> estimate.n >> estimate.mean)
+                bfs[BfKey(nEmpty, height, iPrune, fWLD!=0)]=estimate;
+        }
+    }
+    fDirty=false;
+}
+
+void CTimeModel::Write(ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    WriteLocked(os);
+}
+
+void CTimeModel::WriteLocked(ostream& os) const {
+    os << "# ntest time model\n";
+    os.precision(10);
+    os << "speed " << npsAll.n << " " << npsAll.mean << "\n";
+    for (const auto& it : nps)
+        os << "nps " << it.first.first << " " << it.first.second << " " << it.second.n << " " << it.second.mean << "\n";
+    for (const auto& it : bfs)
+        os << "bf " << it.first.first.first << " " << it.first.first.second << " " << it.first.second.first << " "
+           << it.first.second.second << " " << it.second.n << " " << it.second.mean << "\n";
+}
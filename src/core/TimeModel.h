@@ -0,0 +1,71 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//////////////////////////////////////////////////////
+// CTimeModel class
+//////////////////////////////////////////////////////
+
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include "HeightInfo.h"
+
+//! Measured search speed of this machine, used to predict how long an iterative deepening round takes.
+//!
+//! The engine records every completed round: its nodes per second by number of empties and iPrune, and
+//! its branching factor, the ratio of its node count to the previous round's, by number of empties and
+//! the round's height, iPrune and fWLD. The cost of the next round is predicted as
+//!
+//!    nodes in the last round * branching factor / NPS
+//!
+//! Estimates are averages of logs with a bounded sample count, so they follow the machine if it changes.
+//! Until a position type has been measured the model falls back on dGHz from parameters.txt.
+//!
+//! The model is shared by all search threads; the methods lock.
+class CTimeModel {
+public:
+    CTimeModel();
+    ~CTimeModel();
+
+    void AddRound(const CHeightInfo& hi, int nEmpty, double nNodesLast, double nNodes, double t);
+    double PredictRound(const CHeightInfo& hi, int nEmpty, double nNodesLast, double tElapsed) const;
+    double NPS() const;
+    double GHz() const;
+
+    void Load(const std::string& fn);
+    void Save();
+    void Read(std::istream& is);
+    void Write(std::ostream& os) const;
+
+private:
+    //! Running average of the log of a measurement
+    struct CEstimate {
+        double n;       //!< number of samples, up to kMaxSamples
+        double mean;    //!< average of log(measurement)
+
+        CEstimate() : n(0), mean(0) {}
+        void Add(double x);
+    };
+
+    typedef std::pair<int, int> TNpsKey;                               //!< (nEmpty, iPrune)
+    typedef std::pair<std::pair<int, int>, std::pair<int, int> > TBfKey; //!< ((nEmpty, height), (iPrune, fWLD))
+
+    static TBfKey BfKey(int nEmpty, int height, int iPrune, bool fWLD);
+    bool BranchingFactor(const CHeightInfo& hi, int nEmpty, double& bf) const;
+    double NPS(int nEmpty, int iPrune) const;
+    void WriteLocked(std::ostream& os) const;
+
+    std::map<TNpsKey, CEstimate> nps;
+    std::map<TBfKey, CEstimate> bfs;
+    CEstimate npsAll;
+    std::string fn;
+    bool fDirty;
+    mutable std::mutex mutex;
+};
+
+extern CTimeModel timeModel;
@@ -0,0 +1,42 @@
+#include <sstream>
+#include "../n64/test.h"
+#include "TimeModel.h"
+
+void TestTimeModel() {
+	CTimeModel model;
+	const int nEmpty=30;
+	const CHeightInfo hi(8, 4, false, nEmpty);
+
+	// unmeasured rounds are predicted to take as long as the search so far
+	assertEquals(1.5f, float(model.PredictRound(hi, nEmpty, 20000, 1.5)), 1e-6f);
+
+	// rounds triple the node count at 1M nodes per second
+	model.AddRound(hi, nEmpty, 10000, 30000, 0.03);
+	assertEquals(1.5f, float(model.PredictRound(hi, nEmpty, 20000, 1.5)), 1e-6f);
+	model.AddRound(hi, nEmpty, 10000, 30000, 0.03);
+	assertEquals(0.06f, float(model.PredictRound(hi, nEmpty, 20000, 1.5)), 1e-6f);
+	assertEquals(1e6f, float(model.NPS()), 1.0f);
+
+	// a nearby number of empties is used when this one hasn't been measured
+	const CHeightInfo hiNear(8, 4, false, nEmpty+1);
+	assertEquals(0.06f, float(model.PredictRound(hiNear, nEmpty+1, 20000, 1.5)), 1e-6f);
+
+	// the model survives a round trip through its file format
+	std::ostringstream os;
+	model.Write(os);
+	CTimeModel model2;
+	std::istringstream is(os.str());
+	model2.Read(is);
+	assertEquals(0.06f, float(model2.PredictRound(hi, nEmpty, 20000, 1.5)), 1e-6f);
+	std::ostringstream os2;
+	model2.Write(os2);
+	TEST(os.str()==os2.str());
+
+	// with no file to load, measurements taken before loading are dropped and not saved
+	model.Load("no such directory/timemodel.txt");
+	assertEquals(1.5f, float(model.PredictRound(hi, nEmpty, 20000, 1.5)), 1e-6f);
+	std::ostringstream os3, osEmpty;
+	model.Write(os3);
+	CTimeModel().Write(osEmpty);
+	TEST(os3.str()==osEmpty.str());
+}
@@ -16,4 +16,7 @@ inline void testCore() {
 
 	void TestStore();
 	TestStore();
+
+	void TestTimeModel();
+	TestTimeModel();
 }
@@ -36,7 +36,7 @@ public:
 
     enum {
     	kMyMove=1, kNoPrint=2, kAllowCheats=4, kGame2=8,
-    	kAnalyze=0x10, kNoAddSoloUnsolvedToBook=0x20,
+    	kAnalyze=0x10, kNoAddSoloUnsolvedToBook=0x20, kReadOnlyBook=0x40,
     };
 
 protected:
@@ -37,6 +37,7 @@ void EndgameSearch::init(u64 mover, u64 enemy) {
 	constructEmpties(mover, enemy);
 	hashTable.clear();
 	useHash = true;
+	pruner = 0;
 }
 
 void EndgameSearch::validate() {
@@ -25,12 +25,15 @@ struct Empty {
 };
 
 
+class SolvePruner;
+
 class EndgameSearch {
 public:
 	Empty start;
 	Empty emptyArray[32];
 	HashTable hashTable;
 	bool useHash;
+	SolvePruner* pruner;	// forward pruning, or NULL for an exact solve
 
 public:
 	void init(u64 mover, u64 enemy);
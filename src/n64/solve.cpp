@@ -1,7 +1,7 @@
 #include "stdafx.h"
 #include "search.h"
 
-u4 nSNodesQuick = 0;
+thread_local u4 nSNodesQuick = 0;
 
 #define NODE nSNodesQuick++
 
@@ -403,6 +403,14 @@ int solveHashMobility(int alpha, int beta, u64 mover, u64 enemy, u64 parity, End
 		}
 	}
 
+	// selective search: skip nodes the pruner expects to be outside the window
+	if (search->pruner && bitCountInt(~(mover|enemy)) >= search->pruner->minEmpty) {
+		int value;
+		if (search->pruner->prune(alpha, beta, mover, enemy, value)) {
+			return value;
+		}
+	}
+
 	int score = solveMobility(alpha, beta, mover, enemy, parity, search);
 
 	if (score == -OTH_INFINITY) {
@@ -435,9 +443,10 @@ int solveN(int alpha, int beta, u64 mover, u64 enemy, EndgameSearch* search, boo
 	return solveHashMobility(alpha, beta, mover, enemy, parity, search, hasPassed);
 }
 
-int solveNValue(int alpha, int beta, u64 mover, u64 enemy) {
+int solveNValue(int alpha, int beta, u64 mover, u64 enemy, SolvePruner* pruner) {
 	EndgameSearch search;
 	search.init(mover, enemy);
+	search.pruner = pruner;
 	int resultN = solveN(alpha, beta, mover, enemy, &search, false);
 	return resultN;
 }
@@ -1,12 +1,40 @@
+#pragma once
+
 #include "types.h"
 #include "endgameSearch.h"
 
-int solveNValue(int alpha, int beta, u64 mover, u64 enemy);
+/**
+* Forward pruning for a selective ("probable") solve.
+*
+* The solver asks prune() about each node with at least minEmpty empties before searching it.
+* The solver knows nothing of evaluation, so the caller decides; typically with a shallow
+* midgame search, as in multi-probcut.
+*/
+class SolvePruner {
+public:
+	explicit SolvePruner(int minEmpty) : minEmpty(minEmpty) {}
+	virtual ~SolvePruner() {}
+
+	/**
+	* @param value [out] if the node is pruned, the value the search returns for it
+	* @return true if the node is pruned
+	*/
+	virtual bool prune(int alpha, int beta, u64 mover, u64 enemy, int& value) = 0;
+
+	const int minEmpty;
+};
+
+/**
+* Value of the position, searched with window (alpha, beta).
+*
+* @param pruner forward pruning for a selective solve, or NULL for an exact solve
+*/
+int solveNValue(int alpha, int beta, u64 mover, u64 enemy, SolvePruner* pruner = 0);
 
 // testing
 bool resultOk(int alpha, int beta, int expected , int actual);
 
 // debugging and information
-extern u4 nSNodesQuick;
+extern thread_local u4 nSNodesQuick;
 void initCutoffs();
 void dumpCutoffs();
@@ -287,6 +287,43 @@ void generateSolverTestPositions(int depth) {
 	}
 }
 
+/**
+* Pruner for testing: counts the nodes it is asked about and prunes none of them, or all of them
+*/
+class TestPruner : public SolvePruner {
+public:
+	TestPruner(int minEmpty, bool pruneAll) : SolvePruner(minEmpty), pruneAll(pruneAll), nCalls(0) {}
+
+	bool prune(int alpha, int, u64 mover, u64 enemy, int& value) {
+		assertTrue(bitCountInt(~(mover|enemy)) >= minEmpty);
+		nCalls++;
+		value = alpha;
+		return pruneAll;
+	}
+
+	const bool pruneAll;
+	int nCalls;
+};
+
+static void testSolvePruner() {
+	const SolveTest test = getSolverTests(12, true).at(86);
+
+	// a pruner that doesn't prune doesn't change the result
+	TestPruner none(10, false);
+	assertEquals(test.solveResult(-64, 64), solveNValue(-64, 64, test.mover, test.enemy, &none));
+	assertTrue(none.nCalls > 0);
+
+	// the pruner isn't asked about nodes with fewer empties than its minimum
+	TestPruner deep(13, false);
+	solveNValue(-64, 64, test.mover, test.enemy, &deep);
+	assertEquals(0, deep.nCalls);
+
+	// a pruned root returns the pruner's value
+	TestPruner all(10, true);
+	assertEquals(-5, solveNValue(-5, 7, test.mover, test.enemy, &all));
+	assertEquals(1, all.nCalls);
+}
+
 static void testResultOk() {
 	assertTrue(resultOk(-1, 1, -12, -2));
 }
@@ -300,5 +337,6 @@ void testSolve() {
 	testSolveN();
 	testResultOk();
 	testSolveJcw(12);
+	testSolvePruner();
 	testOrderMoves();
 }
@@ -123,7 +123,7 @@ u64 rand64() {
     return r64(0) ^ r64(15) ^ r64(30) ^ r64(45) ^ r64(60);
 }
 
-u64 mobility(u64 mover, u64 enemy) {
+static inline u64 koggeStoneMobility(u64 mover, u64 enemy) {
     const u64 middle = ~(MaskA|MaskH);
 
     u64 mobility = 0;
@@ -203,6 +203,21 @@ u64 mobility(u64 mover, u64 enemy) {
     return mobility&~(mover | enemy);
 }
 
+u64 mobility(u64 mover, u64 enemy) {
+    return koggeStoneMobility(mover, enemy);
+}
+
+/**
+* mobility() for n positions at once.
+*
+* The loop has no branches, so the compiler can compute several positions per SIMD instruction.
+*/
+void mobilities(const u64* mover, const u64* enemy, u64* moves, int n) {
+    for (int i=0; i<n; i++) {
+        moves[i] = koggeStoneMobility(mover[i], enemy[i]);
+    }
+}
+
 /**
 * flips where mover is to the right of enemy
 * @param enemy enemy bits, must be pre-masked to middle rows if n is not 8
@@ -171,6 +171,7 @@ std::string eng(double d, int precision);
 
 u64 rand64();
 u64 mobility(u64 mover, u64 enemy);
+void mobilities(const u64* mover, const u64* enemy, u64* moves, int n);
 u64 koggeStoneFlips(int sq, u64 mover, u64 enemy);
 
 
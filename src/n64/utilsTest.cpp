@@ -87,6 +87,17 @@ static void testMobility() {
 		checkMobility(i, mover, enemy);
 		checkMobility(i, enemy, mover);
 	}
+
+	// batched mobility, including a partial SIMD block at the end
+	u64 movers[101], enemies[101], moves[101];
+	for (int i=0; i<101; i++) {
+		enemies[i] = rand64();
+		movers[i] = rand64()&~enemies[i];
+	}
+	mobilities(movers, enemies, moves, 101);
+	for (int i=0; i<101; i++) {
+		assertHexEquals(mobility(movers[i], enemies[i]), moves[i]);
+	}
 }
 
 static void timeMobility(const u64 n) {
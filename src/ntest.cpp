@@ -14,14 +14,20 @@
 #include <windows.h>
 #endif
 
+#include <algorithm>
 #include <ctime>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
 #include <ctype.h>
 #include <sstream>
 #include <iomanip>
+#include <fstream>
+#include <functional>
 #include <string>
+#include <thread>
+#include "n64/flips.h"
 #include "n64/n64.h"
 #include "n64/test.h"
 #include "core/QPosition.h"
@@ -29,25 +35,30 @@
 #include "core/Cache.h"
 #include "core/CalcParams.h"
 #include "core/MPCStats.h"
+#include "core/TimeModel.h"
 #include "pattern/FastFlip.h"
 #include "game/Player.h"
 #include "game/PlayerHuman.h"
 #include "game/Game.h"
+#include "odk/GgfReader.h"
 
 #include "SmartBook.h"
 #include "options.h"
 #include "GameX.h"
+#include "EngineServer.h"
 #include "Evaluator.h"
 #include "EvalTest.h"
 #include "SpeedTest.h"
-#include "TreeDebug.h"
 #include "Pos2.h"
 #include "Search.h"
 #include "NtestStream.h"
 #include "MPCCalc.h"
+#include "SelfPlay.h"
+#include "ParallelAnalysis.h"
 
 #include "Pos2Test.h"
 #include "SearchTest.h"
+#include "SelfPlayTest.h"
 #include "core/coreTest.h"
 #include "odk/odkTest.h"
 
@@ -119,6 +130,7 @@ void Init() {
     setbuf(stdout, 0);
     srand(static_cast<unsigned int>(RANDSEED));
 
+    initFlips();
     InitFastFlip();
     InitConfigToPotMob();
     cout << setprecision(3);
@@ -192,16 +204,14 @@ void Test() {
     TestPos2();
     TestIsOpeningOf();
     TestSearch();
+    TestMatchStats();
     GoldenValueEvalTest();
+    CoeffFitEvalTest();
     std::cerr << "Ending standard test\n";
 }
 
-//! Have the computer analyze the game except if it's a rand game, or
-//! there's a forced opening and this game doesn't use it
-void MaybeAnalyzeGame(CPlayerComputer& comp1, const COsGame& game) {
-    static u4 nGamesAdded=0, nGamesSkipped=0, nGamesAnalyzed=0;
-
-    std::cout << "So far: " << nGamesAdded << " added to book, " << nGamesAnalyzed << " analyzed, " << nGamesSkipped << " skipped\n";
+//! true unless it's a rand game, or there's a forced opening and this game doesn't use it
+bool ShouldAnalyzeGame(const COsGame& game) {
     bool fOk=!game.mt.fRand;
     if (fOk && !fnOpening.empty()) {
     	std::ifstream is(fnOpening.c_str());
@@ -209,7 +219,16 @@ void MaybeAnalyzeGame(CPlayerComputer& comp1, const COsGame& game) {
     	gOpening.In(is);
     	fOk=IsOpeningOf(gOpening, game);
     }
-    if (fOk) {
+    return fOk;
+}
+
+//! Have the computer analyze the game except if it's a rand game, or
+//! there's a forced opening and this game doesn't use it
+void MaybeAnalyzeGame(CPlayerComputer& comp1, const COsGame& game) {
+    static u4 nGamesAdded=0, nGamesSkipped=0, nGamesAnalyzed=0;
+
+    std::cout << "So far: " << nGamesAdded << " added to book, " << nGamesAnalyzed << " analyzed, " << nGamesSkipped << " skipped\n";
+    if (ShouldAnalyzeGame(game)) {
     	nGamesAdded+=comp1.AnalyzeGame(game);
     	nGamesAnalyzed++;
     }
@@ -219,47 +238,35 @@ void MaybeAnalyzeGame(CPlayerComputer& comp1, const COsGame& game) {
     }
 }
 
-////////////////////////////////////////////////////////////
-// Series of games
-////////////////////////////////////////////////////////////
-
-void Compare(CPlayerComputer& computer1, CPlayerComputer& computer2) {
-    CBitBoard bb;
-    FILE* fp;
-    int nWins, nDraws, nLosses;
-    int i, nNet;
-
-    nWins=nDraws=nLosses=0;
-
-    fp=fopen("CompareStart.pos","rb");
-    assert(fp);
-    if (fp) {
-    	while (fread(&bb,sizeof(bb),1,fp)) {
-    		char sBoardText[NN+1];
-    		bb.GetSBoard(sBoardText, true);
-    		for (i=0; i<2; i++) {
-    			// clear caches
-    			computer1.Clear();
-    			computer2.Clear();
-
-    			CGame game(i?&computer2:&computer1, i?&computer1:&computer2, tMatch, fnOpening);
-    			game.Initialize(sBoardText, true);
-
-    			nNet=game.Play();
-    			if (i)
-    				nNet=-nNet;
-    			if (nNet>0)
-    				nWins++;
-    			else if (nNet<0)
-    				nLosses++;
-    			else
-    				nDraws++;
-    			cout << nNet << (i?'\n':'\t');
-    		}
+//! Read games from cin and call analyze() on each one.
+//!
+//! GGF input redirected from a file is mapped into memory and decoded on nThreads threads.
+//!
+//! \param format 'g' for GGF, 'i' for IOS or 'l' for logbook format
+//! \return false if the format is unknown
+bool ReadGames(char format, const std::function<void(const COsGame&)>& analyze, int nThreads=1) {
+    COsGame game;
+    switch(format) {
+    case 'g': {
+    	CMappedFile file;
+    	if (file.Open(fileno(stdin))) {
+    		CGgfParser().ForEach(file.Text(), analyze, nThreads);
+    		return true;
     	}
-    	fclose(fp);
-
-    	cout << "computer1 has Wins: " << nWins << "  Draws: " << nDraws << "  Losses: " << nLosses << "\n";
+    	while (cin >> game)
+    		analyze(game);
+    	return true;
+    }
+    case 'i':
+    	while (game.InIOS(cin))
+    		analyze(game);
+    	return true;
+    case 'l':
+    	while (game.InLogbook(cin))
+    		analyze(game);
+    	return true;
+    default:
+    	return false;
     }
 }
 
@@ -378,21 +385,18 @@ int main(int argc, char**argv, char**envp) {
     			cd2.sCalcParams=cd1.sCalcParams;
     			cd1.booklevel=cd2.booklevel=CComputerDefaults::kNoBook;
 
-    			CPlayerComputer computer1(cd1);
-    			CPlayerComputer  computer2(cd2);
-    			Compare(computer1, computer2);
+    			Compare(cd1, cd2, atoi(submode), fnOpening);
     			break;
     					  }
     		case kCalcMPC: {
     			cd1.booklevel=CComputerDefaults::kNoBook;
-    			CPlayerComputer computer1(cd1);
-    			CalcMPCStats(&computer1, cd1.MinutesOrDepth());
+    			CalcMPCStats(cd1, cd1.MinutesOrDepth(), atoi(submode));
     			break;
     					   }
     		case kPosValues: {
     			cd1.booklevel=CComputerDefaults::kNoBook;
-    			CPlayerComputer computer1(cd1);
-    			CalcPosValues(&computer1, submode[0]=='a');
+    			const bool fAppend=submode[0]=='a';
+    			CalcPosValues(cd1, fAppend, atoi(submode+fAppend));
     			break;
     						 }
     		case kEdmundBook: {
@@ -442,6 +446,7 @@ int main(int argc, char**argv, char**envp) {
     			{
     				ifstream is((fnBaseDir+"password.txt").c_str());
     				std::string sPassword;
+    				cd1.fPonder=true;
     				CPlayerComputer computer1(cd1);
     				CNtestStream gs;
     				is >> sPassword >> gs.sSuperuser;
@@ -462,38 +467,34 @@ int main(int argc, char**argv, char**envp) {
     			}
     			break;
     		case kAnalyze:
-    			{
-    			CPlayerComputer computer1(cd1);
-    			if (computer1.book==NULL) {
-    				cerr << "ERR: You need a book to use Analyze mode\n";
-    			}
-    			else {
-    				PrintStuff(true);
-
-    				computer1.fAnalyzingDeferred=true;
-
-    				COsGame game;
-    				switch(submode[0]) {
-    				case 'g':
-    					while (cin >> game)
-    						MaybeAnalyzeGame(computer1,game);
-    					break;
-    				case 'i':
-    					while (game.InIOS(cin))
-    						MaybeAnalyzeGame(computer1,game);
-    					break;
-    				case 'l':
-    					while (game.InLogbook(cin))
-    						MaybeAnalyzeGame(computer1,game);
-    					break;
-    				default:
+    			if (submode[0] && submode[1]=='p') {
+    				// annotate games on several threads, with the book read-only
+    				PrintStuff(false);
+    				std::ofstream os("Analyzed.ggf");
+    				CParallelAnalysis analysis(cd1, atoi(submode+2), os);
+    				if (!ReadGames(submode[0], [&](const COsGame& game) { if (ShouldAnalyzeGame(game)) analysis.Add(game); }, analysis.NThreads())) {
     					cout << "Unknown file type '" << submode << "' for analyze mode\n";
     					cerr << "Unknown file type '" << submode << "' for analyze mode\n";
     				}
+    				analysis.Finish();
+    			}
+    			else {
+    				CPlayerComputer computer1(cd1);
+    				if (computer1.book==NULL) {
+    					cerr << "ERR: You need a book to use Analyze mode\n";
+    				}
+    				else {
+    					PrintStuff(true);
 
+    					computer1.fAnalyzingDeferred=true;
+
+    					if (!ReadGames(submode[0], [&](const COsGame& game) { MaybeAnalyzeGame(computer1, game); })) {
+    						cout << "Unknown file type '" << submode << "' for analyze mode\n";
+    						cerr << "Unknown file type '" << submode << "' for analyze mode\n";
+    					}
+    				}
     			}
     			break;
-    			}
     		case kGetStartPos: {
     			/*
     			FILE* fp=fopen("CompareStart.pos","wb");
@@ -529,7 +530,17 @@ int main(int argc, char**argv, char**envp) {
     			break;	// it's done when creating computer1
     						  }
     		case kExternalViewer: {
-    			CGameX gamex(cd1);
+    			// x<port> serves many viewers over sockets; plain x talks to one viewer on stdin/stdout
+    			const int nPort=atoi(submode);
+    			if (nPort) {
+    				CEngineServer server(cd1);
+    				server.Run(nPort);
+    			}
+    			else {
+    				// a single viewer waits for hints on every move, so spread its root moves over all cores
+    				cd1.nRootThreads=std::max(1, int(std::thread::hardware_concurrency()));
+    				CGameX gamex(cd1);
+    			}
     			break;
     							  }
     		default:
@@ -628,7 +639,7 @@ void ReadMachineParameters(istream& isBig) {
 
     // read the following parameters:
     //	int maxCacheMem - size in bytes available for cache (in file in MB,converted here to bytes)
-    //	double dGHz - Approx processor speed
+    //	double dGHz - Approx processor speed, used until the time model has measured this machine
 
     //	first set default values in case we can't read for some reason
     maxCacheMem=10;
@@ -650,6 +661,7 @@ void ReadParameters(CComputerDefaults& cd1, CComputerDefaults& cd2, CDrawTreeLim
     }
     
     ReadMachineParameters(isParams);
+    timeModel.Load(fnBaseDir+"timemodel.txt");
     isParams >> cd1 >> cd2;
     while (1) {
     	std::string sLine;
@@ -669,8 +681,19 @@ void ReadParameters(CComputerDefaults& cd1, CComputerDefaults& cd2, CDrawTreeLim
     				cd1.iEdmund=cd2.iEdmund=iEdmund;
     		}
     	}
+    	else if (sParamName=="Profile") {
+    		bool fProfile;
+    		if (is>>fProfile)
+    			cd1.fProfile=cd2.fProfile=fProfile;
+    	}
     	else if (sParamName=="DrawTreeLimit") {
     		is >> drawTreeLimits.drawCutoff >> drawTreeLimits.deviationCutoff;
     	}
+    	else if (sParamName=="SelectiveSolve") {
+    		is >> nEmptySelectiveSolve;
+    	}
+    	else if (sParamName=="PNSearch") {
+    		is >> nEmptyPNSearch >> nPNSearchMargin >> dPNSearchNodes >> nPNSearchMB;
+    	}
     }
 }
@@ -0,0 +1,419 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Bulk reading of GGF game files
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "types.h"
+#include "GgfReader.h"
+
+using namespace std;
+
+bool CStringView::operator==(const char* s) const {
+    return strlen(s)==n && memcmp(s, p, n)==0;
+}
+
+//////////////////////////////////////
+// CMappedFile
+//////////////////////////////////////
+
+CMappedFile::CMappedFile() : pMap(NULL), nMap(0), pText(NULL), nText(0) {
+}
+
+CMappedFile::~CMappedFile() {
+    Close();
+}
+
+void CMappedFile::Close() {
+#ifndef _WIN32
+    if (pMap)
+    	munmap(pMap, nMap);
+#endif
+    pMap=NULL;
+    nMap=0;
+    pText=NULL;
+    nText=0;
+    buffer.clear();
+}
+
+//! Map the file. \return false if it can't be opened
+bool CMappedFile::Open(const string& fn) {
+    Close();
+#ifdef _WIN32
+    FILE* fp=fopen(fn.c_str(), "rb");
+    if (!fp)
+    	return false;
+    char block[65536];
+    size_t n;
+    while ((n=fread(block, 1, sizeof(block), fp))>0)
+    	buffer.insert(buffer.end(), block, block+n);
+    fclose(fp);
+    pText=buffer.empty() ? NULL : &buffer[0];
+    nText=buffer.size();
+    return true;
+#else
+    const int fd=open(fn.c_str(), O_RDONLY);
+    if (fd<0)
+    	return false;
+    const bool fOK=Open(fd);
+    close(fd);
+    return fOK;
+#endif
+}
+
+//! Map the rest of an open file, from its current position to the end.
+//!
+//! \return false if fd is not a regular file (for instance a pipe), since those can't be mapped.
+//! The caller keeps ownership of fd.
+bool CMappedFile::Open(int fd) {
+    Close();
+#ifdef _WIN32
+    return false;
+#else
+    struct stat st;
+    if (fstat(fd, &st)!=0 || !S_ISREG(st.st_mode))
+    	return false;
+    off_t offset=lseek(fd, 0, SEEK_CUR);
+    if (offset<0)
+    	offset=0;
+    if (st.st_size<=offset)
+    	return true;
+
+    nMap=size_t(st.st_size);
+    pMap=mmap(NULL, nMap, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pMap==MAP_FAILED) {
+    	pMap=NULL;
+    	nMap=0;
+    	return false;
+    }
+    madvise(pMap, nMap, MADV_SEQUENTIAL);
+    pText=(const char*)pMap+offset;
+    nText=nMap-size_t(offset);
+    return true;
+#endif
+}
+
+//////////////////////////////////////
+// CGgfParser
+//////////////////////////////////////
+
+//! \param fields the tags to decode, a combination of TField flags. Moves can't be
+//! replayed without the start position, so kMoves also decodes the board.
+CGgfParser::CGgfParser(int afields) : fields(afields), nChunkSize(1<<22) {
+    if (fields&kMoves)
+    	fields|=kBoard;
+}
+
+static const char* SkipSpace(const char* p, const char* pEnd) {
+    while (p<pEnd && isspace((unsigned char)*p))
+    	p++;
+    return p;
+}
+
+//! Start of the next game at or after p, or pEnd if there is none
+static const char* FindGame(const char* p, const char* pEnd) {
+    for (; p+1<pEnd; p++) {
+    	if (p[0]=='(' && p[1]==';')
+    		return p;
+    }
+    return pEnd;
+}
+
+//! Start of the first game that begins at or after p, as long as p is not inside a game's tags.
+//!
+//! Used to split the buffer; a chunk boundary must fall between games, so skip to the end
+//! of the game that contains p first.
+static const char* FindChunkStart(const char* p, const char* pEnd) {
+    for (; p+1<pEnd; p++) {
+    	if (p[0]==';' && p[1]==')')
+    		return FindGame(p+2, pEnd);
+    }
+    return pEnd;
+}
+
+//! Parse a number as strtod() does, stopping at pEnd. Leaves value unchanged if there is no number.
+static const char* ParseDouble(const char* p, const char* pEnd, double& value) {
+    char s[64];
+    const size_t n=min(size_t(pEnd-p), sizeof(s)-1);
+    memcpy(s, p, n);
+    s[n]=0;
+    char* pNumberEnd;
+    const double d=strtod(s, &pNumberEnd);
+    if (pNumberEnd!=s)
+    	value=d;
+    return p+(pNumberEnd-s);
+}
+
+//! Same as COsMoveListItem::In()
+static void ParseMoveListItem(CStringView data, COsMoveListItem& mli) {
+    const char* p=SkipSpace(data.begin(), data.end());
+    const char* const pEnd=data.end();
+
+    mli.dEval=0;
+    mli.tElapsed=0;
+    if (p==pEnd)
+    	return;
+    const char cCol=char(toupper(*p++));
+    mli.mv.fPass= cCol=='P';
+    if (!mli.mv.fPass) {
+    	mli.mv.col=cCol-'A';
+    	int row=0;
+    	while (p<pEnd && isdigit((unsigned char)*p))
+    		row=row*10+(*p++-'0');
+    	mli.mv.row=row-1;
+    }
+    while (p<pEnd && isalnum((unsigned char)*p))
+    	p++;
+
+    if (p<pEnd && *p=='/') {
+    	p=ParseDouble(p+1, pEnd, mli.dEval);
+    	if (p<pEnd && *p=='/')
+    		ParseDouble(p+1, pEnd, mli.tElapsed);
+    }
+}
+
+//! Same as COsBoard::In()
+static void ParseBoard(CStringView data, COsBoard& board) {
+    const char* p=SkipSpace(data.begin(), data.end());
+    const char* const pEnd=data.end();
+
+    board.Clear();
+    COsBoardType bt;
+    bt.Clear();
+    while (p<pEnd && isdigit((unsigned char)*p))
+    	bt.n=bt.n*10+(*p++-'0');
+    board.Initialize(bt);
+
+    const int nsq=bt.NTotalSquares();
+    for (int i=0; i<nsq; i++) {
+    	while (i<nsq && board.sBoard[i]==COsBoard::DUMMY)
+    		i++;
+    	if (i==nsq)
+    		break;
+    	p=SkipSpace(p, pEnd);
+    	assert(p<pEnd);
+    	if (p<pEnd)
+    		board.sBoard[i]=*p++;
+    }
+
+    p=SkipSpace(p, pEnd);
+    board.fBlackMove= p==pEnd || *p==COsBoard::BLACK;
+}
+
+//! Same as COsResult::In(), without the stream for the usual numeric result
+static void ParseResult(CStringView data, COsResult& result) {
+    const char* p=SkipSpace(data.begin(), data.end());
+    const char* const pEnd=data.end();
+
+    if (p<pEnd && (isdigit((unsigned char)*p) || *p=='-' || *p=='+' || *p=='.')) {
+    	result.dResult=0;
+    	p=ParseDouble(p, pEnd, result.dResult);
+    	result.status=COsResult::kNormalEnd;
+    	if (p+1<pEnd && *p==':') {
+    		switch(p[1]) {
+    		case 'r': result.status=COsResult::kResigned; break;
+    		case 't': result.status=COsResult::kTimeout; break;
+    		case 'l': result.status=COsResult::kAdjourned; break;
+    		default: assert(0);
+    		}
+    	}
+    }
+    else {
+    	istringstream is(data.str());
+    	is >> result;
+    }
+}
+
+void CGgfParser::ParseTag(CStringView tag, CStringView data, COsGame& game, double& dKomiValue) const {
+    // the common tags are decoded without creating a stream
+    if (tag=="B" || tag=="W") {
+    	if (fields&kMoves) {
+    		COsMoveListItem mli;
+    		ParseMoveListItem(data, mli);
+    		game.ml.Update(mli);
+    	}
+    	return;
+    }
+    if (tag=="BO") {
+    	if (fields&kBoard)
+    		ParseBoard(data, game.posStart.board);
+    	return;
+    }
+    if (tag=="RE") {
+    	if (fields&kResult)
+    		ParseResult(data, game.result);
+    	return;
+    }
+    if (tag=="PB" || tag=="PW") {
+    	if (fields&kPlayers)
+    		game.pis[tag=="PB"].sName=data.str();
+    	return;
+    }
+    if (tag=="RB" || tag=="RW") {
+    	if (fields&kPlayers)
+    		ParseDouble(data.begin(), data.end(), game.pis[tag=="RB"].dRating);
+    	return;
+    }
+    if (tag=="PC") {
+    	if (fields&kPlace)
+    		game.sPlace=data.str();
+    	return;
+    }
+    if (tag=="DT") {
+    	if (fields&kDateTime)
+    		game.sDateTime=data.str();
+    	return;
+    }
+
+    // the rest occur at most once or twice per game
+    istringstream is(data.str());
+    if (tag=="TI" || tag=="TB" || tag=="TW") {
+    	if (fields&kClocks) {
+    		if (tag=="TI") {
+    			is >> game.posStart.cks[0];
+    			game.posStart.cks[1]=game.posStart.cks[0];
+    		}
+    		else
+    			is >> game.posStart.cks[tag=="TB"];
+    	}
+    }
+    else if (tag=="TY") {
+    	if (fields&kType)
+    		is >> game.mt;
+    }
+    else if (tag=="KB" || tag=="KW") {
+    	if (fields&kKomi)
+    		is >> game.mlisKomi[tag=="KB"];
+    }
+    else if (tag=="KM") {
+    	if (fields&kKomi)
+    		is >> dKomiValue;
+    }
+    else {
+    	// GM and CO are ignored. COsGame::In() asserts on unknown tags, but a bulk
+    	// reader is better off skipping them.
+    }
+}
+
+//! Parse the game starting at p, which points at its "(;". On return p points past the game.
+bool CGgfParser::ParseGame(const char*& p, const char* pEnd, COsGame& game) const {
+    game.Clear();
+    if (fields&kMoves)
+    	game.ml.reserve(64);
+    double dKomiValue=0;
+    bool fCheckKomiValue=false;
+
+    p+=2;
+    for (;;) {
+    	p=SkipSpace(p, pEnd);
+    	if (p==pEnd)
+    		return false;
+    	if (*p==';')
+    		break;
+
+    	const char* pTag=p;
+    	const char* pOpen=(const char*)memchr(p, '[', pEnd-p);
+    	if (!pOpen)
+    		return false;
+    	const char* pClose=(const char*)memchr(pOpen, ']', pEnd-pOpen);
+    	if (!pClose)
+    		return false;
+    	p=pClose+1;
+
+    	const CStringView tag(pTag, pOpen);
+    	fCheckKomiValue|= tag=="KM" && (fields&kKomi);
+    	ParseTag(tag, CStringView(pOpen+1, pClose), game, dKomiValue);
+    }
+    p++;
+    p=SkipSpace(p, pEnd);
+    assert(p<pEnd && *p==')');
+    if (p<pEnd)
+    	p++;
+
+    if (fCheckKomiValue) {
+    	const double dErr = 2*dKomiValue - game.mlisKomi[0].dEval - game.mlisKomi[1].dEval;
+    	assert(0.0001 > dErr && dErr > -0.0001);
+    	(void)dErr;
+    }
+    if (fields&kBoard)
+    	game.pos.Calculate(game);
+    return true;
+}
+
+//! Parse the next game that starts at or after p and before pEnd.
+//!
+//! \return false if there are no more games. On return p points past the game.
+bool CGgfParser::Next(const char*& p, const char* pEnd, COsGame& game) const {
+    p=FindGame(p, pEnd);
+    return p<pEnd && ParseGame(p, pEnd, game);
+}
+
+//! Parse all games in text and call fn with each, in order.
+//!
+//! If nThreads>1, chunks of the text are decoded on separate threads.
+void CGgfParser::ForEach(CStringView text, const function<void(const COsGame&)>& fn, int nThreads) const {
+    const char* p=text.begin();
+    const char* const pEnd=text.end();
+
+    if (nThreads<=1) {
+    	COsGame game;
+    	while (Next(p, pEnd, game))
+    		fn(game);
+    	return;
+    }
+
+    vector<const char*> starts(nThreads+1);
+    vector<vector<COsGame> > chunks(nThreads);
+    vector<thread> threads;
+    while (p<pEnd) {
+    	// Chunk i holds the games that start in [starts[i], starts[i+1]); its last game may
+    	// run past starts[i+1] only if a boundary was placed inside it, which FindChunkStart prevents.
+    	starts[0]=p;
+    	for (int i=1; i<=nThreads; i++) {
+    		const size_t nLeft=pEnd-starts[i-1];
+    		starts[i]=nLeft<=nChunkSize ? pEnd : FindChunkStart(starts[i-1]+nChunkSize, pEnd);
+    	}
+
+    	for (int i=0; i<nThreads; i++) {
+    		threads.emplace_back([this, i, pEnd, &starts, &chunks]() {
+    			const char* q=starts[i];
+    			COsGame game;
+    			while ((q=FindGame(q, starts[i+1]))<starts[i+1] && ParseGame(q, pEnd, game))
+    				chunks[i].push_back(game);
+    		});
+    	}
+    	for (thread& t : threads)
+    		t.join();
+    	threads.clear();
+
+    	for (vector<COsGame>& chunk : chunks) {
+    		for (const COsGame& game : chunk)
+    			fn(game);
+    		chunk.clear();
+    	}
+    	p=starts[nThreads];
+    }
+}
+
+//! Parse all games in text
+vector<COsGame> CGgfParser::ReadAll(CStringView text, int nThreads) const {
+    vector<COsGame> games;
+    ForEach(text, [&games](const COsGame& game) { games.push_back(game); }, nThreads);
+    return games;
+}
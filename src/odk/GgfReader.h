@@ -0,0 +1,92 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Bulk reading of GGF game files
+
+#ifndef ODK_GGFREADER_H
+#define ODK_GGFREADER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "OsObjects.h"
+
+//! A range of characters inside a buffer owned by someone else
+class CStringView {
+public:
+    CStringView() : p(NULL), n(0) {}
+    CStringView(const char* ap, size_t an) : p(ap), n(an) {}
+    CStringView(const char* pBegin, const char* pEnd) : p(pBegin), n(pEnd-pBegin) {}
+
+    const char* begin() const { return p; }
+    const char* end() const { return p+n; }
+    size_t size() const { return n; }
+    bool empty() const { return n==0; }
+    std::string str() const { return std::string(p, n); }
+
+    bool operator==(const char* s) const;
+
+private:
+    const char* p;
+    size_t n;
+};
+
+//! A file mapped read-only into memory.
+//!
+//! On systems without mmap the file is read into memory instead.
+class CMappedFile {
+public:
+    CMappedFile();
+    ~CMappedFile();
+
+    bool Open(const std::string& fn);
+    bool Open(int fd);
+    void Close();
+
+    CStringView Text() const { return CStringView(pText, nText); }
+
+private:
+    CMappedFile(const CMappedFile&);
+    void operator=(const CMappedFile&);
+
+    void* pMap;
+    size_t nMap;
+    const char* pText;
+    size_t nText;
+    std::vector<char> buffer;
+};
+
+//! Parses GGF games directly from a buffer.
+//!
+//! Only the requested tags are decoded; the others are skipped without being copied.
+//! Parsing with all fields gives the same game as COsGame::In().
+//!
+//! Games can be decoded on several threads: the buffer is split into chunks at game
+//! starts ("(;") and the games are handed back in file order.
+class CGgfParser {
+public:
+    enum TField {
+    	kPlace=1, kDateTime=2, kPlayers=4, kClocks=8, kType=0x10, kKomi=0x20,
+    	kBoard=0x40, kMoves=0x80, kResult=0x100, kAll=0x1FF
+    };
+
+    explicit CGgfParser(int fields=kAll);
+    void SetChunkSize(size_t nChunkSize) { this->nChunkSize=nChunkSize; }
+
+    bool Next(const char*& p, const char* pEnd, COsGame& game) const;
+    void ForEach(CStringView text, const std::function<void(const COsGame&)>& fn, int nThreads=1) const;
+    std::vector<COsGame> ReadAll(CStringView text, int nThreads=1) const;
+
+private:
+    bool ParseGame(const char*& p, const char* pEnd, COsGame& game) const;
+    void ParseTag(CStringView tag, CStringView data, COsGame& game, double& dKomiValue) const;
+
+    int fields;
+    size_t nChunkSize;  //!< bytes decoded by one thread at a time
+};
+
+#endif // ODK_GGFREADER_H
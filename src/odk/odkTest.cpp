@@ -1,4 +1,5 @@
 #include "OsObjects.h"
+#include "GgfReader.h"
 #include <sstream>
 #include <cstring>
 #include "../n64/test.h"
@@ -46,8 +47,59 @@ void testOsGameResult() {
     assertTrue(strstr(out.str().c_str(), "RE[-2]")!=NULL);
 }
 
+static std::string GameText(const COsGame& game) {
+    std::ostringstream out;
+    out << game;
+    return out.str();
+}
+
+void testGgfParser() {
+    const char* sGames[] = {
+        "(;GM[Othello]PC[GGS/os]DT[2003.12.15_12:33:18.MST]PB[Saio1200]PW[Saio3000]RE[0]RB[2196.37]RW[2200.35]TI[5:00//2:00]TY[8]BO[8 --O--O--*-*OO---****OO-**O*O*OOO**O***O****O*O*---**O*----****-- O];)",
+        "(;GM[Othello]PC[Local]DT[2013-12-23 16:43:43 GMT]PB[s33]PW[s30]RE[2]TI[0//2:00]TY[0]BO[8 ---------------------------O*------*O--------------------------- *]B[F5/-1.04/0.01]W[D6//0.01]B[C3/-1.14/0.01]W[D3//0.01]B[C4/-1.14/0.01]W[F4//0.01]B[F6/-1.14/0.01]W[F3//0.01];)",
+        "2(;GM[Othello]PC[NBoard]PB[a]PW[b]RE[-12.00:r]TI[1:00]TY[8]\nBO[8 ---------------------------O*------*O--------------------------- *]\nB[f5]W[D6/-1.5]B[C3//2.5];)",
+    };
+
+    std::string text;
+    std::vector<std::string> expected;
+    for (int i=0; i<300; i++) {
+        const char* sGame=sGames[i%3];
+        std::istringstream is(sGame);
+        COsGame game;
+        is >> game;
+        expected.push_back(GameText(game));
+        text+=sGame;
+        text+="\n";
+    }
+    const CStringView view(text.data(), text.size());
+
+    // all fields gives the same games as COsGame::In
+    // small chunks so the games are split across threads
+    CGgfParser parser;
+    parser.SetChunkSize(1000);
+    for (int nThreads : {1, 3}) {
+        const std::vector<COsGame> games=parser.ReadAll(view, nThreads);
+        assertEquals(i64(expected.size()), i64(games.size()));
+        for (size_t i=0; i<games.size(); i++)
+            assertStringEquals(expected[i].c_str(), GameText(games[i]));
+    }
+
+    // only the requested fields are decoded
+    const std::vector<COsGame> games=CGgfParser(CGgfParser::kMoves|CGgfParser::kResult).ReadAll(view);
+    assertEquals(3, i64(games[2].ml.size()));
+    assertEquals(-1.5, games[2].ml[1].dEval, 0.001);
+    assertEquals(2.5, games[2].ml[2].tElapsed, 0.001);
+    assertEquals(-12, games[2].Result().dResult, 0.001);
+    assertEquals(COsResult::kResigned, games[2].Result().status);
+    assertStringEquals("", games[2].pis[1].sName);
+    int nBlack, nWhite, nEmpty;
+    games[1].GetPos().board.GetPieceCounts(nBlack, nWhite, nEmpty);
+    assertEquals(52, nEmpty);
+}
+
 void testOsObjects() {
 	testOsBoard();
 	testOsGame();
     testOsGameResult();
+    testGgfParser();
 }
@@ -4,18 +4,21 @@
 #include "types.h"
 
 #include "sockbuf.h"
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 
 #ifndef _WIN32
 #include <unistd.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #endif
 
 using namespace std;
 
-sockbuf::sockbuf() {
+//! \param fLogging log all data sent and received to recv.txt. Only one sockbuf at a time can log.
+sockbuf::sockbuf(bool fLogging) : fLogging(fLogging) {
     // log incoming data to file?
     fplog=NULL;
     loglast=kLogNone;
@@ -49,6 +52,7 @@ sockbuf::~sockbuf() throw() {
     		fplog->close();
     	else
     		assert(0);
+    	delete fplog;
     }
     if (buf)
     	delete [] buf;
@@ -112,6 +116,44 @@ int sockbuf::connect(const string& sServer, int nPort) {
     return 0;
 }
 
+//! Use a socket that is already connected, for instance one returned by socklistener::accept().
+//!
+//! The sockbuf owns the socket from now on and closes it on disconnect().
+int sockbuf::attach(SOCKET s) {
+    if (err)
+    	return err;
+
+    if (fConnected) {
+    	assert(0);
+    	return kErrAlreadyConnected;
+    }
+
+#if _WIN32
+    // balance the WSACleanup() in the destructor
+    WSADATA wsadata;
+    if (WSAStartup(MAKEWORD(1,1), &wsadata))
+    	return kErrCantStartup;
+#endif
+
+    sock=s;
+    fConnected=true;
+    return 0;
+}
+
+//! Stop sending and receiving without closing the socket.
+//!
+//! A thread blocked in underflow() on this sockbuf then returns EOF, so another thread can use
+//! this to stop it before disconnecting.
+void sockbuf::shutdown() {
+    if (fConnected) {
+#ifdef _WIN32
+    	::shutdown(sock, SD_BOTH);
+#else
+    	::shutdown(sock, SHUT_RDWR);
+#endif
+    }
+}
+
 int sockbuf::disconnect() {
     if (fConnected) {
 #ifdef _WIN32
@@ -206,7 +248,9 @@ int sockbuf::overflow(int c) {
     int nSent=send(sock, pbase(), nSend,0);
     bool fOK=nSend==nSent;
 
-    assert(fOK);
+    // the other end may have closed the connection; further output is discarded.
+    if (!fOK)
+    	err=kErrConnectionClosed;
     if (fplog) {
     	if (loglast!=kLogSend) {
     		loglast=kLogSend;
@@ -218,6 +262,8 @@ int sockbuf::overflow(int c) {
     	char cc=c;
     	nSent=send(sock, &cc, 1, 0);
     	fOK=nSent==1;
+    	if (!fOK)
+    		err=kErrConnectionClosed;
     	if (fplog) {
     		fplog->write(&cc,1);
     	}
@@ -238,3 +284,98 @@ int sockbuf::sync() {
 int sockbuf::Err() const {
     return err;
 }
+
+///////////////////////////////////
+// socklistener
+///////////////////////////////////
+
+socklistener::socklistener() {
+    fListening=false;
+    err=0;
+}
+
+socklistener::~socklistener() {
+    close();
+}
+
+//! Listen for connections to nPort. Only connections from the local machine are accepted.
+//!
+//! \return 0 if successful or a sockbuf error code if not
+int socklistener::listen(int nPort) {
+#ifdef _WIN32
+    SOCKADDR_IN sa;
+#else
+    struct sockaddr_in sa;
+#endif
+
+    if (fListening) {
+    	assert(0);
+    	return sockbuf::kErrAlreadyConnected;
+    }
+
+#if _WIN32
+    WSADATA wsadata;
+    if (WSAStartup(MAKEWORD(1,1), &wsadata))
+    	return err=sockbuf::kErrCantStartup;
+#endif
+
+    sock=socket(AF_INET, SOCK_STREAM, 0);
+#ifdef _WIN32
+    if (sock==INVALID_SOCKET)
+#else
+    if (sock<0)
+#endif
+    	return err=sockbuf::kErrNoSocket;
+
+    // allow a restarted server to reuse the port at once
+    int fReuse=1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&fReuse), sizeof(fReuse));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family=AF_INET;
+    sa.sin_port=htons(nPort);
+    sa.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+
+    if (::bind(sock, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) || ::listen(sock, SOMAXCONN)) {
+#ifdef _WIN32
+    	closesocket(sock);
+    	WSACleanup();
+#else
+    	::close(sock);
+#endif
+    	return err=sockbuf::kErrCantListen;
+    }
+
+    fListening=true;
+    return 0;
+}
+
+//! Wait for a connection.
+//!
+//! \return the connected socket, or -1 (INVALID_SOCKET on Windows) if the listener is closed or fails
+SOCKET socklistener::accept() {
+    if (!fListening) {
+#ifdef _WIN32
+    	return INVALID_SOCKET;
+#else
+    	return -1;
+#endif
+    }
+    return ::accept(sock, NULL, NULL);
+}
+
+void socklistener::close() {
+    if (fListening) {
+#ifdef _WIN32
+    	closesocket(sock);
+    	WSACleanup();
+#else
+    	::close(sock);
+#endif
+    	fListening=false;
+    }
+}
+
+int socklistener::Err() const {
+    return err;
+}
@@ -20,7 +20,7 @@
 class sockbuf : public std::streambuf {
 public:
     // construction/destruction
-    sockbuf();
+    explicit sockbuf(bool fLogging=true);
     virtual ~sockbuf() throw();
 
     // overrides
@@ -31,17 +31,20 @@ public:
     // errors
     enum { kErrUnknown=0x8600, kErrCantStartup, kErrNoHost, kErrNoProtocol, kErrNoSocket,
     			kErrCantConnect, kErrConnectionReset, kErrConnectionClosed,
-    			kErrNotConnected, kErrAlreadyConnected };
+    			kErrNotConnected, kErrAlreadyConnected, kErrCantListen };
     int Err() const;
 
     bool IsConnected() const;
 
     int connect(const std::string& sServer, int nPort);
+    int attach(SOCKET s);
     int disconnect();
+    void shutdown();
 
 protected:
-    enum { fLogging=1, nBufSize=1024 };
+    enum { nBufSize=1024 };
 
+    bool fLogging;
     bool fConnected;
 
     SOCKET sock;
@@ -50,3 +53,21 @@ protected:
     char *buf;
     int err;
 };
+
+//! Accepts connections on a port of the local machine, for sockbufs to attach() to.
+class socklistener {
+public:
+    socklistener();
+    ~socklistener();
+
+    int listen(int nPort);
+    SOCKET accept();
+    void close();
+
+    int Err() const;
+
+private:
+    bool fListening;
+    SOCKET sock;
+    int err;
+};
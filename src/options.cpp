@@ -7,7 +7,6 @@
 
 #include "n64/utils.h"
 #include "options.h"
-int treeNEmpty;
 
 // opponent's move?
 bool fTooting=false;
@@ -18,9 +17,6 @@ bool fSolvedAreMinimal=true;
 
 bool fPrintAbort=true;
 
-#ifdef _DEBUG
-bool fPrintTree=false;
-#endif
 bool fPrintWLD=false;
 bool fCompareMode=false;
 bool fInTournament=false;
@@ -30,4 +26,10 @@ FILE* cpFile;
 int nCapturedPositions=0;
 
 int hNegascout=6;
+int nEmptySelectiveSolve=12;
+
+int nEmptyPNSearch=0;
+int nPNSearchMargin=24;
+double dPNSearchNodes=1;
+int nPNSearchMB=64;
 
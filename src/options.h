@@ -16,19 +16,11 @@
 class CBook;
 class CCache;
 
-#ifdef _DEBUG
-extern bool fPrintTree;
-#else
-const bool fPrintTree=false;
-#endif
-
 extern bool fPrintWLD;
 extern bool fPrintMPCStats;
 extern bool fCompareMode;
 extern bool fTourmanent;
 
-extern int treeNEmpty;
-
 extern bool fSolvedAreMinimal;
 
 extern bool fPrintAbort;    // print abort message when aborting search?
@@ -42,5 +34,12 @@ extern int nCapturedPositions;
 
 // search params
 extern int hNegascout;
+extern int nEmptySelectiveSolve;    // probable solves with at most this many empties use the n64 solver
+
+// proof-number search for full-width WLD rounds
+extern int nEmptyPNSearch;          // try it on positions with at most this many empties
+extern int nPNSearchMargin;         // ... when the last round's value is at least this many discs from a draw
+extern double dPNSearchNodes;       // node budget, as a multiple of the nodes searched so far
+extern int nPNSearchMB;             // size of its transposition table
 
 #endif // H_OPTIONS
\ No newline at end of file
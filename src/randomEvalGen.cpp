@@ -2,19 +2,39 @@
 //  All Rights Reserved
 // This file is distributed subject to GNU GPL version 3. See the files
 // GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+// Random game generator.
+//
+// usage: randomEvalGen [count]
+//    prints count random positions and their evaluations as a C table, for EvalTest.cpp
+//
+// usage: randomEvalGen -o file nGames [minPly maxPly [label [nThreads [seed]]]]
+//    plays nGames random games on nThreads threads and writes one position from each game, at a
+//    random ply between minPly and maxPly, to file. See GenerateLabels for the label format.
+//    The output only depends on the seed, not on the number of threads.
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "core/BitBoard.h"
 #include "core/Moves.h"
+#include "core/PosValue.h"
 #include "Evaluator.h"
 #include "Search.h"
 #include "pattern/FastFlip.h"
 #include "n64/flips.h"
+#include "n64/solve.h"
 
 using namespace std;
 
@@ -83,6 +103,307 @@ void RandomGameEvalGen() {
     } while (!gameOver);
 }
 
+//////////////////////////////////////////////////////
+// Bulk generation
+//////////////////////////////////////////////////////
+
+// Games are played in batches. Each batch has its own random number generator, seeded from its
+// index, so the positions don't depend on which thread plays the batch.
+const int kBatchSize = 1024;
+
+struct GenParams {
+    u64 nGames;
+    int minPly, maxPly;
+    bool labelled;      // false to write bare bitboards, as in captured.pos
+    int searchDepth;    // 0 to label with the static evaluation
+    int solveEmpties;   // positions with at most this many empties are solved exactly
+    u64 seed;
+};
+
+// splitmix64 generator
+class Random {
+public:
+    explicit Random(u64 seed) : state(seed) {}
+    u64 Next() {
+        u64 z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    u64 Next(u64 n) { return Next() % n; }
+private:
+    u64 state;
+};
+
+// Play the move at sq. The enemy is to move afterwards.
+static inline void MakeMove(int sq, u64& mover, u64& enemy) {
+    const u64 flip = flips(sq, mover, enemy);
+    const u64 newMover = enemy ^ flip;
+    enemy = mover | flip | mask(sq);
+    mover = newMover;
+}
+
+static int TerminalValue(u64 mover, u64 enemy) {
+    int net = bitCountInt(mover) - bitCountInt(enemy);
+    const int nEmpty = 64 - bitCountInt(mover | enemy);
+    if (net > 0)
+        net += nEmpty;
+    else if (net < 0)
+        net -= nEmpty;
+    return net * kStoneValue;
+}
+
+static CValue StaticValue(const CEvaluator* eval, u64 mover, u64 enemy, u64 moves) {
+    CBitBoard bb;
+    bb.mover = mover;
+    bb.empty = ~(mover | enemy);
+    Pos2 pp;
+    pp.Initialize(bb, true);
+    return eval->EvalMobs(pp, u4(bitCount(moves)), u4(bitCount(mobility(enemy, mover))));
+}
+
+// Alpha-beta search on the static evaluation. Sets square to the best move if the mover has a move.
+static int SearchValue(const CEvaluator* eval, u64 mover, u64 enemy, int depth, int alpha, int beta, int& square) {
+    const u64 moves = mobility(mover, enemy);
+    if (!moves) {
+        const u64 enemyMoves = mobility(enemy, mover);
+        if (!enemyMoves)
+            return TerminalValue(mover, enemy);
+        int unused;
+        return -SearchValue(eval, enemy, mover, depth, -beta, -alpha, unused);
+    }
+    if (depth == 0)
+        return StaticValue(eval, mover, enemy, moves);
+
+    int best = -kInfinity;
+    for (u64 remaining = moves; remaining; remaining &= remaining - 1) {
+        const int sq = int(lowBitIndex(remaining));
+        u64 newMover = mover, newEnemy = enemy;
+        MakeMove(sq, newMover, newEnemy);
+        int unused;
+        const int value = -SearchValue(eval, newMover, newEnemy, depth - 1, -beta, -max(alpha, best), unused);
+        if (value > best) {
+            best = value;
+            square = sq;
+            if (best >= beta)
+                break;
+        }
+    }
+    return best;
+}
+
+// Exact value and best move of a position where the mover has a move
+static int SolveValue(u64 mover, u64 enemy, int& square) {
+    int best = -65;
+    for (u64 remaining = mobility(mover, enemy); remaining; remaining &= remaining - 1) {
+        const int sq = int(lowBitIndex(remaining));
+        u64 newMover = mover, newEnemy = enemy;
+        MakeMove(sq, newMover, newEnemy);
+        const int value = -solveNValue(-64, -best, newMover, newEnemy);
+        if (value > best) {
+            best = value;
+            square = sq;
+        }
+    }
+    return best * kStoneValue;
+}
+
+static CPosValue Label(const GenParams& gp, const CEvaluator* eval, u64 mover, u64 enemy, u64 moves) {
+    CPosValue pv;
+    pv.bb.mover = mover;
+    pv.bb.empty = ~(mover | enemy);
+    pv.pass = 0;
+    int square = -1;
+    if (!gp.labelled) {
+        pv.value = 0;
+    } else if (pv.bb.NEmpty() <= gp.solveEmpties) {
+        pv.value = CValueCompact(SolveValue(mover, enemy, square));
+    } else if (gp.searchDepth) {
+        pv.value = CValueCompact(SearchValue(eval, mover, enemy, gp.searchDepth, -kInfinity, kInfinity, square));
+    } else {
+        pv.value = CValueCompact(StaticValue(eval, mover, enemy, moves));
+    }
+    pv.square = i1(square);
+    return pv;
+}
+
+// Play a batch of games in lockstep. The mobility of all unfinished games is calculated at once
+// so that it can use SIMD instructions.
+static void PlayBatch(const GenParams& gp, const CEvaluator* eval, u64 iBatch, int nGames, vector<CPosValue>& positions) {
+    Random random(gp.seed ^ (iBatch * 0xD1B54A32D192ED03ULL));
+    CBitBoard start;
+    start.Initialize();
+
+    vector<u64> mover(nGames, start.mover), enemy(nGames, start.getEnemy()), moves(nGames);
+    vector<int> ply(nGames, 0), target(nGames);
+    for (int& t : target)
+        t = gp.minPly + int(random.Next(gp.maxPly - gp.minPly + 1));
+
+    int nActive = nGames;
+    while (nActive) {
+        mobilities(&mover[0], &enemy[0], &moves[0], nActive);
+        for (int i = 0; i < nActive; ) {
+            bool finished = false;
+            if (!moves[i]) {
+                // pass, or the game ended before reaching its target ply
+                if (mobility(enemy[i], mover[i]))
+                    swap(mover[i], enemy[i]);
+                else
+                    finished = true;
+            } else if (ply[i] == target[i]) {
+                positions.push_back(Label(gp, eval, mover[i], enemy[i], moves[i]));
+                finished = true;
+            } else {
+                // play a random move
+                u64 remaining = moves[i];
+                for (u64 n = random.Next(bitCount(remaining)); n; n--)
+                    remaining &= remaining - 1;
+                MakeMove(int(lowBitIndex(remaining)), mover[i], enemy[i]);
+                ++ply[i];
+            }
+
+            if (finished) {
+                --nActive;
+                mover[i] = mover[nActive];
+                enemy[i] = enemy[nActive];
+                moves[i] = moves[nActive];
+                ply[i] = ply[nActive];
+                target[i] = target[nActive];
+            } else {
+                ++i;
+            }
+        }
+    }
+}
+
+static bool Write(FILE* fp, const GenParams& gp, const vector<CPosValue>& positions) {
+    for (const CPosValue& pv : positions) {
+        if (!(gp.labelled ? pv.Write(fp) : pv.bb.Write(fp)))
+            return false;
+    }
+    return true;
+}
+
+// Play the games on nThreads threads and write the positions to fp in batch order.
+// Returns the number of positions written.
+static u64 Generate(const GenParams& gp, int nThreads, FILE* fp) {
+    const CEvaluator* eval = CEvaluator::FindEvaluator('J', 'A');
+    const u64 nBatches = (gp.nGames + kBatchSize - 1) / kBatchSize;
+
+    atomic<u64> iNext(0);
+    mutex mx;
+    map<u64, vector<CPosValue> > finished;
+    u64 iWrite = 0, nWritten = 0;
+    bool ok = true;
+
+    auto work = [&]() {
+        for (u64 iBatch; (iBatch = iNext++) < nBatches; ) {
+            const int nGames = int(min<u64>(kBatchSize, gp.nGames - iBatch * kBatchSize));
+            vector<CPosValue> positions;
+            PlayBatch(gp, eval, iBatch, nGames, positions);
+
+            lock_guard<mutex> lock(mx);
+            finished[iBatch].swap(positions);
+            for (auto it = finished.begin(); it != finished.end() && it->first == iWrite; it = finished.erase(it)) {
+                ok = ok && Write(fp, gp, it->second);
+                nWritten += it->second.size();
+                ++iWrite;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (int i = 1; i < nThreads; i++)
+        threads.push_back(thread(work));
+    work();
+    for (thread& t : threads)
+        t.join();
+
+    if (!ok)
+        throw string("error writing positions");
+    return nWritten;
+}
+
+// The label is [n|e|s<depth>][x[<empties>]]:
+//    n           no label; the file holds bitboards, like captured.pos, for ntest's posvalues mode
+//    e           static evaluation (the default)
+//    s<depth>    alpha-beta search on the static evaluation to the given depth
+//    x<empties>  solve positions with at most the given number of empties exactly; 'x' alone
+//                solves every position
+// Labelled files are position value files (see core/PosValue.h), which trainCoeffs reads.
+static bool ParseLabel(const char* label, GenParams& gp) {
+    char* end = const_cast<char*>(label);
+    gp.labelled = true;
+    gp.searchDepth = 0;
+    gp.solveEmpties = -1;
+    switch (*end) {
+    case 'n':
+        gp.labelled = false;
+        end++;
+        break;
+    case 'e':
+        end++;
+        break;
+    case 's':
+        gp.searchDepth = int(strtol(end + 1, &end, 10));
+        if (gp.searchDepth < 1)
+            return false;
+        break;
+    }
+    if (*end == 'x' && gp.labelled) {
+        end++;
+        gp.solveEmpties = isdigit(*end) ? int(strtol(end, &end, 10)) : 64;
+    }
+    return *end == 0;
+}
+
+static int GenerateMain(int argc, char **argv) {
+    if (argc < 4) {
+        cerr << "usage: randomEvalGen -o file nGames [minPly maxPly [label [nThreads [seed]]]]\n";
+        return 1;
+    }
+    GenParams gp;
+    const string fn = argv[2];
+    gp.nGames = strtoull(argv[3], 0, 10);
+    gp.minPly = argc > 4 ? atoi(argv[4]) : 10;
+    gp.maxPly = argc > 5 ? atoi(argv[5]) : 39;
+    const char* label = argc > 6 ? argv[6] : "e";
+    int nThreads = argc > 7 ? atoi(argv[7]) : int(thread::hardware_concurrency());
+    gp.seed = argc > 8 ? strtoull(argv[8], 0, 10) : 20111004;
+    if (nThreads < 1)
+        nThreads = 1;
+    if (gp.minPly < 0 || gp.maxPly < gp.minPly || gp.maxPly > 59 || !ParseLabel(label, gp)) {
+        cerr << "invalid ply range or label\n";
+        return 1;
+    }
+
+    // the table mode has always run without the flip tables; it is left that way so it still
+    // reproduces the table in EvalTest.cpp
+    initFlips();
+
+    FILE* fp = fopen(fn.c_str(), "wb");
+    if (!fp) {
+        cerr << "Can't open " << fn << "\n";
+        return 1;
+    }
+    try {
+        if (gp.labelled && !CPosValue::WriteHeader(fp))
+            throw string("error writing positions");
+        const auto start = chrono::steady_clock::now();
+        const u64 n = Generate(gp, nThreads, fp);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (fclose(fp))
+            throw string("error writing positions");
+        cerr << n << " positions from " << gp.nGames << " games in " << seconds << " s ("
+             << u64(n / max(seconds, 1e-6)) << " positions/s)\n";
+    }
+    catch(const string& s) {
+        cerr << s << "\n";
+        return 1;
+    }
+    return 0;
+}
+
 // To satisfy linker in debug mode
 bool HasInput() {
     return false;
@@ -92,6 +413,10 @@ int main(int argc, char **argv) {
     InitFastFlip();
     InitConfigToPotMob();
 
+    if (argc >= 2 && string(argv[1]) == "-o") {
+        return GenerateMain(argc, argv);
+    }
+
     int count = 40;
 
     if (argc >= 2) {
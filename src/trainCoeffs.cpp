@@ -0,0 +1,86 @@
+// Copyright Chris Welty
+//  All Rights Reserved
+// This file is distributed subject to GNU GPL version 3. See the files
+// GPLv3.txt and License.txt in the instructions subdirectory for details.
+
+//! \file
+//! Fit J evaluator coefficients to a position value file, as written by ntest's posvalues mode.
+//!
+//! The coefficients are written to J<set>a.cof, J<set>b.cof, ... in the current directory. They
+//! start from coefficients/J<start set>?.cof, or from zero if the start set is '-', and each
+//! range of empties is fitted on its own thread.
+//!
+//! usage: trainCoeffs set file.pvb [startSet [nThreads [nIterations [ridge]]]]
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "core/PosValue.h"
+#include "pattern/FastFlip.h"
+#include "CoeffFit.h"
+#include "Evaluator.h"
+
+using namespace std;
+
+// To satisfy linker in debug mode
+bool HasInput() {
+    return false;
+}
+
+//! Add the positions in the position value file fn to fit. Positions after a pass are skipped.
+//!
+//! \throw string if error
+static void ReadPosValues(const string& fn, CCoeffFitJ& fit) {
+    FILE* fp=fopen(fn.c_str(), "rb");
+    if (!fp)
+        throw string("Can't open position value file ")+fn;
+    if (!CPosValue::ReadHeader(fp)) {
+        fclose(fp);
+        throw string("Not a position value file: ")+fn;
+    }
+
+    CPosValue pv;
+    while (pv.Read(fp)) {
+        if (pv.pass==0)
+            fit.Add(pv.bb, pv.value);
+    }
+    fclose(fp);
+}
+
+int main(int argc, char **argv) {
+    InitFastFlip();
+    InitConfigToPotMob();
+
+    if (argc<3) {
+        cerr << "usage: trainCoeffs set file.pvb [startSet [nThreads [nIterations [ridge]]]]\n";
+        return 1;
+    }
+    const char coeffSet=argv[1][0];
+    const string fnPosValues=argv[2];
+    const char startSet=argc>3 ? argv[3][0] : '-';
+    int nThreads = argc>4 ? atoi(argv[4]) : int(thread::hardware_concurrency());
+    const int nIterations = argc>5 ? atoi(argv[5]) : 100;
+    const double dRidge = argc>6 ? atof(argv[6]) : 1;
+    if (nThreads<1)
+        nThreads=1;
+
+    try {
+        CCoeffFitJ fit(coeffSet);
+        if (startSet!='-')
+            fit.Read(string("coefficients/J")+startSet);
+        ReadPosValues(fnPosValues, fit);
+        cout << "Fitting " << fit.NPositions() << " positions on " << nThreads << " thread" << (nThreads==1?"":"s") << endl;
+
+        fit.Fit(nThreads, nIterations, dRidge);
+        fit.Print(cout);
+        fit.Write(string("J")+coeffSet);
+    }
+    catch(const string& s) {
+        cerr << s << "\n";
+        return 1;
+    }
+    return 0;
+}